@@ -0,0 +1,66 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* the resolution of the archive managers is private to the backend,
+ * so build the backend right into this unit and expose a few hooks.
+ */
+#include <thunar-archive-plugin/tap-backend.c>
+
+#include <benchmarks/tap-bench-backend.h>
+
+
+
+/**
+ * tap_bench_backend_resolve:
+ * @selection : a #TapSelection.
+ * @window    : the parent for dialogs, never shown in the benchmarks.
+ *
+ * Resolves the archive manager for the archives in @selection, just
+ * like the extract actions do before they run the wrapper.
+ *
+ * Return value: the #GAppInfo of the archive manager, or %NULL.
+ **/
+GAppInfo*
+tap_bench_backend_resolve (TapSelection *selection,
+                           GtkWidget    *window)
+{
+  GPtrArray *content_types;
+  GAppInfo  *mime_application;
+
+  content_types = tap_backend_content_types_new (selection->mime_types, selection->n_files);
+  mime_application = tap_backend_mime_application (content_types, window, NULL);
+  g_ptr_array_unref (content_types);
+
+  return mime_application;
+}
+
+
+
+/**
+ * tap_bench_backend_flush:
+ *
+ * Drops the resolution cache, like a change of the application
+ * database would.
+ **/
+void
+tap_bench_backend_flush (void)
+{
+  tap_backend_cache_invalidate (NULL, NULL);
+}
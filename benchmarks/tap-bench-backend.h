@@ -0,0 +1,34 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_BENCH_BACKEND_H__
+#define __TAP_BENCH_BACKEND_H__
+
+#include <thunar-archive-plugin/tap-selection.h>
+
+G_BEGIN_DECLS;
+
+GAppInfo *tap_bench_backend_resolve (TapSelection *selection,
+                                     GtkWidget    *window);
+void      tap_bench_backend_flush   (void);
+
+G_END_DECLS;
+
+#endif /* !__TAP_BENCH_BACKEND_H__ */
@@ -0,0 +1,248 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <benchmarks/tap-bench-file-info.h>
+
+
+
+static void             tap_bench_file_info_file_info_init      (ThunarxFileInfoIface *iface);
+static void             tap_bench_file_info_finalize            (GObject              *object);
+static gchar           *tap_bench_file_info_get_name            (ThunarxFileInfo      *file_info);
+static gchar           *tap_bench_file_info_get_uri             (ThunarxFileInfo      *file_info);
+static gchar           *tap_bench_file_info_get_parent_uri      (ThunarxFileInfo      *file_info);
+static gchar           *tap_bench_file_info_get_uri_scheme      (ThunarxFileInfo      *file_info);
+static gchar           *tap_bench_file_info_get_mime_type       (ThunarxFileInfo      *file_info);
+static gboolean         tap_bench_file_info_has_mime_type       (ThunarxFileInfo      *file_info,
+                                                                 const gchar          *mime_type);
+static gboolean         tap_bench_file_info_is_directory        (ThunarxFileInfo      *file_info);
+static GFileInfo       *tap_bench_file_info_get_file_info       (ThunarxFileInfo      *file_info);
+static GFileInfo       *tap_bench_file_info_get_filesystem_info (ThunarxFileInfo      *file_info);
+static GFile           *tap_bench_file_info_get_location        (ThunarxFileInfo      *file_info);
+
+
+
+struct _TapBenchFileInfoClass
+{
+  GObjectClass __parent__;
+};
+
+/**
+ * TapBenchFileInfo:
+ *
+ * A #ThunarxFileInfo that answers from memory, so the menu providers
+ * can be measured without a file manager or files on the disk.
+ **/
+struct _TapBenchFileInfo
+{
+  GObject      __parent__;
+
+  gchar       *path;
+  gchar       *uri;
+  const gchar *mime_type;
+  goffset      size;
+};
+
+
+
+G_DEFINE_TYPE_WITH_CODE (TapBenchFileInfo,
+                         tap_bench_file_info,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (THUNARX_TYPE_FILE_INFO,
+                                                tap_bench_file_info_file_info_init));
+
+
+
+static void
+tap_bench_file_info_class_init (TapBenchFileInfoClass *klass)
+{
+  GObjectClass *gobject_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  gobject_class->finalize = tap_bench_file_info_finalize;
+}
+
+
+
+static void
+tap_bench_file_info_file_info_init (ThunarxFileInfoIface *iface)
+{
+  iface->get_name = tap_bench_file_info_get_name;
+  iface->get_uri = tap_bench_file_info_get_uri;
+  iface->get_parent_uri = tap_bench_file_info_get_parent_uri;
+  iface->get_uri_scheme = tap_bench_file_info_get_uri_scheme;
+  iface->get_mime_type = tap_bench_file_info_get_mime_type;
+  iface->has_mime_type = tap_bench_file_info_has_mime_type;
+  iface->is_directory = tap_bench_file_info_is_directory;
+  iface->get_file_info = tap_bench_file_info_get_file_info;
+  iface->get_filesystem_info = tap_bench_file_info_get_filesystem_info;
+  iface->get_location = tap_bench_file_info_get_location;
+}
+
+
+
+static void
+tap_bench_file_info_init (TapBenchFileInfo *file_info)
+{
+}
+
+
+
+static void
+tap_bench_file_info_finalize (GObject *object)
+{
+  TapBenchFileInfo *file_info = TAP_BENCH_FILE_INFO (object);
+
+  g_free (file_info->path);
+  g_free (file_info->uri);
+
+  (*G_OBJECT_CLASS (tap_bench_file_info_parent_class)->finalize) (object);
+}
+
+
+
+static gchar*
+tap_bench_file_info_get_name (ThunarxFileInfo *file_info)
+{
+  return g_path_get_basename (TAP_BENCH_FILE_INFO (file_info)->path);
+}
+
+
+
+static gchar*
+tap_bench_file_info_get_uri (ThunarxFileInfo *file_info)
+{
+  return g_strdup (TAP_BENCH_FILE_INFO (file_info)->uri);
+}
+
+
+
+static gchar*
+tap_bench_file_info_get_parent_uri (ThunarxFileInfo *file_info)
+{
+  gchar *dirname;
+  gchar *uri;
+
+  dirname = g_path_get_dirname (TAP_BENCH_FILE_INFO (file_info)->path);
+  uri = g_filename_to_uri (dirname, NULL, NULL);
+  g_free (dirname);
+
+  return uri;
+}
+
+
+
+static gchar*
+tap_bench_file_info_get_uri_scheme (ThunarxFileInfo *file_info)
+{
+  return g_strdup ("file");
+}
+
+
+
+static gchar*
+tap_bench_file_info_get_mime_type (ThunarxFileInfo *file_info)
+{
+  return g_strdup (TAP_BENCH_FILE_INFO (file_info)->mime_type);
+}
+
+
+
+static gboolean
+tap_bench_file_info_has_mime_type (ThunarxFileInfo *file_info,
+                                   const gchar     *mime_type)
+{
+  return g_content_type_is_a (TAP_BENCH_FILE_INFO (file_info)->mime_type, mime_type);
+}
+
+
+
+static gboolean
+tap_bench_file_info_is_directory (ThunarxFileInfo *file_info)
+{
+  return (strcmp (TAP_BENCH_FILE_INFO (file_info)->mime_type, "inode/directory") == 0);
+}
+
+
+
+static GFileInfo*
+tap_bench_file_info_get_file_info (ThunarxFileInfo *file_info)
+{
+  TapBenchFileInfo *bench_file_info = TAP_BENCH_FILE_INFO (file_info);
+  GFileInfo        *info;
+
+  info = g_file_info_new ();
+  g_file_info_set_file_type (info, tap_bench_file_info_is_directory (file_info) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR);
+  g_file_info_set_content_type (info, bench_file_info->mime_type);
+  g_file_info_set_size (info, bench_file_info->size);
+
+  return info;
+}
+
+
+
+static GFileInfo*
+tap_bench_file_info_get_filesystem_info (ThunarxFileInfo *file_info)
+{
+  return g_file_info_new ();
+}
+
+
+
+static GFile*
+tap_bench_file_info_get_location (ThunarxFileInfo *file_info)
+{
+  return g_file_new_for_path (TAP_BENCH_FILE_INFO (file_info)->path);
+}
+
+
+
+/**
+ * tap_bench_file_info_new:
+ * @path      : the absolute path of the synthetic file.
+ * @mime_type : the mime type reported for the file.
+ * @size      : the size reported for the file.
+ *
+ * Allocates a #ThunarxFileInfo for a file that does not need to
+ * exist on the disk.
+ *
+ * Return value: the new #ThunarxFileInfo.
+ **/
+ThunarxFileInfo*
+tap_bench_file_info_new (const gchar *path,
+                         const gchar *mime_type,
+                         goffset      size)
+{
+  TapBenchFileInfo *file_info;
+
+  g_return_val_if_fail (g_path_is_absolute (path), NULL);
+  g_return_val_if_fail (mime_type != NULL, NULL);
+
+  file_info = g_object_new (TAP_BENCH_TYPE_FILE_INFO, NULL);
+  file_info->path = g_strdup (path);
+  file_info->uri = g_filename_to_uri (path, NULL, NULL);
+  file_info->mime_type = g_intern_string (mime_type);
+  file_info->size = size;
+
+  return THUNARX_FILE_INFO (file_info);
+}
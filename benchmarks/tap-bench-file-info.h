@@ -0,0 +1,46 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_BENCH_FILE_INFO_H__
+#define __TAP_BENCH_FILE_INFO_H__
+
+#include <thunarx/thunarx.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapBenchFileInfoClass TapBenchFileInfoClass;
+typedef struct _TapBenchFileInfo      TapBenchFileInfo;
+
+#define TAP_BENCH_TYPE_FILE_INFO            (tap_bench_file_info_get_type ())
+#define TAP_BENCH_FILE_INFO(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), TAP_BENCH_TYPE_FILE_INFO, TapBenchFileInfo))
+#define TAP_BENCH_FILE_INFO_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), TAP_BENCH_TYPE_FILE_INFO, TapBenchFileInfoClass))
+#define TAP_BENCH_IS_FILE_INFO(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TAP_BENCH_TYPE_FILE_INFO))
+#define TAP_BENCH_IS_FILE_INFO_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), TAP_BENCH_TYPE_FILE_INFO))
+#define TAP_BENCH_FILE_INFO_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), TAP_BENCH_TYPE_FILE_INFO, TapBenchFileInfoClass))
+
+GType            tap_bench_file_info_get_type (void) G_GNUC_CONST;
+
+ThunarxFileInfo *tap_bench_file_info_new      (const gchar *path,
+                                               const gchar *mime_type,
+                                               goffset      size) G_GNUC_MALLOC;
+
+G_END_DECLS;
+
+#endif /* !__TAP_BENCH_FILE_INFO_H__ */
@@ -0,0 +1,171 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <benchmarks/tap-bench-plugin.h>
+
+
+
+static void     tap_bench_plugin_provider_plugin_init (ThunarxProviderPluginIface  *iface);
+static gboolean tap_bench_plugin_get_resident         (const ThunarxProviderPlugin *plugin);
+static void     tap_bench_plugin_set_resident         (ThunarxProviderPlugin       *plugin,
+                                                       gboolean                     resident);
+static GType    tap_bench_plugin_register_type        (ThunarxProviderPlugin       *plugin,
+                                                       GType                        type_parent,
+                                                       const gchar                 *type_name,
+                                                       const GTypeInfo             *type_info,
+                                                       GTypeFlags                   type_flags);
+static void     tap_bench_plugin_add_interface        (ThunarxProviderPlugin       *plugin,
+                                                       GType                        instance_type,
+                                                       GType                        interface_type,
+                                                       const GInterfaceInfo        *interface_info);
+static GType    tap_bench_plugin_register_enum        (ThunarxProviderPlugin       *plugin,
+                                                       const gchar                 *name,
+                                                       const GEnumValue            *const_static_values);
+static GType    tap_bench_plugin_register_flags       (ThunarxProviderPlugin       *plugin,
+                                                       const gchar                 *name,
+                                                       const GFlagsValue           *const_static_values);
+
+
+
+struct _TapBenchPluginClass
+{
+  GObjectClass __parent__;
+};
+
+/**
+ * TapBenchPlugin:
+ *
+ * A #ThunarxProviderPlugin that registers the types of the plugin
+ * statically, in place of the module loader of the file manager.
+ **/
+struct _TapBenchPlugin
+{
+  GObject __parent__;
+};
+
+
+
+G_DEFINE_TYPE_WITH_CODE (TapBenchPlugin,
+                         tap_bench_plugin,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (THUNARX_TYPE_PROVIDER_PLUGIN,
+                                                tap_bench_plugin_provider_plugin_init));
+
+
+
+static void
+tap_bench_plugin_class_init (TapBenchPluginClass *klass)
+{
+}
+
+
+
+static void
+tap_bench_plugin_provider_plugin_init (ThunarxProviderPluginIface *iface)
+{
+  iface->get_resident = tap_bench_plugin_get_resident;
+  iface->set_resident = tap_bench_plugin_set_resident;
+  iface->register_type = tap_bench_plugin_register_type;
+  iface->add_interface = tap_bench_plugin_add_interface;
+  iface->register_enum = tap_bench_plugin_register_enum;
+  iface->register_flags = tap_bench_plugin_register_flags;
+}
+
+
+
+static void
+tap_bench_plugin_init (TapBenchPlugin *plugin)
+{
+}
+
+
+
+static gboolean
+tap_bench_plugin_get_resident (const ThunarxProviderPlugin *plugin)
+{
+  return TRUE;
+}
+
+
+
+static void
+tap_bench_plugin_set_resident (ThunarxProviderPlugin *plugin,
+                               gboolean               resident)
+{
+}
+
+
+
+static GType
+tap_bench_plugin_register_type (ThunarxProviderPlugin *plugin,
+                                GType                  type_parent,
+                                const gchar           *type_name,
+                                const GTypeInfo       *type_info,
+                                GTypeFlags             type_flags)
+{
+  return g_type_register_static (type_parent, type_name, type_info, type_flags);
+}
+
+
+
+static void
+tap_bench_plugin_add_interface (ThunarxProviderPlugin *plugin,
+                                GType                  instance_type,
+                                GType                  interface_type,
+                                const GInterfaceInfo  *interface_info)
+{
+  g_type_add_interface_static (instance_type, interface_type, interface_info);
+}
+
+
+
+static GType
+tap_bench_plugin_register_enum (ThunarxProviderPlugin *plugin,
+                                const gchar           *name,
+                                const GEnumValue      *const_static_values)
+{
+  return g_enum_register_static (name, const_static_values);
+}
+
+
+
+static GType
+tap_bench_plugin_register_flags (ThunarxProviderPlugin *plugin,
+                                 const gchar           *name,
+                                 const GFlagsValue     *const_static_values)
+{
+  return g_flags_register_static (name, const_static_values);
+}
+
+
+
+/**
+ * tap_bench_plugin_new:
+ *
+ * Allocates a #ThunarxProviderPlugin to pass to the type registration
+ * functions of the plugin.
+ *
+ * Return value: the new #ThunarxProviderPlugin.
+ **/
+ThunarxProviderPlugin*
+tap_bench_plugin_new (void)
+{
+  return g_object_new (TAP_BENCH_TYPE_PLUGIN, NULL);
+}
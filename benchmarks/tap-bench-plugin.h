@@ -0,0 +1,44 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_BENCH_PLUGIN_H__
+#define __TAP_BENCH_PLUGIN_H__
+
+#include <thunarx/thunarx.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapBenchPluginClass TapBenchPluginClass;
+typedef struct _TapBenchPlugin      TapBenchPlugin;
+
+#define TAP_BENCH_TYPE_PLUGIN            (tap_bench_plugin_get_type ())
+#define TAP_BENCH_PLUGIN(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), TAP_BENCH_TYPE_PLUGIN, TapBenchPlugin))
+#define TAP_BENCH_PLUGIN_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), TAP_BENCH_TYPE_PLUGIN, TapBenchPluginClass))
+#define TAP_BENCH_IS_PLUGIN(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), TAP_BENCH_TYPE_PLUGIN))
+#define TAP_BENCH_IS_PLUGIN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), TAP_BENCH_TYPE_PLUGIN))
+#define TAP_BENCH_PLUGIN_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), TAP_BENCH_TYPE_PLUGIN, TapBenchPluginClass))
+
+GType                  tap_bench_plugin_get_type (void) G_GNUC_CONST;
+
+ThunarxProviderPlugin *tap_bench_plugin_new      (void) G_GNUC_MALLOC;
+
+G_END_DECLS;
+
+#endif /* !__TAP_BENCH_PLUGIN_H__ */
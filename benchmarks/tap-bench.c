@@ -0,0 +1,484 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib/gstdio.h>
+
+#include <benchmarks/tap-bench-backend.h>
+#include <benchmarks/tap-bench-file-info.h>
+#include <benchmarks/tap-bench-plugin.h>
+#include <thunar-archive-plugin/tap-backend.h>
+#include <thunar-archive-plugin/tap-provider.h>
+#include <thunar-archive-plugin/tap-wrappers.h>
+
+
+
+/* the number of folders the synthetic files are spread over */
+#define TAP_BENCH_N_FOLDERS (16)
+
+
+
+typedef struct _TapBenchCase TapBenchCase;
+
+
+
+static gint64 tap_bench_now           (void);
+static void   tap_bench_remove        (const gchar  *path);
+static void   tap_bench_setup         (const gchar  *root,
+                                       guint         n_apps);
+static GList *tap_bench_files         (const gchar  *root,
+                                       guint         n_files);
+static gint   tap_bench_compare       (gconstpointer a,
+                                       gconstpointer b);
+static void   tap_bench_run           (TapBenchCase *bench_case,
+                                       guint         n_apps,
+                                       guint         n_files,
+                                       guint         n_iterations);
+static void   tap_bench_file_menu     (TapBenchCase *bench_case);
+static void   tap_bench_dnd_menu      (TapBenchCase *bench_case);
+static void   tap_bench_resolve_flush (TapBenchCase *bench_case);
+static void   tap_bench_resolve       (TapBenchCase *bench_case);
+
+
+
+struct _TapBenchCase
+{
+  const gchar *name;
+
+  /* prepares the state for one iteration, not measured */
+  void       (*prepare) (TapBenchCase *bench_case);
+
+  /* the measured operation */
+  void       (*run)     (TapBenchCase *bench_case);
+
+  ThunarxMenuProvider *provider;
+  GtkWidget           *window;
+  ThunarxFileInfo     *folder;
+  GList               *files;
+  TapSelection        *selection;
+};
+
+
+
+/* the archive types of the synthetic files, in rotation */
+static const gchar TAP_BENCH_MIME_TYPES[][35] = {
+  "application/x-compressed-tar",
+  "application/zip",
+  "application/x-7z-compressed",
+  "application/x-xz-compressed-tar",
+};
+
+
+
+/* the number of calls to malloc(), calloc() and realloc() so far */
+static volatile gint tap_bench_allocations = 0;
+
+
+
+#ifdef HAVE_LIBC_MALLOC
+/* count every allocation of the process, including those in GLib, by
+ * interposing the allocator entry points and forwarding them to glibc.
+ * Other C libraries have no such entry points, so nothing is counted.
+ */
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t n_members,
+                             size_t size);
+extern void *__libc_realloc (void  *ptr,
+                             size_t size);
+
+void*
+malloc (size_t size)
+{
+  g_atomic_int_inc (&tap_bench_allocations);
+  return __libc_malloc (size);
+}
+
+void*
+calloc (size_t n_members,
+        size_t size)
+{
+  g_atomic_int_inc (&tap_bench_allocations);
+  return __libc_calloc (n_members, size);
+}
+
+void*
+realloc (void  *ptr,
+         size_t size)
+{
+  g_atomic_int_inc (&tap_bench_allocations);
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+
+
+static gint64
+tap_bench_now (void)
+{
+  struct timespec ts;
+
+  /* g_get_monotonic_time() is too coarse for the small cases */
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+
+static void
+tap_bench_remove (const gchar *path)
+{
+  const gchar *name;
+  GDir        *dir;
+  gchar       *child;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          child = g_build_filename (path, name, NULL);
+          tap_bench_remove (child);
+          g_free (child);
+        }
+      g_dir_close (dir);
+    }
+
+  g_remove (path);
+}
+
+
+
+static void
+tap_bench_setup (const gchar *root,
+                 guint        n_apps)
+{
+  GString *mime_types;
+  GString *contents;
+  gchar   *filename;
+  gchar   *path;
+  guint    n;
+
+  /* isolate the application database, the defaults and the caches
+   * from the desktop, before GIO gets to read any of them. There is
+   * no mime database in there either, so subclass checks are exact.
+   */
+  path = g_build_filename (root, "data", NULL);
+  g_setenv ("XDG_DATA_HOME", path, TRUE);
+  g_setenv ("XDG_DATA_DIRS", path, TRUE);
+  g_free (path);
+  path = g_build_filename (root, "config", NULL);
+  g_setenv ("XDG_CONFIG_HOME", path, TRUE);
+  g_setenv ("XDG_CONFIG_DIRS", path, TRUE);
+  g_mkdir_with_parents (path, 0700);
+  g_free (path);
+  path = g_build_filename (root, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", path, TRUE);
+  g_free (path);
+
+  /* every application handles all the archive types */
+  mime_types = g_string_new (NULL);
+  for (n = 0; n < G_N_ELEMENTS (TAP_BENCH_MIME_TYPES); ++n)
+    g_string_append_printf (mime_types, "%s;", TAP_BENCH_MIME_TYPES[n]);
+  g_string_append (mime_types, "application/x-tar;application/x-zip;");
+
+  path = g_build_filename (root, "data", "applications", NULL);
+  g_mkdir_with_parents (path, 0700);
+
+  /* drop the stubs of a previous run with more applications */
+  tap_bench_remove (TAP_WRAPPERS_DIR);
+  g_mkdir_with_parents (TAP_WRAPPERS_DIR, 0700);
+
+  contents = g_string_new (NULL);
+  for (n = 0; n < n_apps; ++n)
+    {
+      /* the .desktop file of the synthetic archive manager */
+      g_string_printf (contents,
+                       "[Desktop Entry]\n"
+                       "Type=Application\n"
+                       "Name=Archiver %u\n"
+                       "Exec=true %%F\n"
+                       "MimeType=%s\n",
+                       n, mime_types->str);
+      filename = g_strdup_printf ("%s/tap-bench-%u.desktop", path, n);
+      g_file_set_contents (filename, contents->str, contents->len, NULL);
+      g_free (filename);
+
+      /* and its wrapper stub */
+      filename = g_strdup_printf ("%s/tap-bench-%u.tap", TAP_WRAPPERS_DIR, n);
+      g_file_set_contents (filename, "#!/bin/sh\n# TAP-Capabilities: file-list-stdin\nexit 0\n", -1, NULL);
+      g_chmod (filename, 0755);
+      g_free (filename);
+    }
+  g_free (path);
+
+  /* make the first one the default, so the resolution never asks */
+  g_string_assign (contents, "[Default Applications]\n");
+  for (n = 0; n < G_N_ELEMENTS (TAP_BENCH_MIME_TYPES); ++n)
+    g_string_append_printf (contents, "%s=tap-bench-0.desktop\n", TAP_BENCH_MIME_TYPES[n]);
+  g_string_append (contents, "application/x-tar=tap-bench-0.desktop\napplication/x-zip=tap-bench-0.desktop\n");
+  filename = g_build_filename (root, "config", "mimeapps.list", NULL);
+  g_file_set_contents (filename, contents->str, contents->len, NULL);
+  g_free (filename);
+
+  g_string_free (contents, TRUE);
+  g_string_free (mime_types, TRUE);
+}
+
+
+
+static GList*
+tap_bench_files (const gchar *root,
+                 guint        n_files)
+{
+  GList *files = NULL;
+  gchar *path;
+  guint  n;
+
+  for (n = n_files; n > 0; --n)
+    {
+      /* the archives do not exist, but their folders must be writable */
+      path = g_strdup_printf ("%s/files/%u/archive-%u", root, n % TAP_BENCH_N_FOLDERS, n);
+      files = g_list_prepend (files, tap_bench_file_info_new (path, TAP_BENCH_MIME_TYPES[n % G_N_ELEMENTS (TAP_BENCH_MIME_TYPES)], 1024 * n));
+      g_free (path);
+    }
+
+  return files;
+}
+
+
+
+static gint
+tap_bench_compare (gconstpointer a,
+                   gconstpointer b)
+{
+  gint64 x = *((const gint64 *) a);
+  gint64 y = *((const gint64 *) b);
+
+  return (x > y) - (x < y);
+}
+
+
+
+static void
+tap_bench_run (TapBenchCase *bench_case,
+               guint         n_apps,
+               guint         n_files,
+               guint         n_iterations)
+{
+  gint64 *samples;
+  gint64  allocations = 0;
+  gint64  start;
+  gint    before;
+  guint   n;
+
+  samples = g_new (gint64, n_iterations);
+
+  /* one round to warm up the caches */
+  if (bench_case->prepare != NULL)
+    (*bench_case->prepare) (bench_case);
+  (*bench_case->run) (bench_case);
+
+  for (n = 0; n < n_iterations; ++n)
+    {
+      if (bench_case->prepare != NULL)
+        (*bench_case->prepare) (bench_case);
+
+      before = g_atomic_int_get (&tap_bench_allocations);
+      start = tap_bench_now ();
+      (*bench_case->run) (bench_case);
+      samples[n] = tap_bench_now () - start;
+      allocations += g_atomic_int_get (&tap_bench_allocations) - before;
+    }
+
+  qsort (samples, n_iterations, sizeof (gint64), tap_bench_compare);
+
+  printf ("%-14s apps=%-4u files=%-7u iterations=%-4u p50=%10.1fus p90=%10.1fus p99=%10.1fus max=%10.1fus",
+          bench_case->name, n_apps, n_files, n_iterations,
+          samples[n_iterations / 2] / 1000.0,
+          samples[(n_iterations * 9) / 10] / 1000.0,
+          samples[(n_iterations * 99) / 100] / 1000.0,
+          samples[n_iterations - 1] / 1000.0);
+#ifdef HAVE_LIBC_MALLOC
+  printf (" allocs=%.1f\n", (gdouble) allocations / n_iterations);
+#else
+  printf (" allocs=n/a\n");
+#endif
+  fflush (stdout);
+
+  g_free (samples);
+}
+
+
+
+static void
+tap_bench_file_menu (TapBenchCase *bench_case)
+{
+  GList *items;
+
+  /* call the provider directly, the public API insists on a GtkWindow */
+  items = (*THUNARX_MENU_PROVIDER_GET_IFACE (bench_case->provider)->get_file_menu_items) (bench_case->provider, bench_case->window, bench_case->files);
+  g_list_free_full (items, g_object_unref);
+}
+
+
+
+static void
+tap_bench_dnd_menu (TapBenchCase *bench_case)
+{
+  GList *items;
+
+  items = (*THUNARX_MENU_PROVIDER_GET_IFACE (bench_case->provider)->get_dnd_menu_items) (bench_case->provider, bench_case->window, bench_case->folder, bench_case->files);
+  g_list_free_full (items, g_object_unref);
+}
+
+
+
+static void
+tap_bench_resolve_flush (TapBenchCase *bench_case)
+{
+  tap_bench_backend_flush ();
+}
+
+
+
+static void
+tap_bench_resolve (TapBenchCase *bench_case)
+{
+  GAppInfo *mime_application;
+
+  mime_application = tap_bench_backend_resolve (bench_case->selection, bench_case->window);
+  if (G_LIKELY (mime_application != NULL))
+    g_object_unref (G_OBJECT (mime_application));
+}
+
+
+
+int
+main (int    argc,
+      char **argv)
+{
+  ThunarxProviderPlugin *plugin;
+  GOptionContext        *context;
+  TapBenchCase           cases[4];
+  GError                *error = NULL;
+  gchar                 *root;
+  gchar                 *path;
+  guint                  n_files;
+  guint                  n;
+  gint                   n_apps = 1;
+  gint                   max_files = 100000;
+  gint                   max_iterations = 200;
+  GOptionEntry           entries[] =
+  {
+    { "apps", 0, 0, G_OPTION_ARG_INT, &n_apps, "The number of installed archive managers", "N", },
+    { "max-files", 0, 0, G_OPTION_ARG_INT, &max_files, "The largest selection to measure", "N", },
+    { "iterations", 0, 0, G_OPTION_ARG_INT, &max_iterations, "The number of iterations for small selections", "N", },
+    { NULL, },
+  };
+
+  context = g_option_context_new (NULL);
+  g_option_context_set_summary (context, "Measures the menu providers and the archive manager resolution of thunar-archive-plugin");
+  g_option_context_add_main_entries (context, entries, NULL);
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s: %s\n", g_get_prgname (), error->message);
+      return EXIT_FAILURE;
+    }
+  g_option_context_free (context);
+
+  /* the synthetic desktop, must exist before GIO looks around */
+  root = g_dir_make_tmp ("tap-bench-XXXXXX", &error);
+  if (G_UNLIKELY (root == NULL))
+    {
+      g_printerr ("%s: %s\n", g_get_prgname (), error->message);
+      return EXIT_FAILURE;
+    }
+  tap_bench_setup (root, MAX (n_apps, 1));
+  for (n = 0; n < TAP_BENCH_N_FOLDERS; ++n)
+    {
+      path = g_strdup_printf ("%s/files/%u", root, n);
+      g_mkdir_with_parents (path, 0700);
+      g_free (path);
+    }
+
+  /* load the plugin the way the file manager would */
+  plugin = tap_bench_plugin_new ();
+  tap_provider_register_type (plugin);
+  tap_wrappers_initialize ();
+  tap_backend_initialize ();
+
+  memset (cases, 0, sizeof (cases));
+  cases[0].name = "file-menu";
+  cases[0].run = tap_bench_file_menu;
+  cases[1].name = "dnd-menu";
+  cases[1].run = tap_bench_dnd_menu;
+  cases[2].name = "resolve-cold";
+  cases[2].prepare = tap_bench_resolve_flush;
+  cases[2].run = tap_bench_resolve;
+  cases[3].name = "resolve-warm";
+  cases[3].run = tap_bench_resolve;
+
+  for (n = 0; n < G_N_ELEMENTS (cases); ++n)
+    {
+      /* the window is only the owner of the closures, and the parent
+       * of dialogs that the synthetic defaults never bring up.
+       */
+      cases[n].provider = g_object_new (TAP_TYPE_PROVIDER, NULL);
+      cases[n].window = g_object_new (G_TYPE_OBJECT, NULL);
+      path = g_build_filename (root, "files", "0", NULL);
+      cases[n].folder = tap_bench_file_info_new (path, "inode/directory", 0);
+      g_free (path);
+    }
+
+  for (n_files = 1; n_files <= (guint) max_files; n_files *= 10)
+    {
+      for (n = 0; n < G_N_ELEMENTS (cases); ++n)
+        {
+          cases[n].files = tap_bench_files (root, n_files);
+          cases[n].selection = tap_selection_new (cases[n].files);
+
+          tap_bench_run (&cases[n], n_apps, n_files, CLAMP (1000000 / n_files, 5, (guint) max_iterations));
+
+          tap_selection_unref (cases[n].selection);
+          g_list_free_full (cases[n].files, g_object_unref);
+        }
+    }
+
+  /* cleanup */
+  for (n = 0; n < G_N_ELEMENTS (cases); ++n)
+    {
+      g_object_unref (cases[n].folder);
+      g_object_unref (cases[n].window);
+      g_object_unref (cases[n].provider);
+    }
+  tap_backend_shutdown ();
+  tap_wrappers_shutdown ();
+  g_object_unref (plugin);
+  tap_bench_remove (root);
+  g_free (root);
+
+  return EXIT_SUCCESS;
+}
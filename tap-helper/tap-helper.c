@@ -0,0 +1,328 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdlib.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#ifdef HAVE_LIBARCHIVE
+#include <thunar-archive-plugin/tap-extract.h>
+#endif
+#include <thunar-archive-plugin/tap-helper-protocol.h>
+
+
+
+/* exit after this many seconds without connections */
+#define TAP_HELPER_IDLE_TIMEOUT (5 * 60)
+
+/* converts a struct timeval to microseconds */
+#define TAP_TIMEVAL_USEC(tv) ((gint64) (tv).tv_sec * G_USEC_PER_SEC + (tv).tv_usec)
+
+
+
+static GVariant *tap_helper_spawn    (GVariant               *request);
+#ifdef HAVE_LIBARCHIVE
+static void      tap_helper_progress (guint64                 written,
+                                      gpointer                user_data);
+#endif
+static GVariant *tap_helper_extract  (GVariant               *request,
+                                      GOutputStream          *stream);
+static gboolean  tap_helper_run      (GThreadedSocketService *service,
+                                      GSocketConnection      *connection,
+                                      GObject                *source_object,
+                                      gpointer                user_data);
+static gboolean  tap_helper_idle     (gpointer                user_data);
+
+
+
+/* the number of open connections, and the time the last one was closed */
+static gint   tap_helper_connections = 0;
+static gint64 tap_helper_last_active = 0;
+static GMutex tap_helper_lock;
+
+
+
+static GVariant*
+tap_helper_spawn (GVariant *request)
+{
+  GVariantBuilder builder;
+  struct rusage   usage;
+  const gchar    *folder = NULL;
+  GError         *error = NULL;
+  gchar         **argv = NULL;
+  gchar         **envp = NULL;
+  GPid            pid;
+  gint            status = 0;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+  if (!g_variant_lookup (request, "folder", "^&ay", &folder)
+      || !g_variant_lookup (request, "argv", "^aay", &argv))
+    {
+      g_variant_builder_add (&builder, "{sv}", "error", g_variant_new_string ("Malformed request"));
+      return g_variant_builder_end (&builder);
+    }
+  g_variant_lookup (request, "envp", "^aay", &envp);
+
+  /* the helper is small, so forking it is cheap compared to the file manager */
+  if (g_spawn_async (folder, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL,
+                     NULL, NULL, &pid, &error))
+    {
+      while (wait4 (pid, &status, 0, &usage) < 0 && errno == EINTR)
+        ;
+      g_spawn_close_pid (pid);
+
+      g_variant_builder_add (&builder, "{sv}", "status", g_variant_new_int32 (status));
+      g_variant_builder_add (&builder, "{sv}", "utime", g_variant_new_int64 (TAP_TIMEVAL_USEC (usage.ru_utime)));
+      g_variant_builder_add (&builder, "{sv}", "stime", g_variant_new_int64 (TAP_TIMEVAL_USEC (usage.ru_stime)));
+      g_variant_builder_add (&builder, "{sv}", "maxrss", g_variant_new_int64 (usage.ru_maxrss));
+    }
+  else
+    {
+      g_variant_builder_add (&builder, "{sv}", "error", g_variant_new_string (error->message));
+      g_error_free (error);
+    }
+
+  g_strfreev (envp);
+  g_strfreev (argv);
+
+  return g_variant_builder_end (&builder);
+}
+
+
+
+#ifdef HAVE_LIBARCHIVE
+static void
+tap_helper_progress (guint64  written,
+                     gpointer user_data)
+{
+  GVariantBuilder builder;
+
+  /* a client that went away notices with the result */
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "written", g_variant_new_uint64 (written));
+  tap_helper_send (G_OUTPUT_STREAM (user_data), "progress", g_variant_builder_end (&builder), NULL);
+}
+#endif
+
+
+
+static GVariant*
+tap_helper_extract (GVariant      *request,
+                    GOutputStream *stream)
+{
+  GVariantBuilder builder;
+#ifdef HAVE_LIBARCHIVE
+  const gchar    *archive = NULL;
+  const gchar    *folder = NULL;
+  gboolean        unsupported = FALSE;
+  guint32         n_threads;
+  gboolean        succeed = FALSE;
+  GError         *error = NULL;
+#endif
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+#ifdef HAVE_LIBARCHIVE
+  if (!g_variant_lookup (request, "archive", "^&ay", &archive)
+      || !g_variant_lookup (request, "folder", "^&ay", &folder))
+    {
+      g_variant_builder_add (&builder, "{sv}", "error", g_variant_new_string ("Malformed request"));
+      return g_variant_builder_end (&builder);
+    }
+
+  /* the client got the threads from its scheduler, older ones did not tell */
+  if (!g_variant_lookup (request, "threads", "u", &n_threads))
+    n_threads = g_get_num_processors ();
+
+  succeed = tap_extract_archive (archive, folder, n_threads, tap_helper_progress, stream, &unsupported, &error);
+
+  g_variant_builder_add (&builder, "{sv}", "succeed", g_variant_new_boolean (succeed));
+  g_variant_builder_add (&builder, "{sv}", "unsupported", g_variant_new_boolean (unsupported));
+  if (error != NULL)
+    {
+      g_variant_builder_add (&builder, "{sv}", "error", g_variant_new_string (error->message));
+      g_error_free (error);
+    }
+#else
+  /* let the client extract it, or hand it to a wrapper */
+  g_variant_builder_add (&builder, "{sv}", "unsupported", g_variant_new_boolean (TRUE));
+#endif
+
+  return g_variant_builder_end (&builder);
+}
+
+
+
+static gboolean
+tap_helper_run (GThreadedSocketService *service,
+                GSocketConnection      *connection,
+                GObject                *source_object,
+                gpointer                user_data)
+{
+  GOutputStream *output;
+  GInputStream  *input;
+  GVariant      *request;
+  GVariant      *result;
+  GError        *error = NULL;
+  gchar         *kind;
+
+  g_mutex_lock (&tap_helper_lock);
+  tap_helper_connections += 1;
+  g_mutex_unlock (&tap_helper_lock);
+
+  input = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+  /* serve requests until the client closes the connection */
+  for (;;)
+    {
+      request = tap_helper_receive (input, &kind, &error);
+      if (request == NULL)
+        break;
+
+      if (strcmp (kind, "spawn") == 0)
+        result = tap_helper_spawn (request);
+      else if (strcmp (kind, "extract") == 0)
+        result = tap_helper_extract (request, output);
+      else
+        result = g_variant_new_parsed ("{'error': <'Unknown request'>}");
+
+      g_variant_unref (request);
+      g_free (kind);
+
+      if (!tap_helper_send (output, "result", result, &error))
+        break;
+    }
+
+  /* a closed connection is not worth a warning */
+  if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+    g_warning ("Failed to serve client: %s", error->message);
+  g_error_free (error);
+
+  g_mutex_lock (&tap_helper_lock);
+  tap_helper_connections -= 1;
+  tap_helper_last_active = g_get_monotonic_time ();
+  g_mutex_unlock (&tap_helper_lock);
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_helper_idle (gpointer user_data)
+{
+  gboolean idle;
+
+  g_mutex_lock (&tap_helper_lock);
+  idle = (tap_helper_connections == 0
+          && g_get_monotonic_time () - tap_helper_last_active >= TAP_HELPER_IDLE_TIMEOUT * G_USEC_PER_SEC);
+  g_mutex_unlock (&tap_helper_lock);
+
+  if (idle)
+    g_main_loop_quit (user_data);
+
+  return G_SOURCE_CONTINUE;
+}
+
+
+
+int
+main (int    argc,
+      char **argv)
+{
+  GSocketConnection *connection;
+  GSocketService    *service;
+  GSocketAddress    *address;
+  GSocketClient     *client;
+  GMainLoop         *loop;
+  GError            *error = NULL;
+  gchar             *dirname;
+  gchar             *path;
+
+  xfce_textdomain (GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
+
+  path = tap_helper_socket_path ();
+  address = g_unix_socket_address_new (path);
+
+  /* only one helper per session */
+  client = g_socket_client_new ();
+  connection = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+  g_object_unref (client);
+  if (connection != NULL)
+    {
+      g_object_unref (connection);
+      g_object_unref (address);
+      g_free (path);
+      return EXIT_SUCCESS;
+    }
+
+  /* the socket of a helper that crashed */
+  dirname = g_path_get_dirname (path);
+  g_mkdir_with_parents (dirname, 0700);
+  g_unlink (path);
+  g_free (dirname);
+
+  /* one thread per connection, since jobs block until the child exits */
+  service = g_threaded_socket_service_new (-1);
+  if (!g_socket_listener_add_address (G_SOCKET_LISTENER (service), address, G_SOCKET_TYPE_STREAM,
+                                      G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error))
+    {
+      /* another helper won the race */
+      g_warning ("Failed to listen on %s: %s", path, error->message);
+      g_error_free (error);
+      g_object_unref (service);
+      g_object_unref (address);
+      g_free (path);
+      return EXIT_FAILURE;
+    }
+
+  g_signal_connect (G_OBJECT (service), "run", G_CALLBACK (tap_helper_run), NULL);
+  g_socket_service_start (service);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  tap_helper_last_active = g_get_monotonic_time ();
+  g_timeout_add_seconds (TAP_HELPER_IDLE_TIMEOUT / 10, tap_helper_idle, loop);
+  g_main_loop_run (loop);
+
+  g_socket_service_stop (service);
+  g_socket_listener_close (G_SOCKET_LISTENER (service));
+  g_unlink (path);
+
+  g_main_loop_unref (loop);
+  g_object_unref (service);
+  g_object_unref (address);
+  g_free (path);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <thunar-archive-plugin/tap-arena.h>
+
+
+
+/* the alignment of all allocations */
+#define TAP_ARENA_ALIGN(size) (((size) + 2 * sizeof (gpointer) - 1) & ~(2 * sizeof (gpointer) - 1))
+
+
+
+typedef struct _TapArenaChunk TapArenaChunk;
+
+
+
+struct _TapArena
+{
+  gsize          chunk_size;
+
+  /* the chunk that is filled now, the older ones behind it */
+  TapArenaChunk *chunks;
+  gsize          used;
+};
+
+struct _TapArenaChunk
+{
+  TapArenaChunk *next;
+  gsize          size;
+};
+
+
+
+/**
+ * tap_arena_new:
+ * @chunk_size : the size of the chunks the arena allocates from.
+ *
+ * Allocates an arena for many small blocks that are all released at
+ * once with tap_arena_reset(), like the metadata of archive entries.
+ * This is cheaper than a malloc() for every block, and does not leave
+ * the heap fragmented behind, so the memory of the process does not
+ * grow with the number of entries.
+ *
+ * Return value: the new #TapArena.
+ **/
+TapArena*
+tap_arena_new (gsize chunk_size)
+{
+  TapArena *arena;
+
+  g_return_val_if_fail (chunk_size > 0, NULL);
+
+  arena = g_slice_new0 (TapArena);
+  arena->chunk_size = chunk_size;
+
+  return arena;
+}
+
+
+
+/**
+ * tap_arena_free:
+ * @arena : a #TapArena.
+ *
+ * Releases the @arena and all blocks allocated from it.
+ **/
+void
+tap_arena_free (TapArena *arena)
+{
+  TapArenaChunk *chunk;
+
+  g_return_if_fail (arena != NULL);
+
+  while (arena->chunks != NULL)
+    {
+      chunk = arena->chunks;
+      arena->chunks = chunk->next;
+      g_free (chunk);
+    }
+
+  g_slice_free (TapArena, arena);
+}
+
+
+
+/**
+ * tap_arena_alloc:
+ * @arena : a #TapArena.
+ * @size  : the size of the block.
+ *
+ * Allocates a block of @size bytes from the @arena, which stays valid
+ * until the next tap_arena_reset(). Blocks larger than the chunks get
+ * a chunk of their own.
+ *
+ * Return value: the uninitialized block.
+ **/
+gpointer
+tap_arena_alloc (TapArena *arena,
+                 gsize     size)
+{
+  TapArenaChunk *chunk;
+  gsize          header = TAP_ARENA_ALIGN (sizeof (TapArenaChunk));
+  gpointer       block;
+
+  size = TAP_ARENA_ALIGN (MAX (size, 1));
+
+  if (arena->chunks == NULL || arena->used + size > arena->chunks->size)
+    {
+      chunk = g_malloc (header + MAX (size, arena->chunk_size));
+      chunk->size = header + MAX (size, arena->chunk_size);
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      arena->used = header;
+    }
+
+  block = (guint8 *) arena->chunks + arena->used;
+  arena->used += size;
+
+  return block;
+}
+
+
+
+/**
+ * tap_arena_strdup:
+ * @arena : a #TapArena.
+ * @str   : a string.
+ *
+ * Copies @str into the @arena, see tap_arena_alloc().
+ *
+ * Return value: the copy of @str.
+ **/
+gchar*
+tap_arena_strdup (TapArena    *arena,
+                  const gchar *str)
+{
+  gsize length = strlen (str) + 1;
+
+  return memcpy (tap_arena_alloc (arena, length), str, length);
+}
+
+
+
+/**
+ * tap_arena_reset:
+ * @arena : a #TapArena.
+ *
+ * Releases all blocks of the @arena at once. The first chunk is kept
+ * for the next blocks, so an arena that is reset regularly does not
+ * allocate at all anymore.
+ **/
+void
+tap_arena_reset (TapArena *arena)
+{
+  TapArenaChunk *chunk;
+
+  g_return_if_fail (arena != NULL);
+
+  if (arena->chunks == NULL)
+    return;
+
+  /* the oldest chunk is at the end of the list */
+  while (arena->chunks->next != NULL)
+    {
+      chunk = arena->chunks;
+      arena->chunks = chunk->next;
+      g_free (chunk);
+    }
+
+  arena->used = TAP_ARENA_ALIGN (sizeof (TapArenaChunk));
+}
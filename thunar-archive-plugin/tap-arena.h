@@ -0,0 +1,42 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_ARENA_H__
+#define __TAP_ARENA_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapArena TapArena;
+
+TapArena *tap_arena_new    (gsize        chunk_size) G_GNUC_INTERNAL G_GNUC_MALLOC;
+void      tap_arena_free   (TapArena    *arena) G_GNUC_INTERNAL;
+
+gpointer  tap_arena_alloc  (TapArena    *arena,
+                            gsize        size) G_GNUC_INTERNAL G_GNUC_MALLOC;
+gchar    *tap_arena_strdup (TapArena    *arena,
+                            const gchar *str) G_GNUC_INTERNAL G_GNUC_MALLOC;
+
+void      tap_arena_reset  (TapArena    *arena) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_ARENA_H__ */
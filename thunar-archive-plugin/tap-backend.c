@@ -19,15 +19,35 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
 #ifdef HAVE_MEMORY_H
 #include <memory.h>
 #endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
 
 #include <libxfce4util/libxfce4util.h>
 #include <thunar-archive-plugin/tap-backend.h>
+#include <thunar-archive-plugin/tap-peek.h>
+#include <thunar-archive-plugin/tap-scheduler.h>
+#include <thunar-archive-plugin/tap-trace.h>
+#include <thunar-archive-plugin/tap-wrappers.h>
+#ifdef HAVE_LIBARCHIVE
+#include <thunar-archive-plugin/tap-native.h>
+#endif
 #ifdef GDK_WINDOWING_WAYLAND
 #include <gdk/gdkwayland.h>
 #endif
@@ -38,17 +58,80 @@ static GAppInfo *tap_backend_mime_ask                   (GList       *mime_appli
                                                          GtkWidget   *parent);
 static gint      tap_backend_mime_application_compare   (GAppInfo    *a,
                                                          GAppInfo    *b);
-static GList    *tap_backend_mime_applications          (GList       *content_types);
-static GAppInfo *tap_backend_mime_application           (GList       *content_types,
-                                                         GtkWidget   *window,
-                                                         GError     **error);
-static gchar    *tap_backend_mime_wrapper               (GAppInfo    *mime_application) G_GNUC_MALLOC;
-static GPid      tap_backend_run                        (const gchar *action,
-                                                         const gchar *folder,
-                                                         GList       *files,
-                                                         GList       *content_types,
+static GPtrArray *tap_backend_content_types_new         (const gchar **mime_types,
+                                                         guint         n_mime_types) G_GNUC_MALLOC;
+static gchar    *tap_backend_mime_applications_key      (GPtrArray   *content_types) G_GNUC_MALLOC;
+static GList    *tap_backend_mime_applications_query    (GPtrArray   *content_types);
+static GList    *tap_backend_mime_applications          (GPtrArray   *content_types);
+static GAppInfo *tap_backend_mime_application           (GPtrArray   *content_types,
                                                          GtkWidget   *window,
                                                          GError     **error);
+static gint      tap_backend_file_list                  (TapSelection *selection);
+static gchar   **tap_backend_environ                    (GtkWidget    *window,
+                                                         gboolean      file_list);
+static void      tap_backend_environ_reset              (void);
+static void      tap_backend_extract_free               (gpointer      data);
+static gint      tap_backend_extract_peek               (guint         n_threads,
+                                                         gpointer      user_data);
+static void      tap_backend_extract_start              (gint          status,
+                                                         gpointer      user_data);
+static void      tap_backend_extract_done               (gint          status,
+                                                         gpointer      user_data);
+static gboolean  tap_backend_run                        (const gchar  *action,
+                                                         const gchar  *folder,
+                                                         TapSelection *selection,
+                                                         GPtrArray    *content_types,
+                                                         GtkWidget    *window,
+                                                         GError      **error);
+
+
+
+typedef struct
+{
+  GtkWidget             *window;
+  GAppInfo              *mime_application;
+  TapWrapperCapabilities capabilities;
+  gchar                 *folder;
+  gchar                 *filename;
+  guint64                size;
+
+  /* decided by the peek, the subfolder created for the archive, if any */
+  gboolean               single_root;
+  gchar                 *subfolder;
+
+  /* set by the peek if the archive does not fit into the folder */
+  GError                *error;
+} TapBackendExtract;
+
+
+
+/* selections whose paths exceed this size in the argv are handed to wrappers
+ * that support it through a file list on stdin, to avoid E2BIG from exec and
+ * the cost of copying huge argument vectors into the new process.
+ */
+#define TAP_BACKEND_ARGV_MAX (128 * 1024)
+
+
+
+/* the mime types every supported archive manager must handle to create archives */
+static const gchar TAP_CREATE_MIME_TYPES[][29] = {
+  "application/x-compressed-tar",
+  "application/x-tar",
+  "application/x-zip",
+  "application/zip",
+};
+
+/* process-wide cache of the applications that can handle a set of content
+ * types, keyed by the normalized set, dropped whenever GIO reports changes
+ * to the application database or the mimeapps.list files.
+ */
+static GHashTable      *tap_backend_cache = NULL;
+static GAppInfoMonitor *tap_backend_cache_monitor = NULL;
+static guint            tap_backend_cache_generation = 0;
+
+/* the environment blocks for the wrappers, precomputed for the display */
+static gchar           *tap_backend_environ_display = NULL;
+static gchar          **tap_backend_environ_blocks[2] = { NULL, NULL };
 
 
 
@@ -178,25 +261,97 @@ tap_backend_mime_application_compare (GAppInfo *a,
 
 
 
+static gint
+tap_backend_compare_strings (gconstpointer a,
+                             gconstpointer b)
+{
+  return strcmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+
+
+static void
+tap_backend_app_list_free (gpointer mime_applications)
+{
+  g_list_free_full (mime_applications, g_object_unref);
+}
+
+
+
+static GPtrArray*
+tap_backend_content_types_new (const gchar **mime_types,
+                               guint         n_mime_types)
+{
+  const gchar *content_type;
+  GHashTable  *seen_mime_types;
+  GHashTable  *seen_content_types;
+  GPtrArray   *content_types;
+  gchar       *s;
+  guint        n;
+
+  seen_mime_types = g_hash_table_new (g_direct_hash, g_direct_equal);
+  seen_content_types = g_hash_table_new (g_direct_hash, g_direct_equal);
+  content_types = g_ptr_array_new ();
+
+  for (n = 0; n < n_mime_types; ++n)
+    {
+      /* the mime types are usually interned, so most duplicates are skipped right here */
+      if (G_UNLIKELY (mime_types[n] == NULL) || !g_hash_table_add (seen_mime_types, (gpointer) mime_types[n]))
+        continue;
+
+      /* intern the content type, so that aliases collapse into a single entry */
+      s = g_content_type_from_mime_type (mime_types[n]);
+      content_type = g_intern_string (s);
+      g_free (s);
+
+      if (g_hash_table_add (seen_content_types, (gpointer) content_type))
+        g_ptr_array_add (content_types, (gpointer) content_type);
+    }
+
+  /* sort the set, so neither the cache key nor the resolution depends on the selection order */
+  g_ptr_array_sort (content_types, tap_backend_compare_strings);
+
+  g_hash_table_destroy (seen_content_types);
+  g_hash_table_destroy (seen_mime_types);
+
+  return content_types;
+}
+
+
+
+static gchar*
+tap_backend_mime_applications_key (GPtrArray *content_types)
+{
+  GString *key;
+  guint    n;
+
+  /* join the sorted set of content types */
+  key = g_string_new (NULL);
+  for (n = 0; n < content_types->len; ++n)
+    {
+      g_string_append (key, g_ptr_array_index (content_types, n));
+      g_string_append_c (key, ';');
+    }
+
+  return g_string_free (key, FALSE);
+}
+
+
+
 static GList*
-tap_backend_mime_applications (GList *content_types)
+tap_backend_mime_applications_query (GPtrArray *content_types)
 {
   GList *mime_applications = NULL;
   GList *list;
   GList *next;
   GList *ap;
-  GList *lp;
-  gchar *s;
+  guint  n;
 
   /* determine the set of applications that can handle all mime types */
-  for (lp = content_types; lp != NULL; lp = lp->next)
+  for (n = 0; n < content_types->len; ++n)
     {
-      /* no need to check anything if this is the same mime type as the previous one */
-      if (lp->prev != NULL && lp->prev->data == lp->data)
-        continue;
-
       /* determine the list of applications that can handle this mime type */
-      list = g_app_info_get_all_for_type (lp->data);
+      list = g_app_info_get_all_for_type (g_ptr_array_index (content_types, n));
       if (G_UNLIKELY (mime_applications == NULL))
         {
           /* first file, so just use the applications list */
@@ -230,6 +385,39 @@ tap_backend_mime_applications (GList *content_types)
         break;
     }
 
+  return mime_applications;
+}
+
+
+
+static GList*
+tap_backend_mime_applications (GPtrArray *content_types)
+{
+  GList *mime_applications = NULL;
+  GList *next;
+  GList *ap;
+  gchar *key;
+
+  TAP_TRACE_SCOPE ("mime-applications");
+
+  /* lookup the cached applications for this set of content types */
+  key = tap_backend_mime_applications_key (content_types);
+  if (tap_backend_cache != NULL && g_hash_table_lookup_extended (tap_backend_cache, key, NULL, (gpointer *) &mime_applications))
+    {
+      /* take a copy, the wrapper filtering below modifies the list */
+      mime_applications = g_list_copy_deep (mime_applications, (GCopyFunc) g_object_ref, NULL);
+      g_free (key);
+    }
+  else
+    {
+      /* determine the applications and remember them for the next time */
+      mime_applications = tap_backend_mime_applications_query (content_types);
+      if (G_LIKELY (tap_backend_cache != NULL))
+        g_hash_table_insert (tap_backend_cache, key, g_list_copy_deep (mime_applications, (GCopyFunc) g_object_ref, NULL));
+      else
+        g_free (key);
+    }
+
   /* filter out any unsupported applications */
   for (ap = mime_applications; ap != NULL; ap = next)
     {
@@ -237,8 +425,7 @@ tap_backend_mime_applications (GList *content_types)
       next = ap->next;
 
       /* check if we have a wrapper for this application */
-      s = tap_backend_mime_wrapper (ap->data);
-      if (G_UNLIKELY (s == NULL))
+      if (G_UNLIKELY (tap_wrappers_lookup (ap->data, NULL) == NULL))
         {
           /* drop our reference on the application */
           g_object_unref (G_OBJECT (ap->data));
@@ -246,7 +433,6 @@ tap_backend_mime_applications (GList *content_types)
           /* drop the application from the list */
           mime_applications = g_list_delete_link (mime_applications, ap);
         }
-      g_free (s);
     }
 
   return mime_applications;
@@ -255,7 +441,7 @@ tap_backend_mime_applications (GList *content_types)
 
 
 static GAppInfo*
-tap_backend_mime_application (GList     *content_types,
+tap_backend_mime_application (GPtrArray *content_types,
                               GtkWidget *window,
                               GError   **error)
 {
@@ -263,7 +449,9 @@ tap_backend_mime_application (GList     *content_types,
   GAppInfo                 *app_info;
   GError                   *err = NULL;
   GList                    *mime_applications;
-  GList                    *lp;
+  guint                     n;
+
+  TAP_TRACE_SCOPE ("mime-application");
 
   /* determine the mime applications that can handle the mime types */
   mime_applications = tap_backend_mime_applications (content_types);
@@ -283,10 +471,10 @@ tap_backend_mime_application (GList     *content_types,
       /* more than one supported archive manager, check if the first
        * available is the default for all its supported mime types.
        */
-      for (lp = content_types; lp != NULL; lp = lp->next)
+      for (n = 0; n < content_types->len; ++n)
         {
           /* determine the default application for this mime type */
-          app_info = g_app_info_get_default_for_type (lp->data, FALSE);
+          app_info = g_app_info_get_default_for_type (g_ptr_array_index (content_types, n), FALSE);
 
           /* no default applications for this mime type */
           if (app_info == NULL)
@@ -305,7 +493,7 @@ tap_backend_mime_application (GList     *content_types,
         }
 
       /* check if we have found a suitable one */
-      if (G_LIKELY (lp == NULL))
+      if (G_LIKELY (n == content_types->len))
         {
           /* use the first available archive manager */
           mime_application = G_APP_INFO (g_object_ref (G_OBJECT (mime_applications->data)));
@@ -319,15 +507,15 @@ tap_backend_mime_application (GList     *content_types,
               /* make the selected application the default for all its
                * supported mime types, so we don't need to ask once again.
                */
-              for (lp = content_types; lp != NULL; lp = lp->next)
+              for (n = 0; n < content_types->len; ++n)
                 {
                   /* set the default application */
-                  if (!g_app_info_set_as_default_for_type (mime_application, lp->data, &err))
+                  if (!g_app_info_set_as_default_for_type (mime_application, g_ptr_array_index (content_types, n), &err))
                     {
                       /* not critical, still we should tell the user that we failed */
                       g_warning ("Failed to make \"%s\" the default application for %s: %s",
                                  g_app_info_get_name (mime_application),
-                                 (char*) lp->data, err->message);
+                                 (char*) g_ptr_array_index (content_types, n), err->message);
                       g_clear_error (&err);
                     }
                 }
@@ -343,79 +531,311 @@ tap_backend_mime_application (GList     *content_types,
 
 
 
-static gchar*
-tap_backend_mime_wrapper (GAppInfo *mime_application)
+static gboolean
+tap_backend_write_all (gint         fd,
+                       const gchar *data,
+                       gsize        length)
+{
+  gssize n;
+
+  while (length > 0)
+    {
+      n = write (fd, data, length);
+      if (G_UNLIKELY (n < 0))
+        {
+          if (errno == EINTR)
+            continue;
+          return FALSE;
+        }
+
+      data += n;
+      length -= n;
+    }
+
+  return TRUE;
+}
+
+
+
+static gint
+tap_backend_file_list (TapSelection *selection)
 {
-  const gchar *desktop_id;
-  gchar       *base_name;
-  gchar       *filename;
-  gchar       *dot;
-
-  /* determine the basename of the .desktop file */
-  desktop_id = g_app_info_get_id (mime_application);
-  base_name = g_path_get_basename (desktop_id);
-  dot = strrchr (base_name, '.');
-  if (G_LIKELY (dot != NULL))
-    *dot = '\0';
-
-  /* generate the filename for the .tap wrapper script */
-  filename = g_strdup_printf (LIBEXECDIR G_DIR_SEPARATOR_S "thunar-archive-plugin" G_DIR_SEPARATOR_S "%s.tap", base_name);
-
-  /* check if the wrapper script exists */
-  if (!g_file_test (filename, G_FILE_TEST_IS_EXECUTABLE))
+  gboolean succeed = TRUE;
+  GString *buffer;
+  gchar   *filename;
+  guint    n;
+  gint     fd = -1;
+
+  /* prefer an anonymous in-memory file, fallback to an unlinked temporary file */
+#ifdef HAVE_MEMFD_CREATE
+  fd = memfd_create ("tap-file-list", MFD_CLOEXEC);
+#endif
+  if (G_UNLIKELY (fd < 0))
     {
-      /* no wrapper then */
+      fd = g_file_open_tmp ("tap-file-list-XXXXXX", &filename, NULL);
+      if (G_UNLIKELY (fd < 0))
+        return -1;
+
+      g_unlink (filename);
       g_free (filename);
-      filename = NULL;
     }
 
-  /* cleanup */
-  g_free (base_name);
+  /* write the NUL-separated paths in large batches */
+  buffer = g_string_sized_new (64 * 1024);
+  for (n = 0; succeed && n < selection->n_files; ++n)
+    {
+      g_string_append_len (buffer, selection->paths[n], strlen (selection->paths[n]) + 1);
+      if (buffer->len >= 64 * 1024 || n + 1 == selection->n_files)
+        {
+          succeed = tap_backend_write_all (fd, buffer->str, buffer->len);
+          g_string_truncate (buffer, 0);
+        }
+    }
+  g_string_free (buffer, TRUE);
+
+  /* rewind, so the wrapper reads the list from the start */
+  if (G_UNLIKELY (!succeed || lseek (fd, 0, SEEK_SET) < 0))
+    {
+      close (fd);
+      return -1;
+    }
 
-  return filename;
+  return fd;
 }
 
 
 
-static GPid
-tap_backend_run (const gchar *action,
-                 const gchar *folder,
-                 GList       *files,
-                 GList       *content_types,
-                 GtkWidget   *window,
-                 GError     **error)
+static gchar**
+tap_backend_environ (GtkWidget *window,
+                     gboolean   file_list)
 {
-  GAppInfo                 *mime_application;
-  gchar                    *mime_type;
-  GdkScreen                *screen;
-  GdkDisplay               *display;
-  gchar                    *wrapper;
-  gchar                   **argv;
-  gchar                   **envp;
-  gchar                    *uri;
-  GList                    *lp;
-  GPid                      pid = -1;
-  gint                      n;
-  const gchar              *displayname;
-
-  /* determine the mime infos on-demand */
-  if (G_LIKELY (content_types == NULL))
+  GdkDisplay  *display;
+  const gchar *displayname;
+  gchar      **envp;
+
+  /* determine the display for this window */
+  display = gtk_widget_get_display (window);
+  displayname = (display != NULL) ? gdk_display_get_name (display) : NULL;
+
+  /* build the blocks once per display, rather than copying the environment for every job */
+  if (tap_backend_environ_blocks[0] == NULL || g_strcmp0 (displayname, tap_backend_environ_display) != 0)
     {
-      /* determine the mime infos from the files */
-      for (lp = files; lp != NULL; lp = lp->next)
+      tap_backend_environ_reset ();
+
+      envp = g_get_environ ();
+      if (displayname != NULL)
         {
-          mime_type = thunarx_file_info_get_mime_type (THUNARX_FILE_INFO (lp->data));
-          content_types = g_list_append (content_types, g_content_type_from_mime_type (mime_type));
-          g_free (mime_type);
+#ifdef GDK_WINDOWING_WAYLAND
+          if (GDK_IS_WAYLAND_DISPLAY (display))
+            {
+              envp = g_environ_setenv (envp, "WAYLAND_DISPLAY", displayname, TRUE);
+            }
+          else
+#endif
+          if (TRUE) {
+              envp = g_environ_setenv(envp, "DISPLAY", displayname, TRUE);
+            }
         }
+
+      tap_backend_environ_display = g_strdup (displayname);
+      tap_backend_environ_blocks[0] = envp;
+
+      /* the block for wrappers reading the files from stdin */
+      tap_backend_environ_blocks[1] = g_environ_setenv (g_strdupv (envp), "TAP_FILE_LIST", "stdin", TRUE);
+    }
+
+  return tap_backend_environ_blocks[file_list ? 1 : 0];
+}
+
+
+
+static void
+tap_backend_environ_reset (void)
+{
+  g_strfreev (tap_backend_environ_blocks[0]);
+  g_strfreev (tap_backend_environ_blocks[1]);
+  tap_backend_environ_blocks[0] = NULL;
+  tap_backend_environ_blocks[1] = NULL;
+  g_free (tap_backend_environ_display);
+  tap_backend_environ_display = NULL;
+}
+
+
+
+static void
+tap_backend_extract_free (gpointer data)
+{
+  TapBackendExtract *extract = data;
+
+  g_object_unref (G_OBJECT (extract->mime_application));
+  g_object_unref (G_OBJECT (extract->window));
+  if (extract->error != NULL)
+    g_error_free (extract->error);
+  g_free (extract->subfolder);
+  g_free (extract->filename);
+  g_free (extract->folder);
+  g_slice_free (TapBackendExtract, extract);
+}
+
+
+
+static gint
+tap_backend_extract_peek (guint    n_threads,
+                          gpointer user_data)
+{
+  TapBackendExtract *extract = user_data;
+  TapPeekResult      result;
+  gchar             *root = NULL;
+  gchar             *path;
+
+  /* peek at the headers, so all archive managers agree on the subfolder */
+  result = tap_peek_archive (extract->filename, &root);
+  if (result == TAP_PEEK_SINGLE_ROOT)
+    {
+      /* don't let the archive manager merge the root into an existing one */
+      path = g_build_filename (extract->folder, root, NULL);
+      extract->single_root = (!g_file_test (path, G_FILE_TEST_EXISTS) && !g_file_test (path, G_FILE_TEST_IS_SYMLINK));
+      g_free (path);
+      g_free (root);
+    }
+
+  /* the peek indexed the archive, so don't even start archive managers that run out of space */
+  if (!tap_peek_check_space (extract->filename, extract->folder, &extract->error))
+    return 1;
+
+  /* create the subfolder for archive managers that extract right into the folder */
+  if (!extract->single_root && (extract->capabilities & TAP_WRAPPER_DESTINATION) != 0)
+    {
+      path = tap_peek_subfolder (extract->folder, extract->filename);
+      if (G_LIKELY (g_mkdir (path, 0777) == 0))
+        extract->subfolder = path;
+      else
+        g_free (path);
+    }
+
+  return 0;
+}
+
+
+
+static void
+tap_backend_extract_start (gint     status,
+                           gpointer user_data)
+{
+  TapBackendExtract *extract = user_data;
+  const TapWrapper  *wrapper;
+  const gchar       *destination;
+  const gchar       *action = "extract-here";
+  GStringChunk      *strings;
+  TapJob            *job;
+  GError            *error = NULL;
+  gchar            **envp;
+  gchar            **argv;
+
+  if (G_UNLIKELY (extract->error != NULL))
+    {
+      g_warning ("%s", extract->error->message);
+      return;
+    }
+
+  /* without a subfolder of the plugin, the archive manager has to create one itself,
+   * which scripts do if $TAP_SUBFOLDER is unset, and descriptors with a variant of
+   * the action, or else they are replaced by their script if there's one
+   */
+  if (!extract->single_root && extract->subfolder == NULL
+      && (extract->capabilities & TAP_WRAPPER_DESTINATION) != 0)
+    action = "extract-here-subfolder";
+
+  /* the archive managers may have changed while peeking */
+  wrapper = tap_wrappers_lookup (extract->mime_application, action);
+  if (wrapper == NULL || wrapper->actions == NULL)
+    {
+      action = "extract-here";
+      if (wrapper == NULL)
+        wrapper = tap_wrappers_lookup (extract->mime_application, action);
+    }
+  if (G_UNLIKELY (wrapper == NULL))
+    {
+      g_warning ("Failed to extract \"%s\": No suitable archive manager found", extract->filename);
+      if (extract->subfolder != NULL)
+        g_rmdir (extract->subfolder);
+      return;
     }
 
+  /* the decision differs per archive, so copy the shared block */
+  envp = g_strdupv (tap_backend_environ (extract->window, FALSE));
+  if (extract->single_root)
+    envp = g_environ_setenv (envp, "TAP_SUBFOLDER", "0", TRUE);
+  else if (extract->subfolder != NULL)
+    envp = g_environ_setenv (envp, "TAP_SUBFOLDER", "1", TRUE);
+
+  destination = (extract->subfolder != NULL) ? extract->subfolder : extract->folder;
+  strings = g_string_chunk_new (256);
+  argv = tap_wrapper_argv (wrapper, action, destination, &extract->filename, 1, strings);
+
+  job = tap_job_new_spawn (destination, argv, envp, -1);
+  tap_job_add_input (job, extract->filename);
+  tap_job_set_info (job, "extract-here", g_app_info_get_id (extract->mime_application), extract->size);
+  if (extract->subfolder != NULL)
+    tap_job_set_done (job, tap_backend_extract_done, g_strdup (extract->subfolder), g_free);
+  if (!tap_scheduler_submit (job, &error))
+    {
+      g_warning ("Failed to extract \"%s\": %s", extract->filename, error->message);
+      g_error_free (error);
+      if (extract->subfolder != NULL)
+        g_rmdir (extract->subfolder);
+    }
+
+  g_string_chunk_free (strings);
+  g_strfreev (envp);
+  g_free (argv);
+}
+
+
+
+static void
+tap_backend_extract_done (gint     status,
+                          gpointer user_data)
+{
+  /* drop the subfolder if the archive manager failed or was cancelled before
+   * extracting anything, which only succeeds as long as it is empty */
+  if (status != 0)
+    g_rmdir (user_data);
+}
+
+
+
+static gboolean
+tap_backend_run (const gchar  *action,
+                 const gchar  *folder,
+                 TapSelection *selection,
+                 GPtrArray    *content_types,
+                 GtkWidget    *window,
+                 GError      **error)
+{
+  TapBackendExtract        *extract;
+  GAppInfo                 *mime_application;
+  const TapWrapper         *wrapper;
+  GStringChunk             *strings;
+  TapJob                   *job;
+  gboolean                  succeed = FALSE;
+  gboolean                  split;
+  gchar                   **argv;
+  gsize                     argv_size = 0;
+  guint64                   input_bytes = 0;
+  guint                     n;
+  gint                      file_list = -1;
+
+  /* determine the distinct content types on-demand, so the resolution scales with the number of formats */
+  if (G_LIKELY (content_types == NULL))
+    content_types = tap_backend_content_types_new (selection->mime_types, selection->n_files);
+
   /* determine the mime application to use */
   mime_application = tap_backend_mime_application (content_types, window, error);
   if (G_LIKELY (mime_application != NULL))
     {
-      /* determine the wrapper script for the application */
-      wrapper = tap_backend_mime_wrapper (mime_application);
+      /* determine the descriptor or wrapper script for the application */
+      wrapper = tap_wrappers_lookup (mime_application, action);
       if (G_UNLIKELY (wrapper == NULL))
         {
           /* tell the user that we cannot handle the specified mime types */
@@ -423,51 +843,82 @@ tap_backend_run (const gchar *action,
         }
       else
         {
-          /* generate the command to run the wrapper */
-          argv = g_new0 (gchar *, 4 + g_list_length (files));
-          argv[0] = wrapper;
-          argv[1] = g_strdup (action);
-          argv[2] = g_strdup (folder);
-
-          /* append the file paths */
-          for (lp = files, n = 3; lp != NULL; lp = lp->next, ++n)
-            {
-              uri = thunarx_file_info_get_uri (THUNARX_FILE_INFO (lp->data));
-              argv[n] = g_filename_from_uri (uri, NULL, NULL);
-              g_free (uri);
-            }
+          /* the expanded arguments of descriptors, the others are owned by the wrapper and the selection */
+          strings = g_string_chunk_new (256);
 
-          envp = g_get_environ();
+          /* extract every archive in a job of its own, so the scheduler can run them concurrently and
+           * the subfolder is decided per archive, and also if the archive manager only takes one at a time
+           */
+          split = (strcmp (action, "extract-here") == 0
+                   || (selection->n_files > 1 && strcmp (action, "create") != 0
+                       && (wrapper->capabilities & TAP_WRAPPER_MULTI_FILE) == 0));
 
-          /* determine the screen for this window */
-          screen = gtk_widget_get_screen (window);
-
-          if (screen != NULL)
+          if (split)
             {
-              display = gdk_screen_get_display (screen);
-              displayname = gdk_display_get_name (display);
-              if (displayname != NULL)
+              for (n = 0, succeed = TRUE; succeed && n < selection->n_files; ++n)
                 {
-#ifdef GDK_WINDOWING_WAYLAND
-                  if (GDK_IS_WAYLAND_DISPLAY (display))
+                  /* "extract-here" may go to a subfolder, decided by peeking at the archive on a worker */
+                  if (strcmp (action, "extract-here") == 0)
                     {
-                      envp = g_environ_setenv (envp, "WAYLAND_DISPLAY", displayname, TRUE);
+                      extract = g_slice_new0 (TapBackendExtract);
+                      extract->window = g_object_ref (G_OBJECT (window));
+                      extract->mime_application = g_object_ref (G_OBJECT (mime_application));
+                      extract->capabilities = wrapper->capabilities;
+                      extract->folder = g_strdup (folder);
+                      extract->filename = g_strdup (selection->paths[n]);
+                      extract->size = tap_selection_get_size (selection, n);
+
+                      job = tap_job_new_thread (folder, tap_backend_extract_peek, tap_backend_extract_start,
+                                                extract, tap_backend_extract_free);
+                      tap_job_add_input (job, selection->paths[n]);
+                      succeed = tap_scheduler_submit (job, error);
                     }
                   else
-#endif
-                  if (TRUE) {
-                      envp = g_environ_setenv(envp, "DISPLAY", displayname, TRUE);
+                    {
+                      argv = tap_wrapper_argv (wrapper, action, folder, selection->paths + n, 1, strings);
+                      job = tap_job_new_spawn (folder, argv, tap_backend_environ (window, FALSE), -1);
+                      tap_job_add_input (job, selection->paths[n]);
+                      tap_job_set_info (job, action, g_app_info_get_id (mime_application),
+                                        tap_selection_get_size (selection, n));
+                      succeed = tap_scheduler_submit (job, error);
+                      g_free (argv);
                     }
                 }
             }
+          else
+            {
+              /* check whether the file paths would blow up the argv */
+              for (n = 0; n < selection->n_files && argv_size <= TAP_BACKEND_ARGV_MAX; ++n)
+                argv_size += strlen (selection->paths[n]) + 1 + sizeof (gchar *);
 
-          /* try to run the command */
-          if (!g_spawn_async (folder, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, error))
-            pid = -1;
+              if (argv_size > TAP_BACKEND_ARGV_MAX)
+                {
+                  /* the script of a descriptor may pipe the list through xargs */
+                  if ((wrapper->capabilities & TAP_WRAPPER_FILE_LIST_STDIN) == 0 && wrapper->fallback != NULL
+                      && (wrapper->fallback->capabilities & TAP_WRAPPER_FILE_LIST_STDIN) != 0)
+                    wrapper = wrapper->fallback;
+
+                  /* hand huge selections to wrappers that support it on stdin */
+                  if ((wrapper->capabilities & TAP_WRAPPER_FILE_LIST_STDIN) != 0)
+                    file_list = tap_backend_file_list (selection);
+                }
+
+              /* the file paths are left out if they are passed on stdin */
+              argv = tap_wrapper_argv (wrapper, action, folder, selection->paths,
+                                       (file_list < 0) ? selection->n_files : 0, strings);
+
+              /* queue the command, the job takes over the file list, and the environment tells the wrapper about it */
+              job = tap_job_new_spawn (folder, argv, tap_backend_environ (window, file_list >= 0), file_list);
+              tap_job_add_input (job, selection->paths[0]);
+              for (n = 0; n < selection->n_files; ++n)
+                input_bytes += tap_selection_get_size (selection, n);
+              tap_job_set_info (job, action, g_app_info_get_id (mime_application), input_bytes);
+              succeed = tap_scheduler_submit (job, error);
+              g_free (argv);
+            }
 
           /* cleanup */
-          g_strfreev (envp);
-          g_strfreev (argv);
+          g_string_chunk_free (strings);
         }
 
       /* cleanup */
@@ -475,124 +926,325 @@ tap_backend_run (const gchar *action,
     }
 
   /* cleanup */
-  g_list_free_full (content_types, g_free);
+  g_ptr_array_unref (content_types);
+
+  return succeed;
+}
+
+
+
+
+
+
+static gboolean
+tap_backend_create_archive_wrapper (const gchar  *folder,
+                                    TapSelection *selection,
+                                    GtkWidget    *window,
+                                    GError      **error)
+{
+  const gchar *mime_types[G_N_ELEMENTS (TAP_CREATE_MIME_TYPES)];
+  GPtrArray   *content_types;
+  guint        n;
+
+  /* determine the content types for zip and tar files (all supported archives must be able to handle them) */
+  for (n = 0; n < G_N_ELEMENTS (TAP_CREATE_MIME_TYPES); ++n)
+    mime_types[n] = TAP_CREATE_MIME_TYPES[n];
+  content_types = tap_backend_content_types_new (mime_types, G_N_ELEMENTS (mime_types));
+
+  /* run the action, the mime infos will be freed by the _run() method */
+  return tap_backend_run ("create", folder, selection, content_types, window, error);
+}
+
+
+
+#ifdef HAVE_LIBARCHIVE
+static gboolean
+tap_backend_extract_here_wrapper (const gchar  *folder,
+                                  TapSelection *selection,
+                                  GtkWidget    *window,
+                                  GError      **error)
+{
+  /* the archives the native engine cannot handle */
+  return tap_backend_run ("extract-here", folder, selection, NULL, window, error);
+}
+#endif
+
+
 
-  return pid;
+static void
+tap_backend_cache_invalidate (GAppInfoMonitor *monitor,
+                              gpointer         user_data)
+{
+  /* forget about all resolved applications, and discard pending prefills */
+  if (G_LIKELY (tap_backend_cache != NULL))
+    g_hash_table_remove_all (tap_backend_cache);
+  tap_backend_cache_generation += 1;
+}
+
+
+
+static void
+tap_backend_cache_prefill_thread (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  /* query the applications without blocking the main loop */
+  g_task_return_pointer (task, tap_backend_mime_applications_query (task_data), tap_backend_app_list_free);
+}
+
+
+
+static void
+tap_backend_cache_prefill_ready (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  GList *mime_applications;
+  gchar *key;
+
+  mime_applications = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  /* drop the result if the cache was shut down or invalidated meanwhile */
+  if (tap_backend_cache == NULL || GPOINTER_TO_UINT (user_data) != tap_backend_cache_generation)
+    {
+      tap_backend_app_list_free (mime_applications);
+      return;
+    }
+
+  /* don't replace an entry that was resolved on the main thread meanwhile */
+  key = tap_backend_mime_applications_key (g_task_get_task_data (G_TASK (result)));
+  if (!g_hash_table_contains (tap_backend_cache, key))
+    g_hash_table_insert (tap_backend_cache, key, mime_applications);
+  else
+    {
+      tap_backend_app_list_free (mime_applications);
+      g_free (key);
+    }
+}
+
+
+
+static void
+tap_backend_cache_prefill (GPtrArray *content_types)
+{
+  GTask *task;
+
+  task = g_task_new (NULL, NULL, tap_backend_cache_prefill_ready, GUINT_TO_POINTER (tap_backend_cache_generation));
+  g_task_set_task_data (task, content_types, (GDestroyNotify) g_ptr_array_unref);
+  g_task_run_in_thread (task, tap_backend_cache_prefill_thread);
+  g_object_unref (task);
+}
+
+
+
+/**
+ * tap_backend_initialize:
+ *
+ * Sets up the archive manager resolution cache, and starts resolving
+ * the archive managers for the most common actions in the background,
+ * so the first context menu does not need to wait for them.
+ **/
+void
+tap_backend_initialize (void)
+{
+  const gchar *mime_types[G_N_ELEMENTS (TAP_CREATE_MIME_TYPES)];
+  guint        n;
+
+  g_return_if_fail (tap_backend_cache == NULL);
+
+  tap_backend_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, tap_backend_app_list_free);
+
+  /* drop the cache whenever the application database or the defaults change */
+  tap_backend_cache_monitor = g_app_info_monitor_get ();
+  g_signal_connect (G_OBJECT (tap_backend_cache_monitor), "changed", G_CALLBACK (tap_backend_cache_invalidate), NULL);
+
+  /* resolve the set used by "Create Archive..." and each of its types */
+  for (n = 0; n < G_N_ELEMENTS (TAP_CREATE_MIME_TYPES); ++n)
+    {
+      mime_types[n] = TAP_CREATE_MIME_TYPES[n];
+      tap_backend_cache_prefill (tap_backend_content_types_new (mime_types + n, 1));
+    }
+  tap_backend_cache_prefill (tap_backend_content_types_new (mime_types, G_N_ELEMENTS (mime_types)));
 }
 
 
 
+/**
+ * tap_backend_shutdown:
+ *
+ * Releases the archive manager resolution cache.
+ **/
+void
+tap_backend_shutdown (void)
+{
+  if (G_LIKELY (tap_backend_cache_monitor != NULL))
+    {
+      g_signal_handlers_disconnect_by_func (G_OBJECT (tap_backend_cache_monitor), tap_backend_cache_invalidate, NULL);
+      g_clear_object (&tap_backend_cache_monitor);
+    }
+
+  if (G_LIKELY (tap_backend_cache != NULL))
+    {
+      g_hash_table_destroy (tap_backend_cache);
+      tap_backend_cache = NULL;
+    }
+
+  tap_backend_cache_generation += 1;
+
+  /* release the environment blocks */
+  tap_backend_environ_reset ();
+}
 
 
 
 /**
  * tap_backend_create_archive:
- * @folder : the path to the folder in which to create the archive.
- * @files  : a #GList of #ThunarxFileInfo<!---->s that refer to the
- *           files that should be added to the new archive.
- * @window : a #GtkWindow, used to popup dialogs.
- * @error  : return location for errors or %NULL.
+ * @folder    : the path to the folder in which to create the archive.
+ * @selection : the #TapSelection with the files that should be
+ *              added to the new archive.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @error     : return location for errors or %NULL.
  *
- * Spawns a command to create a new archive in @folder with the
- * specified @files, using the default archive manager.
+ * Schedules a command to create a new archive in @folder with the
+ * files in @selection, using the default archive manager.
  *
- * Note that %-1 will also be returned when the user cancels this
+ * Note that %FALSE will also be returned when the user cancels this
  * operation, but @error will not be set then.
  *
- * Return value: the process id of the spawned command, or %-1
- *               on error.
+ * Return value: %TRUE if the command was scheduled, %FALSE on error.
  **/
-GPid
-tap_backend_create_archive (const gchar *folder,
-                            GList       *files,
-                            GtkWidget   *window,
-                            GError     **error)
+gboolean
+tap_backend_create_archive (const gchar  *folder,
+                            TapSelection *selection,
+                            GtkWidget    *window,
+                            GError      **error)
 {
-  GList *content_types = NULL;
+  g_return_val_if_fail (selection != NULL && selection->n_files > 0, FALSE);
+  g_return_val_if_fail (GTK_IS_WINDOW (window), FALSE);
+  g_return_val_if_fail (g_path_is_absolute (folder), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  g_return_val_if_fail (files != NULL, -1);
-  g_return_val_if_fail (GTK_IS_WINDOW (window), -1);
-  g_return_val_if_fail (g_path_is_absolute (folder), -1);
-  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+  return tap_backend_create_archive_wrapper (folder, selection, window, error);
+}
 
-  /* determine the content types for zip and tar files (all supported archives must be able to handle them) */
-  content_types = g_list_append (content_types, g_content_type_from_mime_type ("application/x-compressed-tar"));
-  content_types = g_list_append (content_types, g_content_type_from_mime_type ("application/x-tar"));
-  content_types = g_list_append (content_types, g_content_type_from_mime_type ("application/x-zip"));
-  content_types = g_list_append (content_types, g_content_type_from_mime_type ("application/zip"));
 
-  /* run the action, the mime infos will be freed by the _run() method */
-  return tap_backend_run ("create", folder, files, content_types, window, error);
+
+#ifdef HAVE_LIBARCHIVE
+/**
+ * tap_backend_compress:
+ * @folder    : the path to the folder in which to create the archive.
+ * @selection : the #TapSelection with the files that should be
+ *              added to the new archive.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @error     : return location for errors or %NULL.
+ *
+ * Asks the user for the name, format and compression level of a new
+ * archive in @folder with the files in @selection, and creates it
+ * in-process on several cores, since archive managers usually
+ * compress on a single one. The user may still pick the archive
+ * manager in the dialog.
+ *
+ * Note that %FALSE will also be returned when the user cancels this
+ * operation, but @error will not be set then.
+ *
+ * Return value: %TRUE if the archive creation was scheduled, %FALSE on error.
+ **/
+gboolean
+tap_backend_compress (const gchar  *folder,
+                      TapSelection *selection,
+                      GtkWidget    *window,
+                      GError      **error)
+{
+  g_return_val_if_fail (selection != NULL && selection->n_files > 0, FALSE);
+  g_return_val_if_fail (GTK_IS_WINDOW (window), FALSE);
+  g_return_val_if_fail (g_path_is_absolute (folder), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return tap_native_create (folder, selection, window, tap_backend_create_archive_wrapper, error);
 }
+#endif
 
 
 
 /**
  * tap_backend_extract_here:
- * @folder : the path to the folder in which to extract the @files.
- * @files  : a #GList of #ThunarxFileInfo<!---->s that refer to the
- *           archive files that should be extracted.
- * @window : a #GtkWindow, used to popup dialogs.
- * @error  : return location for errors or %NULL.
+ * @folder    : the path to the folder in which to extract the archives.
+ * @selection : the #TapSelection with the archive files that
+ *              should be extracted.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @error     : return location for errors or %NULL.
  *
- * Spawns a command to extract the set of archive @files in the
- * specified @folder, using the default archive manager. The
- * user will not be prompted to specify a destination folder.
+ * Schedules a command for every archive in @selection to extract
+ * it in the specified @folder, using the default archive manager.
+ * The user will not be prompted to specify a destination folder.
  *
- * Note that %-1 will also be returned when the user cancels this
+ * If the plugin was built with libarchive, supported archives are
+ * extracted in-process instead. The remaining archives are passed
+ * to the archive manager once those finished.
+ *
+ * Note that %FALSE will also be returned when the user cancels this
  * operation, but @error will not be set then.
  *
- * Return value: the process id of the spawned command, or %-1
- *               on error.
+ * Return value: %TRUE if the extraction was scheduled, %FALSE on
+ *               error.
  **/
-GPid
-tap_backend_extract_here (const gchar *folder,
-                          GList       *files,
-                          GtkWidget   *window,
-                          GError     **error)
+gboolean
+tap_backend_extract_here (const gchar  *folder,
+                          TapSelection *selection,
+                          GtkWidget    *window,
+                          GError      **error)
 {
-  g_return_val_if_fail (files != NULL, -1);
-  g_return_val_if_fail (GTK_IS_WINDOW (window), -1);
-  g_return_val_if_fail (g_path_is_absolute (folder), -1);
-  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+  g_return_val_if_fail (selection != NULL && selection->n_files > 0, FALSE);
+  g_return_val_if_fail (GTK_IS_WINDOW (window), FALSE);
+  g_return_val_if_fail (g_path_is_absolute (folder), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+#ifdef HAVE_LIBARCHIVE
+  /* skip the wrapper and archive manager startup if we can extract in-process */
+  if (tap_native_supports (selection))
+    {
+      tap_native_extract_here (folder, selection, window, tap_backend_extract_here_wrapper);
+      return TRUE;
+    }
+#endif
 
   /* run the action */
-  return tap_backend_run ("extract-here", folder, files, NULL, window, error);
+  return tap_backend_run ("extract-here", folder, selection, NULL, window, error);
 }
 
 
 
 /**
  * tap_backend_extract_here:
- * @folder : the path to the folder, which is suggested to the
- *           user as destination folder.
- * @files  : a #GList of #ThunarxFileInfo<!---->s that refer to the
- *           archive files that should be extracted.
- * @window : a #GtkWindow, used to popup dialogs.
- * @error  : return location for errors or %NULL.
+ * @folder    : the path to the folder, which is suggested to the
+ *              user as destination folder.
+ * @selection : the #TapSelection with the archive files that
+ *              should be extracted.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @error     : return location for errors or %NULL.
  *
- * Spawns a command to extract the set of archive @files  using
+ * Schedules a command to extract the archives in @selection using
  * the default archive manager. The user will be prompted to
  * specify a destination folder, and the @folder will be suggested
  * as default destination.
  *
- * Note that %-1 will also be returned when the user cancels this
+ * Note that %FALSE will also be returned when the user cancels this
  * operation, but @error will not be set then.
  *
- * Return value: the process id of the spawned command, or %-1
- *               on error.
+ * Return value: %TRUE if the command was scheduled, %FALSE on error.
  **/
-GPid
-tap_backend_extract_to (const gchar *folder,
-                        GList       *files,
-                        GtkWidget   *window,
-                        GError     **error)
+gboolean
+tap_backend_extract_to (const gchar  *folder,
+                        TapSelection *selection,
+                        GtkWidget    *window,
+                        GError      **error)
 {
-  g_return_val_if_fail (files != NULL, -1);
-  g_return_val_if_fail (GTK_IS_WINDOW (window), -1);
-  g_return_val_if_fail (g_path_is_absolute (folder), -1);
-  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+  g_return_val_if_fail (selection != NULL && selection->n_files > 0, FALSE);
+  g_return_val_if_fail (GTK_IS_WINDOW (window), FALSE);
+  g_return_val_if_fail (g_path_is_absolute (folder), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
   /* run the action */
-  return tap_backend_run ("extract-to", folder, files, NULL, window, error);
+  return tap_backend_run ("extract-to", folder, selection, NULL, window, error);
 }
@@ -21,24 +21,34 @@
 #ifndef __TAP_BACKEND_H__
 #define __TAP_BACKEND_H__
 
-#include <thunarx/thunarx.h>
+#include <thunar-archive-plugin/tap-selection.h>
 
 G_BEGIN_DECLS;
 
-GPid tap_backend_create_archive (const gchar *folder,
-                                 GList       *files,
-                                 GtkWidget   *window,
-                                 GError     **error) G_GNUC_INTERNAL;
-
-GPid tap_backend_extract_here   (const gchar *folder,
-                                 GList       *files,
-                                 GtkWidget   *window,
-                                 GError     **error) G_GNUC_INTERNAL;
-
-GPid tap_backend_extract_to     (const gchar *folder,
-                                 GList       *files,
-                                 GtkWidget   *window,
-                                 GError     **error) G_GNUC_INTERNAL;
+void     tap_backend_initialize     (void) G_GNUC_INTERNAL;
+void     tap_backend_shutdown       (void) G_GNUC_INTERNAL;
+
+gboolean tap_backend_create_archive (const gchar  *folder,
+                                     TapSelection *selection,
+                                     GtkWidget    *window,
+                                     GError      **error) G_GNUC_INTERNAL;
+
+#ifdef HAVE_LIBARCHIVE
+gboolean tap_backend_compress       (const gchar  *folder,
+                                     TapSelection *selection,
+                                     GtkWidget    *window,
+                                     GError      **error) G_GNUC_INTERNAL;
+#endif
+
+gboolean tap_backend_extract_here   (const gchar  *folder,
+                                     TapSelection *selection,
+                                     GtkWidget    *window,
+                                     GError      **error) G_GNUC_INTERNAL;
+
+gboolean tap_backend_extract_to     (const gchar  *folder,
+                                     TapSelection *selection,
+                                     GtkWidget    *window,
+                                     GError      **error) G_GNUC_INTERNAL;
 
 G_END_DECLS;
 
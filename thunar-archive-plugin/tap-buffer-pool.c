@@ -0,0 +1,135 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <thunar-archive-plugin/tap-buffer-pool.h>
+
+
+
+struct _TapBufferPool
+{
+  /* all buffers in one block */
+  gpointer     block;
+  gsize        buffer_size;
+  guint        n_buffers;
+
+  /* the buffers that are not in use */
+  GAsyncQueue *free;
+};
+
+
+
+/**
+ * tap_buffer_pool_new:
+ * @buffer_size : the size of every buffer.
+ * @n_buffers   : the number of buffers.
+ *
+ * Allocates a pool of @n_buffers buffers of @buffer_size bytes, which
+ * bounds the memory of producers that run ahead of their consumers:
+ * once all buffers are in use, tap_buffer_pool_acquire() blocks until
+ * one is released again.
+ *
+ * Return value: the new #TapBufferPool.
+ **/
+TapBufferPool*
+tap_buffer_pool_new (gsize buffer_size,
+                     guint n_buffers)
+{
+  TapBufferPool *pool;
+  guint          n;
+
+  g_return_val_if_fail (buffer_size > 0 && n_buffers > 0, NULL);
+
+  pool = g_slice_new (TapBufferPool);
+  pool->buffer_size = buffer_size;
+  pool->n_buffers = n_buffers;
+  pool->block = g_malloc_n (n_buffers, buffer_size);
+  pool->free = g_async_queue_new ();
+
+  for (n = 0; n < n_buffers; ++n)
+    g_async_queue_push (pool->free, (guint8 *) pool->block + n * buffer_size);
+
+  return pool;
+}
+
+
+
+/**
+ * tap_buffer_pool_free:
+ * @pool : a #TapBufferPool.
+ *
+ * Releases the @pool. All buffers must have been released before.
+ **/
+void
+tap_buffer_pool_free (TapBufferPool *pool)
+{
+  g_return_if_fail (pool != NULL);
+  g_return_if_fail (g_async_queue_length (pool->free) == (gint) pool->n_buffers);
+
+  g_async_queue_unref (pool->free);
+  g_free (pool->block);
+  g_slice_free (TapBufferPool, pool);
+}
+
+
+
+/**
+ * tap_buffer_pool_acquire:
+ * @pool : a #TapBufferPool.
+ *
+ * Takes a buffer from the @pool, waiting until one is released if all
+ * of them are in use. May be called from any thread.
+ *
+ * Return value: a buffer of tap_buffer_pool_get_size() bytes.
+ **/
+gpointer
+tap_buffer_pool_acquire (TapBufferPool *pool)
+{
+  return g_async_queue_pop (pool->free);
+}
+
+
+
+/**
+ * tap_buffer_pool_release:
+ * @pool   : a #TapBufferPool.
+ * @buffer : a buffer from tap_buffer_pool_acquire().
+ *
+ * Returns the @buffer to the @pool. May be called from any thread.
+ **/
+void
+tap_buffer_pool_release (TapBufferPool *pool,
+                         gpointer       buffer)
+{
+  g_async_queue_push (pool->free, buffer);
+}
+
+
+
+/**
+ * tap_buffer_pool_get_size:
+ * @pool : a #TapBufferPool.
+ *
+ * Return value: the size of the buffers in the @pool.
+ **/
+gsize
+tap_buffer_pool_get_size (TapBufferPool *pool)
+{
+  return pool->buffer_size;
+}
@@ -0,0 +1,505 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-buffer-pool.h>
+#include <thunar-archive-plugin/tap-create.h>
+#include <thunar-archive-plugin/tap-trace.h>
+
+
+
+/* the size of the buffers handed from the reader to the compressor */
+#define TAP_CREATE_BUFFER_SIZE (1024 * 1024)
+
+/* the number of buffers the reader may run ahead of the compressor */
+#define TAP_CREATE_N_BUFFERS 16
+
+
+
+typedef struct _TapCreate      TapCreate;
+typedef struct _TapCreateChunk TapCreateChunk;
+
+
+
+static void     tap_create_set_error (GError              **error,
+                                      struct archive       *archive,
+                                      const gchar          *filename);
+static void     tap_create_push      (TapCreate            *create,
+                                      struct archive_entry *entry,
+                                      gpointer              buffer,
+                                      gsize                 length,
+                                      GError               *error);
+static gboolean tap_create_read_path (TapCreate            *create,
+                                      struct archive       *disk,
+                                      const gchar          *path,
+                                      GError              **error);
+static gpointer tap_create_reader    (gpointer              user_data);
+static gboolean tap_create_setup     (struct archive       *writer,
+                                      TapCreateFormat       format,
+                                      gint                  level,
+                                      guint                 n_threads);
+
+
+
+struct _TapCreate
+{
+  const gchar *const *paths;
+  guint               n_paths;
+
+  /* the chunks from the reader, every one holds a buffer of the pool */
+  TapBufferPool      *pool;
+  GAsyncQueue        *chunks;
+
+  /* set by the compressor once it failed, so the reader gives up */
+  gint                cancelled;
+};
+
+struct _TapCreateChunk
+{
+  /* starts a new entry, its data follows in this and the next chunks */
+  struct archive_entry *entry;
+  gpointer              buffer;
+  gsize                 length;
+
+  /* the last chunk has no buffer, but the error of the reader if any */
+  gboolean              last;
+  GError               *error;
+};
+
+
+
+static const TapCreateFormatInfo TAP_CREATE_FORMATS[] = {
+  { N_("Tar compressed with zstd"), ".tar.zst", 1, 19, 3 },
+  { N_("Tar compressed with xz"),   ".tar.xz",  0,  9, 6 },
+  { N_("Tar compressed with gzip"), ".tar.gz",  1,  9, 6 },
+  { N_("Zip"),                      ".zip",     0,  9, 6 },
+};
+
+
+
+static void
+tap_create_set_error (GError        **error,
+                      struct archive *archive,
+                      const gchar    *filename)
+{
+  const gchar *message;
+  gchar       *display_name;
+
+  message = archive_error_string (archive);
+  display_name = g_filename_display_basename (filename);
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to create \"%s\": %s"),
+               display_name, (message != NULL) ? message : _("Unknown error"));
+  g_free (display_name);
+}
+
+
+
+static void
+tap_create_push (TapCreate            *create,
+                 struct archive_entry *entry,
+                 gpointer              buffer,
+                 gsize                 length,
+                 GError               *error)
+{
+  TapCreateChunk *chunk;
+
+  chunk = g_slice_new (TapCreateChunk);
+  chunk->entry = entry;
+  chunk->buffer = buffer;
+  chunk->length = length;
+  chunk->last = (buffer == NULL);
+  chunk->error = error;
+  g_async_queue_push (create->chunks, chunk);
+}
+
+
+
+static gboolean
+tap_create_read_path (TapCreate      *create,
+                      struct archive *disk,
+                      const gchar    *path,
+                      GError        **error)
+{
+  struct archive_entry *entry;
+  const gchar          *slash;
+  gboolean              regular;
+  gpointer              buffer;
+  gssize                n;
+  gsize                 skip;
+  gchar                *name;
+  gint                  r;
+
+  /* store the entries relative to the folder of the path */
+  slash = strrchr (path, '/');
+  skip = (slash != NULL) ? (gsize) (slash - path) + 1 : 0;
+
+  if (G_UNLIKELY (archive_read_disk_open (disk, path) != ARCHIVE_OK))
+    {
+      tap_create_set_error (error, disk, path);
+      return FALSE;
+    }
+
+  for (;;)
+    {
+      if (g_atomic_int_get (&create->cancelled))
+        break;
+
+      entry = archive_entry_new ();
+      r = archive_read_next_header2 (disk, entry);
+      if (r == ARCHIVE_EOF)
+        {
+          archive_entry_free (entry);
+          archive_read_close (disk);
+          return TRUE;
+        }
+      if (G_UNLIKELY (r < ARCHIVE_WARN))
+        {
+          tap_create_set_error (error, disk, path);
+          archive_entry_free (entry);
+          break;
+        }
+
+      /* walk into folders, without following symlinks */
+      archive_read_disk_descend (disk);
+
+      name = g_strdup (archive_entry_pathname (entry) + skip);
+      archive_entry_set_pathname (entry, name);
+      g_free (name);
+
+      /* the compressor owns the entry from now on */
+      regular = (archive_entry_filetype (entry) == AE_IFREG);
+      tap_create_push (create, entry, tap_buffer_pool_acquire (create->pool), 0, NULL);
+
+      /* the pool bounds how far the reader may run ahead */
+      while (regular && !g_atomic_int_get (&create->cancelled))
+        {
+          buffer = tap_buffer_pool_acquire (create->pool);
+          n = archive_read_data (disk, buffer, tap_buffer_pool_get_size (create->pool));
+          if (n <= 0)
+            {
+              tap_buffer_pool_release (create->pool, buffer);
+              if (G_UNLIKELY (n < 0))
+                {
+                  tap_create_set_error (error, disk, path);
+                  archive_read_close (disk);
+                  return FALSE;
+                }
+              break;
+            }
+
+          tap_create_push (create, NULL, buffer, n, NULL);
+        }
+    }
+
+  archive_read_close (disk);
+
+  return FALSE;
+}
+
+
+
+static gpointer
+tap_create_reader (gpointer user_data)
+{
+  struct archive *disk;
+  TapCreate      *create = user_data;
+  GError         *error = NULL;
+  guint           n;
+
+  disk = archive_read_disk_new ();
+  archive_read_disk_set_symlink_physical (disk);
+  archive_read_disk_set_standard_lookup (disk);
+
+  for (n = 0; n < create->n_paths; ++n)
+    if (!tap_create_read_path (create, disk, create->paths[n], &error))
+      break;
+
+  archive_read_free (disk);
+
+  /* tell the compressor that nothing more is coming */
+  tap_create_push (create, NULL, NULL, 0, error);
+
+  return NULL;
+}
+
+
+
+static gboolean
+tap_create_setup (struct archive *writer,
+                  TapCreateFormat format,
+                  gint            level,
+                  guint           n_threads)
+{
+  const gchar *filter = NULL;
+  gchar       *command;
+  gchar       *program;
+  gchar       *quoted;
+  gchar        value[16];
+  gint         r;
+
+  n_threads = MAX (n_threads, 1);
+
+  if (format == TAP_CREATE_ZIP)
+    {
+      r = archive_write_set_format_zip (writer);
+    }
+  else
+    {
+      r = archive_write_set_format_pax_restricted (writer);
+      if (G_UNLIKELY (r != ARCHIVE_OK))
+        return FALSE;
+
+      switch (format)
+        {
+        case TAP_CREATE_TAR_ZSTD:
+          r = archive_write_add_filter_zstd (writer);
+          filter = "zstd";
+          break;
+
+        case TAP_CREATE_TAR_XZ:
+          r = archive_write_add_filter_xz (writer);
+          filter = "xz";
+          break;
+
+        default:
+          /* libarchive compresses gzip on a single thread, pigz in parallel blocks */
+          program = g_find_program_in_path ("pigz");
+          if (program != NULL)
+            {
+              quoted = g_shell_quote (program);
+              command = g_strdup_printf ("%s -%d -p %u", quoted, MAX (level, 1), n_threads);
+              r = archive_write_add_filter_program (writer, command);
+              g_free (command);
+              g_free (quoted);
+              g_free (program);
+            }
+          else
+            {
+              r = archive_write_add_filter_gzip (writer);
+              filter = "gzip";
+            }
+          break;
+        }
+    }
+
+  if (G_UNLIKELY (r != ARCHIVE_OK))
+    return FALSE;
+
+  /* the options are a hint, older libarchives lack some of them */
+  g_snprintf (value, sizeof (value), "%d", level);
+  if (format == TAP_CREATE_ZIP)
+    archive_write_set_format_option (writer, "zip", "compression-level", value);
+  else if (filter != NULL)
+    archive_write_set_filter_option (writer, filter, "compression-level", value);
+
+  /* zstd and xz compress on the threads granted to the job */
+  if (format == TAP_CREATE_TAR_ZSTD || format == TAP_CREATE_TAR_XZ)
+    {
+      g_snprintf (value, sizeof (value), "%u", n_threads);
+      archive_write_set_filter_option (writer, filter, "threads", value);
+    }
+
+  /* don't pad the compressed stream to whole tar blocks */
+  archive_write_set_bytes_in_last_block (writer, 1);
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_create_format_info:
+ * @format : a #TapCreateFormat.
+ *
+ * Return value: the description of the @format.
+ **/
+const TapCreateFormatInfo*
+tap_create_format_info (TapCreateFormat format)
+{
+  g_return_val_if_fail (format < TAP_CREATE_N_FORMATS, NULL);
+
+  return &TAP_CREATE_FORMATS[format];
+}
+
+
+
+/**
+ * tap_create_archive:
+ * @filename  : the path of the archive to create.
+ * @paths     : the paths of the files and folders to add.
+ * @n_paths   : the number of @paths.
+ * @format    : the #TapCreateFormat of the archive.
+ * @level     : the compression level, within the range of the @format.
+ * @n_threads : the number of threads to compress on.
+ * @error     : return location for errors or %NULL.
+ *
+ * Creates the archive @filename with libarchive, adding the @paths
+ * relative to their folders, and folders with all their contents.
+ *
+ * The files are read on a thread of their own, which may run ahead
+ * of the compressor by a bounded number of buffers, so the disk and
+ * the compressor work at the same time. zstd and xz compress on
+ * @n_threads threads, and gzip does if pigz is installed. The archive is written
+ * to a hidden file next to @filename, which is only renamed once it
+ * is complete.
+ *
+ * This function blocks, and may be called from any thread.
+ *
+ * Return value: %TRUE if the archive was created.
+ **/
+gboolean
+tap_create_archive (const gchar        *filename,
+                    const gchar *const *paths,
+                    guint               n_paths,
+                    TapCreateFormat     format,
+                    gint                level,
+                    guint               n_threads,
+                    GError            **error)
+{
+  TapCreateChunk *chunk;
+  struct archive *writer;
+  TapCreate       create;
+  gboolean        failed = FALSE;
+  gboolean        last;
+  GThread        *thread;
+  GError         *err = NULL;
+  gchar          *temporary;
+  gchar          *dirname;
+  gint            saved_errno;
+  gint            fd;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (paths != NULL && n_paths > 0, FALSE);
+  g_return_val_if_fail (format < TAP_CREATE_N_FORMATS, FALSE);
+
+  TAP_TRACE_SCOPE ("create");
+
+  /* write to a hidden file, which is only renamed once complete */
+  dirname = g_path_get_dirname (filename);
+  temporary = g_build_filename (dirname, ".tap-XXXXXX", NULL);
+  g_free (dirname);
+  fd = g_mkstemp_full (temporary, O_RDWR | O_CLOEXEC, 0666);
+  if (G_UNLIKELY (fd < 0))
+    {
+      saved_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   _("Failed to create archive: %s"), g_strerror (saved_errno));
+      g_free (temporary);
+      return FALSE;
+    }
+
+  writer = archive_write_new ();
+  if (!tap_create_setup (writer, format, level, n_threads) || archive_write_open_fd (writer, fd) != ARCHIVE_OK)
+    {
+      tap_create_set_error (error, writer, filename);
+      archive_write_free (writer);
+      close (fd);
+      g_unlink (temporary);
+      g_free (temporary);
+      return FALSE;
+    }
+
+  create.paths = paths;
+  create.n_paths = n_paths;
+  create.pool = tap_buffer_pool_new (TAP_CREATE_BUFFER_SIZE, TAP_CREATE_N_BUFFERS);
+  create.chunks = g_async_queue_new ();
+  create.cancelled = 0;
+
+  thread = g_thread_new ("tap-create-reader", tap_create_reader, &create);
+
+  /* feed the compressor on this thread, until the reader is done */
+  do
+    {
+      chunk = g_async_queue_pop (create.chunks);
+
+      /* after errors, just drain the queue so the reader can finish */
+      if (G_LIKELY (!failed)
+          && ((chunk->entry != NULL && archive_write_header (writer, chunk->entry) < ARCHIVE_WARN)
+              || (chunk->length > 0 && archive_write_data (writer, chunk->buffer, chunk->length) < 0)))
+        {
+          tap_create_set_error (&err, writer, filename);
+          g_atomic_int_set (&create.cancelled, 1);
+          failed = TRUE;
+        }
+
+      if (chunk->entry != NULL)
+        archive_entry_free (chunk->entry);
+      if (chunk->buffer != NULL)
+        tap_buffer_pool_release (create.pool, chunk->buffer);
+
+      /* the errors of the reader come with the last chunk */
+      if (chunk->error != NULL && err == NULL)
+        err = chunk->error;
+      else if (chunk->error != NULL)
+        g_error_free (chunk->error);
+
+      last = chunk->last;
+      g_slice_free (TapCreateChunk, chunk);
+    }
+  while (!last);
+
+  g_thread_join (thread);
+  tap_buffer_pool_free (create.pool);
+  g_async_queue_unref (create.chunks);
+
+  /* flush the compressor, and wait for its threads */
+  if (err == NULL && archive_write_close (writer) != ARCHIVE_OK)
+    tap_create_set_error (&err, writer, filename);
+  archive_write_free (writer);
+
+  if (G_UNLIKELY (close (fd) < 0) && err == NULL)
+    {
+      saved_errno = errno;
+      g_set_error (&err, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   _("Failed to create archive: %s"), g_strerror (saved_errno));
+    }
+
+  if (err == NULL && g_rename (temporary, filename) < 0)
+    {
+      saved_errno = errno;
+      g_set_error (&err, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   _("Failed to create archive: %s"), g_strerror (saved_errno));
+    }
+
+  if (G_UNLIKELY (err != NULL))
+    {
+      g_unlink (temporary);
+      g_propagate_error (error, err);
+    }
+
+  g_free (temporary);
+
+  return (err == NULL);
+}
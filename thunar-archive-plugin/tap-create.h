@@ -0,0 +1,77 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_CREATE_H__
+#define __TAP_CREATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+/**
+ * TapCreateFormat:
+ * @TAP_CREATE_TAR_ZSTD : a tarball compressed with zstd.
+ * @TAP_CREATE_TAR_XZ   : a tarball compressed with xz.
+ * @TAP_CREATE_TAR_GZIP : a tarball compressed with gzip.
+ * @TAP_CREATE_ZIP      : a zip archive.
+ *
+ * The formats tap_create_archive() can write.
+ **/
+typedef enum
+{
+  TAP_CREATE_TAR_ZSTD,
+  TAP_CREATE_TAR_XZ,
+  TAP_CREATE_TAR_GZIP,
+  TAP_CREATE_ZIP,
+  TAP_CREATE_N_FORMATS,
+} TapCreateFormat;
+
+/**
+ * TapCreateFormatInfo:
+ * @name          : the untranslated name of the format.
+ * @extension     : the file name extension, e.g. ".tar.zst".
+ * @min_level     : the fastest compression level.
+ * @max_level     : the best compression level.
+ * @default_level : the compression level used by the command line tools.
+ *
+ * Describes a #TapCreateFormat.
+ **/
+typedef struct
+{
+  const gchar *name;
+  const gchar *extension;
+  gint         min_level;
+  gint         max_level;
+  gint         default_level;
+} TapCreateFormatInfo;
+
+const TapCreateFormatInfo *tap_create_format_info (TapCreateFormat     format) G_GNUC_INTERNAL;
+
+gboolean                   tap_create_archive     (const gchar        *filename,
+                                                   const gchar *const *paths,
+                                                   guint               n_paths,
+                                                   TapCreateFormat     format,
+                                                   gint                level,
+                                                   guint               n_threads,
+                                                   GError            **error) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_CREATE_H__ */
@@ -0,0 +1,1126 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-decoder.h>
+#include <thunar-archive-plugin/tap-trace.h>
+
+
+
+/* the compressed size below which neighbouring segments are merged */
+#define TAP_DECODER_SEGMENT_SIZE (4 * 1024 * 1024)
+
+/* the memory for segments that are decoded, or wait for the reader */
+#define TAP_DECODER_MEMORY       (256 * 1024 * 1024)
+
+/* the largest segment that is decoded into memory, larger ones are left to libarchive */
+#define TAP_DECODER_MAX_SEGMENT  (TAP_DECODER_MEMORY / 4)
+
+/* the number of bytes read at once while looking for the segments */
+#define TAP_DECODER_HEADERS_SIZE  (4 * 1024)
+
+/* the uncompressed size of a segment that does not tell */
+#define TAP_DECODER_UNKNOWN      G_MAXUINT64
+
+/* the magic numbers of zstd frames */
+#define TAP_DECODER_ZSTD_MAGIC          0xfd2fb528
+#define TAP_DECODER_ZSTD_SKIPPABLE      0x184d2a50
+#define TAP_DECODER_ZSTD_SKIPPABLE_MASK 0xfffffff0
+
+
+
+typedef enum
+{
+  TAP_DECODER_NONE,
+  TAP_DECODER_ZSTD,
+  TAP_DECODER_XZ,
+  TAP_DECODER_BGZF,
+} TapDecoderFormat;
+
+typedef struct
+{
+  /* the compressed data */
+  guint64  offset;
+  guint64  length;
+
+  /* the uncompressed size, or TAP_DECODER_UNKNOWN */
+  guint64  size;
+
+  /* the integrity check of xz streams */
+  guint    check;
+
+  /* the decoded data, once ready */
+  guchar  *data;
+  gsize    data_length;
+  gboolean ready;
+} TapDecoderSegment;
+
+typedef struct
+{
+#ifdef HAVE_ZSTD
+  ZSTD_DCtx *dctx;
+#endif
+#ifdef HAVE_ZLIB
+  z_stream   stream;
+  gboolean   inflating;
+#endif
+#if !defined (HAVE_ZSTD) && !defined (HAVE_ZLIB)
+  gint       unused;
+#endif
+} TapDecoderContext;
+
+
+
+static guint32           tap_decoder_u32       (const guchar      *data);
+static gboolean          tap_decoder_read_at   (gint               fd,
+                                                guchar            *buffer,
+                                                gsize              length,
+                                                guint64            offset,
+                                                GError           **error);
+static const guchar     *tap_decoder_peek      (TapDecoder        *decoder,
+                                                guint64            offset,
+                                                gsize              length);
+static TapDecoderFormat  tap_decoder_sniff     (TapDecoder        *decoder);
+static void              tap_decoder_merge     (TapDecoder        *decoder,
+                                                GArray            *units);
+static void              tap_decoder_set_error (GError           **error);
+#ifdef HAVE_ZSTD
+static gboolean          tap_decoder_scan_zstd (TapDecoder        *decoder,
+                                                GArray            *units);
+static gboolean          tap_decoder_zstd      (const guchar      *input,
+                                                TapDecoderSegment *segment,
+                                                TapDecoderContext *context,
+                                                GError           **error);
+#endif
+#ifdef HAVE_LZMA
+static gboolean          tap_decoder_scan_xz   (TapDecoder        *decoder,
+                                                GArray            *units);
+static gboolean          tap_decoder_xz        (const guchar      *input,
+                                                TapDecoderSegment *segment,
+                                                GError           **error);
+#endif
+#ifdef HAVE_ZLIB
+static gsize             tap_decoder_member    (const guchar      *member,
+                                                gsize              length);
+static gboolean          tap_decoder_scan_bgzf (TapDecoder        *decoder,
+                                                GArray            *units);
+static gboolean          tap_decoder_bgzf      (const guchar      *input,
+                                                TapDecoderSegment *segment,
+                                                TapDecoderContext *context,
+                                                GError           **error);
+#endif
+static gboolean          tap_decoder_claim     (TapDecoder        *decoder,
+                                                guint             *n);
+static gpointer          tap_decoder_worker    (gpointer           user_data);
+
+
+
+struct _TapDecoder
+{
+  gint              fd;
+  guint64           length;
+  TapDecoderFormat  format;
+
+  /* the headers read last while looking for the segments */
+  guchar           *headers;
+  gsize             headers_size;
+  guint64           headers_offset;
+  gsize             headers_length;
+
+  /* the segments, decoded out of order but read in order */
+  GArray           *segments;
+
+  GThread         **threads;
+  guint             n_threads;
+
+  GMutex            lock;
+  GCond             cond;
+
+  /* the next segment to decode, and the next to read */
+  guint             next;
+  guint             consumed;
+  gboolean          reading;
+
+  /* the bounds of the reorder buffer */
+  guint             window;
+  guint64           in_flight;
+
+  gboolean          cancelled;
+  GError           *error;
+};
+
+
+
+static guint32
+tap_decoder_u32 (const guchar *data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((guint32) data[3] << 24);
+}
+
+
+
+static gboolean
+tap_decoder_read_at (gint     fd,
+                     guchar  *buffer,
+                     gsize    length,
+                     guint64  offset,
+                     GError **error)
+{
+  gssize n;
+  gint   saved_errno;
+
+  /* the archive is read, not mapped, so media that go away fail the read
+   * instead of taking the process down with a SIGBUS */
+  for (; length > 0; length -= n, offset += n, buffer += n)
+    {
+      n = pread (fd, buffer, length, offset);
+      if (G_UNLIKELY (n < 0))
+        {
+          saved_errno = errno;
+          if (saved_errno == EINTR)
+            {
+              n = 0;
+              continue;
+            }
+
+          g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (saved_errno), g_strerror (saved_errno));
+          return FALSE;
+        }
+      else if (G_UNLIKELY (n == 0))
+        {
+          /* truncated meanwhile */
+          tap_decoder_set_error (error);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+
+
+static const guchar*
+tap_decoder_peek (TapDecoder *decoder,
+                  guint64     offset,
+                  gsize       length)
+{
+  gsize size;
+
+  if (offset > decoder->length || length > decoder->length - offset)
+    return NULL;
+
+  /* the headers of small segments are often read already */
+  if (offset >= decoder->headers_offset
+      && offset - decoder->headers_offset <= decoder->headers_length
+      && length <= decoder->headers_length - (offset - decoder->headers_offset))
+    return decoder->headers + (offset - decoder->headers_offset);
+
+  size = MAX (length, TAP_DECODER_HEADERS_SIZE);
+  if (size > decoder->headers_size)
+    {
+      g_free (decoder->headers);
+      decoder->headers = g_try_malloc (size);
+      decoder->headers_size = (decoder->headers != NULL) ? size : 0;
+    }
+
+  decoder->headers_offset = offset;
+  decoder->headers_length = 0;
+  if (G_UNLIKELY (decoder->headers == NULL))
+    return NULL;
+
+  size = MIN (size, decoder->length - offset);
+  if (!tap_decoder_read_at (decoder->fd, decoder->headers, size, offset, NULL))
+    return NULL;
+  decoder->headers_length = size;
+
+  return decoder->headers;
+}
+
+
+
+static TapDecoderFormat
+tap_decoder_sniff (TapDecoder *decoder)
+{
+  const guchar *data;
+
+#ifdef HAVE_ZSTD
+  data = tap_decoder_peek (decoder, 0, 4);
+  if (data != NULL
+      && (tap_decoder_u32 (data) == TAP_DECODER_ZSTD_MAGIC
+          || (tap_decoder_u32 (data) & TAP_DECODER_ZSTD_SKIPPABLE_MASK) == TAP_DECODER_ZSTD_SKIPPABLE))
+    return TAP_DECODER_ZSTD;
+#endif
+
+#ifdef HAVE_LZMA
+  data = tap_decoder_peek (decoder, 0, 6);
+  if (data != NULL && memcmp (data, "\3757zXZ\0", 6) == 0)
+    return TAP_DECODER_XZ;
+#endif
+
+#ifdef HAVE_ZLIB
+  data = tap_decoder_peek (decoder, 0, 18);
+  if (data != NULL && data[0] == 0x1f && data[1] == 0x8b)
+    return TAP_DECODER_BGZF;
+#endif
+
+  (void) data;
+
+  return TAP_DECODER_NONE;
+}
+
+
+
+static void
+tap_decoder_merge (TapDecoder *decoder,
+                   GArray     *units)
+{
+  TapDecoderSegment *segment = NULL;
+  TapDecoderSegment *unit;
+  guint              n;
+
+  for (n = 0; n < units->len; ++n)
+    {
+      unit = &g_array_index (units, TapDecoderSegment, n);
+
+      /* small neighbours are decoded together, to keep the overhead per segment low */
+      if (segment != NULL
+          && segment->length < TAP_DECODER_SEGMENT_SIZE
+          && segment->offset + segment->length == unit->offset
+          && segment->check == unit->check
+          && segment->size <= TAP_DECODER_MAX_SEGMENT
+          && unit->size <= TAP_DECODER_MAX_SEGMENT - segment->size)
+        {
+          segment->length += unit->length;
+          segment->size += unit->size;
+        }
+      else
+        {
+          g_array_append_vals (decoder->segments, unit, 1);
+          segment = &g_array_index (decoder->segments, TapDecoderSegment, decoder->segments->len - 1);
+        }
+    }
+}
+
+
+
+static void
+tap_decoder_set_error (GError **error)
+{
+  g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("The archive is damaged"));
+}
+
+
+
+#ifdef HAVE_ZSTD
+static gboolean
+tap_decoder_scan_zstd (TapDecoder *decoder,
+                       GArray     *units)
+{
+  static const guint8 dictionary_sizes[] = { 0, 1, 2, 4 };
+  static const guint8 content_sizes[] = { 0, 2, 4, 8 };
+  TapDecoderSegment   unit = { 0, };
+  unsigned long long  size;
+  const guchar       *data;
+  gboolean            single;
+  guint32             magic;
+  guint32             block;
+  guint64             p;
+  guint64             n;
+  gsize               header_size;
+  guint               descriptor;
+
+  /* the frames tell their compressed size through their block headers, the ones
+   * of zstd -T and pzstd also their content size, see RFC 8878 */
+  for (p = 0; p < decoder->length; p += n)
+    {
+      data = tap_decoder_peek (decoder, p, 8);
+      if (data == NULL)
+        return FALSE;
+
+      magic = tap_decoder_u32 (data);
+      if (magic == TAP_DECODER_ZSTD_MAGIC)
+        {
+          descriptor = data[4];
+          single = (descriptor & 0x20) != 0;
+          header_size = 5 + (single ? 0 : 1) + dictionary_sizes[descriptor & 0x03]
+                      + ((descriptor >> 6) == 0 ? (single ? 1 : 0) : content_sizes[descriptor >> 6]);
+
+          data = tap_decoder_peek (decoder, p, header_size);
+          if (data == NULL || (descriptor & 0x08) != 0)
+            return FALSE;
+
+          size = ZSTD_getFrameContentSize (data, header_size);
+          unit.size = (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) ? TAP_DECODER_UNKNOWN : size;
+
+          /* skip the blocks up to the last one, and the checksum */
+          for (n = header_size;; )
+            {
+              data = tap_decoder_peek (decoder, p + n, 3);
+              if (data == NULL)
+                return FALSE;
+
+              block = data[0] | (data[1] << 8) | (data[2] << 16);
+              if (((block >> 1) & 0x03) == 3)
+                return FALSE;
+
+              /* RLE blocks have a single byte of content */
+              n += 3 + (((block >> 1) & 0x03) == 1 ? 1 : (block >> 3));
+              if ((block & 0x01) != 0)
+                break;
+            }
+
+          if ((descriptor & 0x04) != 0)
+            n += 4;
+          if (n > decoder->length - p)
+            return FALSE;
+        }
+      else if ((magic & TAP_DECODER_ZSTD_SKIPPABLE_MASK) == TAP_DECODER_ZSTD_SKIPPABLE)
+        {
+          /* pzstd puts the size of every frame in a skippable frame in front of it */
+          n = 8 + (guint64) tap_decoder_u32 (data + 4);
+          if (n > decoder->length - p)
+            return FALSE;
+
+          unit.size = 0;
+        }
+      else
+        {
+          return FALSE;
+        }
+
+      unit.offset = p;
+      unit.length = n;
+      g_array_append_vals (units, &unit, 1);
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_decoder_zstd (const guchar      *input_data,
+                  TapDecoderSegment *segment,
+                  TapDecoderContext *context,
+                  GError           **error)
+{
+  ZSTD_outBuffer output;
+  ZSTD_inBuffer  input;
+  gsize          r;
+
+  input.src = input_data;
+  input.size = segment->length;
+  input.pos = 0;
+
+  output.size = MAX (segment->size, 1);
+  output.dst = g_try_malloc (output.size);
+  output.pos = 0;
+
+  if (context->dctx == NULL)
+    context->dctx = ZSTD_createDCtx ();
+  if (G_UNLIKELY (context->dctx == NULL || output.dst == NULL))
+    {
+      g_free (output.dst);
+      tap_decoder_set_error (error);
+      return FALSE;
+    }
+
+  ZSTD_DCtx_reset (context->dctx, ZSTD_reset_session_only);
+
+  for (;;)
+    {
+      r = ZSTD_decompressStream (context->dctx, &output, &input);
+      if (ZSTD_isError (r))
+        break;
+
+      /* all frames are complete */
+      if (input.pos == input.size && r == 0)
+        {
+          if (output.pos != segment->size)
+            break;
+
+          segment->data = output.dst;
+          segment->data_length = output.pos;
+          return TRUE;
+        }
+
+      /* the last frame is truncated, or the frames are larger than they claim */
+      if (input.pos == input.size || output.pos == output.size)
+        break;
+    }
+
+  g_free (output.dst);
+  tap_decoder_set_error (error);
+
+  return FALSE;
+}
+#endif
+
+
+
+#ifdef HAVE_LZMA
+static gboolean
+tap_decoder_scan_xz (TapDecoder *decoder,
+                     GArray     *units)
+{
+  TapDecoderSegment unit = { 0, };
+  lzma_index_iter   iter;
+  lzma_stream_flags footer;
+  lzma_stream_flags header;
+  lzma_index       *index;
+  lzma_vli          stream_size;
+  const guchar     *data;
+  GArray           *stream_units;
+  guint64           memlimit;
+  guint64           end = decoder->length;
+  guint64           start;
+  gsize             position;
+  gboolean          succeed = TRUE;
+
+  stream_units = g_array_new (FALSE, FALSE, sizeof (TapDecoderSegment));
+
+  /* the streams are walked from the end, since every one has its index in the back */
+  while (end > 0 && succeed)
+    {
+      /* skip the stream padding */
+      while (end >= 4 && (data = tap_decoder_peek (decoder, end - 4, 4)) != NULL && tap_decoder_u32 (data) == 0)
+        end -= 4;
+
+      /* the index is read in one go, so huge ones are left to libarchive */
+      data = NULL;
+      if (end >= 2 * LZMA_STREAM_HEADER_SIZE)
+        data = tap_decoder_peek (decoder, end - LZMA_STREAM_HEADER_SIZE, LZMA_STREAM_HEADER_SIZE);
+      if (data == NULL
+          || lzma_stream_footer_decode (&footer, data) != LZMA_OK
+          || footer.backward_size > end - 2 * LZMA_STREAM_HEADER_SIZE
+          || footer.backward_size > TAP_DECODER_MAX_SEGMENT
+          || (data = tap_decoder_peek (decoder, end - LZMA_STREAM_HEADER_SIZE - footer.backward_size, footer.backward_size)) == NULL)
+        {
+          succeed = FALSE;
+          break;
+        }
+
+      index = NULL;
+      memlimit = G_MAXUINT64;
+      position = 0;
+      if (lzma_index_buffer_decode (&index, &memlimit, NULL, data, &position, footer.backward_size) != LZMA_OK)
+        {
+          succeed = FALSE;
+          break;
+        }
+
+      /* the header of the stream must match its footer */
+      stream_size = lzma_index_stream_size (index);
+      start = end - stream_size;
+      if (stream_size > end
+          || (data = tap_decoder_peek (decoder, start, LZMA_STREAM_HEADER_SIZE)) == NULL
+          || lzma_stream_header_decode (&header, data) != LZMA_OK
+          || lzma_stream_flags_compare (&header, &footer) != LZMA_OK)
+        {
+          lzma_index_end (index, NULL);
+          succeed = FALSE;
+          break;
+        }
+
+      /* the index has the offset and the sizes of every block */
+      g_array_set_size (stream_units, 0);
+      lzma_index_iter_init (&iter, index);
+      while (!lzma_index_iter_next (&iter, LZMA_INDEX_ITER_BLOCK))
+        {
+          unit.offset = start + iter.block.compressed_stream_offset;
+          unit.length = iter.block.total_size;
+          unit.size = iter.block.uncompressed_size;
+          unit.check = header.check;
+          g_array_append_vals (stream_units, &unit, 1);
+        }
+      g_array_prepend_vals (units, stream_units->data, stream_units->len);
+
+      lzma_index_end (index, NULL);
+      end = start;
+    }
+
+  g_array_free (stream_units, TRUE);
+
+  return succeed;
+}
+
+
+
+static gboolean
+tap_decoder_xz (const guchar      *input,
+                TapDecoderSegment *segment,
+                GError           **error)
+{
+  lzma_filter filters[LZMA_FILTERS_MAX + 1];
+  lzma_block  block;
+  lzma_ret    r;
+  guchar     *output;
+  gsize       output_position = 0;
+  gsize       position = 0;
+  gsize       end = segment->length;
+  guint       n;
+
+  output = g_try_malloc (MAX (segment->size, 1));
+  if (G_UNLIKELY (output == NULL))
+    {
+      tap_decoder_set_error (error);
+      return FALSE;
+    }
+
+  /* the blocks are independent, with their headers in front */
+  while (position < end)
+    {
+      memset (&block, 0, sizeof (block));
+      block.version = 0;
+      block.check = segment->check;
+      block.filters = filters;
+      block.header_size = lzma_block_header_size_decode (input[position]);
+      if (block.header_size > end - position
+          || lzma_block_header_decode (&block, NULL, input + position) != LZMA_OK)
+        goto failed;
+
+      position += block.header_size;
+      r = lzma_block_buffer_decode (&block, NULL, input, &position, end,
+                                    output, &output_position, segment->size);
+
+      for (n = 0; filters[n].id != LZMA_VLI_UNKNOWN; ++n)
+        free (filters[n].options);
+
+      if (r != LZMA_OK)
+        goto failed;
+    }
+
+  if (output_position != segment->size)
+    goto failed;
+
+  segment->data = output;
+  segment->data_length = output_position;
+
+  return TRUE;
+
+failed:
+  g_free (output);
+  tap_decoder_set_error (error);
+
+  return FALSE;
+}
+#endif
+
+
+
+#ifdef HAVE_ZLIB
+static gsize
+tap_decoder_member (const guchar *member,
+                    gsize         length)
+{
+  gsize extra_length;
+  gsize n;
+  gsize p;
+
+  /* only BGZF members, with nothing but the extra field, tell their size upfront */
+  if (length < 18 || member[0] != 0x1f || member[1] != 0x8b || member[2] != 8 || member[3] != 4)
+    return 0;
+
+  extra_length = member[10] | (member[11] << 8);
+  if (12 + extra_length > length)
+    return 0;
+
+  for (p = 12; p + 4 <= 12 + extra_length; p += 4 + (member[p + 2] | (member[p + 3] << 8)))
+    if (member[p] == 'B' && member[p + 1] == 'C' && (member[p + 2] | (member[p + 3] << 8)) == 2 && p + 6 <= 12 + extra_length)
+      {
+        /* the header and the trailer must fit into the member */
+        n = (member[p + 4] | (member[p + 5] << 8)) + 1;
+        return (n >= 12 + extra_length + 8) ? n : 0;
+      }
+
+  return 0;
+}
+
+
+
+static gboolean
+tap_decoder_scan_bgzf (TapDecoder *decoder,
+                       GArray     *units)
+{
+  TapDecoderSegment unit = { 0, };
+  const guchar     *data;
+  guint64           p;
+  gsize             n;
+
+  for (p = 0; p < decoder->length; p += n)
+    {
+      /* the header with its extra field, and the size in the trailer */
+      data = tap_decoder_peek (decoder, p, 18);
+      if (data == NULL)
+        return FALSE;
+      data = tap_decoder_peek (decoder, p, 12 + (gsize) (data[10] | (data[11] << 8)));
+      if (data == NULL)
+        return FALSE;
+      n = tap_decoder_member (data, 12 + (gsize) (data[10] | (data[11] << 8)));
+      if (n == 0 || n > decoder->length - p)
+        return FALSE;
+      data = tap_decoder_peek (decoder, p + n - 4, 4);
+      if (data == NULL)
+        return FALSE;
+
+      unit.offset = p;
+      unit.length = n;
+      unit.size = tap_decoder_u32 (data);
+      g_array_append_vals (units, &unit, 1);
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_decoder_bgzf (const guchar      *input,
+                  TapDecoderSegment *segment,
+                  TapDecoderContext *context,
+                  GError           **error)
+{
+  const guchar *member;
+  guchar       *output;
+  gsize         output_position = 0;
+  gsize         position = 0;
+  gsize         end = segment->length;
+  gsize         extra_length;
+  gsize         n;
+
+  if (!context->inflating)
+    {
+      if (inflateInit2 (&context->stream, -MAX_WBITS) != Z_OK)
+        goto failed;
+      context->inflating = TRUE;
+    }
+
+  output = g_try_malloc (MAX (segment->size, 1));
+  if (G_UNLIKELY (output == NULL))
+    goto failed;
+
+  for (; position < end; position += n)
+    {
+      /* the archive may have changed since it was scanned */
+      member = input + position;
+      n = tap_decoder_member (member, end - position);
+      if (n == 0 || n > end - position)
+        {
+          g_free (output);
+          goto failed;
+        }
+      extra_length = member[10] | (member[11] << 8);
+
+      inflateReset (&context->stream);
+      context->stream.next_in = (Bytef *) member + 12 + extra_length;
+      context->stream.avail_in = n - 12 - extra_length - 8;
+      context->stream.next_out = output + output_position;
+      context->stream.avail_out = segment->size - output_position;
+      if (inflate (&context->stream, Z_FINISH) != Z_STREAM_END
+          || context->stream.total_out != tap_decoder_u32 (member + n - 4)
+          || crc32 (0L, output + output_position, context->stream.total_out) != tap_decoder_u32 (member + n - 8))
+        {
+          g_free (output);
+          goto failed;
+        }
+
+      output_position += context->stream.total_out;
+    }
+
+  segment->data = output;
+  segment->data_length = output_position;
+
+  return TRUE;
+
+failed:
+  tap_decoder_set_error (error);
+
+  return FALSE;
+}
+#endif
+
+
+
+static gboolean
+tap_decoder_claim (TapDecoder *decoder,
+                   guint      *n)
+{
+  TapDecoderSegment *segment;
+  guint64            cost;
+
+  g_mutex_lock (&decoder->lock);
+
+  for (;;)
+    {
+      if (decoder->cancelled || decoder->error != NULL || decoder->next >= decoder->segments->len)
+        {
+          g_mutex_unlock (&decoder->lock);
+          return FALSE;
+        }
+
+      /* the segment the reader waits for is always decoded, the ones after it only while
+       * their input and output fit */
+      segment = &g_array_index (decoder->segments, TapDecoderSegment, decoder->next);
+      cost = segment->length + segment->size;
+      if (decoder->next == decoder->consumed
+          || (decoder->next < decoder->consumed + decoder->window
+              && decoder->in_flight + cost <= TAP_DECODER_MEMORY))
+        break;
+
+      g_cond_wait (&decoder->cond, &decoder->lock);
+    }
+
+  *n = decoder->next++;
+  decoder->in_flight += cost;
+
+  g_mutex_unlock (&decoder->lock);
+
+  return TRUE;
+}
+
+
+
+static gpointer
+tap_decoder_worker (gpointer user_data)
+{
+  TapDecoderSegment *segment;
+  TapDecoderContext  context;
+  TapDecoder        *decoder = user_data;
+  gboolean           succeed = FALSE;
+  GError            *error = NULL;
+  guchar            *input;
+  guint              n;
+
+  memset (&context, 0, sizeof (context));
+
+  while (tap_decoder_claim (decoder, &n))
+    {
+      segment = &g_array_index (decoder->segments, TapDecoderSegment, n);
+
+      /* read the compressed data of the segment, which is released right after decoding it */
+      input = g_try_malloc (MAX (segment->length, 1));
+      if (G_UNLIKELY (input == NULL))
+        {
+          tap_decoder_set_error (&error);
+          succeed = FALSE;
+        }
+      else if (!tap_decoder_read_at (decoder->fd, input, segment->length, segment->offset, &error))
+        {
+          succeed = FALSE;
+        }
+      else
+        {
+          switch (decoder->format)
+            {
+#ifdef HAVE_ZSTD
+            case TAP_DECODER_ZSTD:
+              succeed = tap_decoder_zstd (input, segment, &context, &error);
+              break;
+#endif
+
+#ifdef HAVE_LZMA
+            case TAP_DECODER_XZ:
+              succeed = tap_decoder_xz (input, segment, &error);
+              break;
+#endif
+
+#ifdef HAVE_ZLIB
+            case TAP_DECODER_BGZF:
+              succeed = tap_decoder_bgzf (input, segment, &context, &error);
+              break;
+#endif
+
+            default:
+              g_assert_not_reached ();
+            }
+        }
+      g_free (input);
+
+      /* hand the segment to the reader */
+      g_mutex_lock (&decoder->lock);
+      decoder->in_flight -= segment->length;
+      if (G_LIKELY (succeed))
+        segment->ready = TRUE;
+      else if (decoder->error == NULL)
+        decoder->error = error;
+      else
+        g_error_free (error);
+      error = NULL;
+      g_cond_broadcast (&decoder->cond);
+      g_mutex_unlock (&decoder->lock);
+    }
+
+#ifdef HAVE_ZSTD
+  ZSTD_freeDCtx (context.dctx);
+#endif
+#ifdef HAVE_ZLIB
+  if (context.inflating)
+    inflateEnd (&context.stream);
+#endif
+
+  return NULL;
+}
+
+
+
+/**
+ * tap_decoder_new:
+ * @filename  : the path to a compressed archive.
+ * @n_threads : the number of threads to decode on.
+ *
+ * Prepares to decode the compressed archive @filename on @n_threads
+ * threads, if it is made of independent segments that can be found
+ * without decoding it: the frames of zstd, which pzstd and the seekable
+ * format write, the blocks of xz, which xz -T writes, and the members
+ * of BGZF, as written by bgzip. The members of other gzip files, and
+ * the single stream pigz writes, cannot be found without inflating
+ * them, so they are left to libarchive.
+ *
+ * The archive is read with pread(), only the headers of the segments
+ * while looking for them, and never mapped, so archives on media that
+ * go away only fail to extract. The segments are decoded in parallel,
+ * and kept until they are read in order with tap_decoder_read(), up to
+ * a bounded amount of memory. The sizes in the archive are not trusted
+ * for that: archives with a segment larger than a fixed limit, or
+ * without a size, are left to libarchive, and no segment is decoded
+ * beyond the size it claims.
+ *
+ * Return value: the new #TapDecoder, or %NULL if @filename does not
+ *               have several independent segments that fit into memory.
+ **/
+TapDecoder*
+tap_decoder_new (const gchar *filename,
+                 guint        n_threads)
+{
+  TapDecoderSegment *segment;
+  struct stat        statb;
+  TapDecoder        *decoder;
+  gboolean           scanned = FALSE;
+  GArray            *units;
+  guint              n;
+  gint               fd;
+
+  TAP_TRACE_SCOPE ("decoder-scan");
+
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (G_UNLIKELY (fd < 0))
+    return NULL;
+  if (G_UNLIKELY (fstat (fd, &statb) < 0))
+    {
+      close (fd);
+      return NULL;
+    }
+
+  decoder = g_slice_new0 (TapDecoder);
+  decoder->fd = fd;
+  decoder->length = statb.st_size;
+  decoder->segments = g_array_new (FALSE, FALSE, sizeof (TapDecoderSegment));
+  g_mutex_init (&decoder->lock);
+  g_cond_init (&decoder->cond);
+
+  units = g_array_new (FALSE, FALSE, sizeof (TapDecoderSegment));
+
+  decoder->format = tap_decoder_sniff (decoder);
+  switch (decoder->format)
+    {
+#ifdef HAVE_ZSTD
+    case TAP_DECODER_ZSTD:
+      scanned = tap_decoder_scan_zstd (decoder, units);
+      break;
+#endif
+
+#ifdef HAVE_LZMA
+    case TAP_DECODER_XZ:
+      scanned = tap_decoder_scan_xz (decoder, units);
+      break;
+#endif
+
+#ifdef HAVE_ZLIB
+    case TAP_DECODER_BGZF:
+      scanned = tap_decoder_scan_bgzf (decoder, units);
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  if (scanned)
+    tap_decoder_merge (decoder, units);
+  g_array_free (units, TRUE);
+
+  /* the headers are not needed anymore */
+  g_free (decoder->headers);
+  decoder->headers = NULL;
+
+  /* a single segment is no faster than libarchive */
+  if (decoder->segments->len < 2)
+    {
+      tap_decoder_free (decoder);
+      return NULL;
+    }
+
+  /* the sizes come from the archive, so huge, crafted or unknown ones are left to libarchive, which streams them */
+  for (n = 0; n < decoder->segments->len; ++n)
+    {
+      segment = &g_array_index (decoder->segments, TapDecoderSegment, n);
+      if (segment->size > TAP_DECODER_MAX_SEGMENT || segment->length > TAP_DECODER_MAX_SEGMENT)
+        {
+          tap_decoder_free (decoder);
+          return NULL;
+        }
+    }
+
+  /* the reader parses the archive while the workers decode ahead */
+  decoder->n_threads = CLAMP (n_threads, 1, decoder->segments->len);
+  decoder->window = 2 * decoder->n_threads;
+  decoder->threads = g_new (GThread *, decoder->n_threads);
+  for (n = 0; n < decoder->n_threads; ++n)
+    decoder->threads[n] = g_thread_new ("tap-decoder", tap_decoder_worker, decoder);
+
+  return decoder;
+}
+
+
+
+/**
+ * tap_decoder_free:
+ * @decoder : a #TapDecoder.
+ *
+ * Stops the workers of the @decoder and releases it.
+ **/
+void
+tap_decoder_free (TapDecoder *decoder)
+{
+  guint n;
+
+  g_mutex_lock (&decoder->lock);
+  decoder->cancelled = TRUE;
+  g_cond_broadcast (&decoder->cond);
+  g_mutex_unlock (&decoder->lock);
+
+  for (n = 0; n < decoder->n_threads; ++n)
+    g_thread_join (decoder->threads[n]);
+
+  for (n = 0; n < decoder->segments->len; ++n)
+    g_free (g_array_index (decoder->segments, TapDecoderSegment, n).data);
+
+  if (decoder->error != NULL)
+    g_error_free (decoder->error);
+  g_mutex_clear (&decoder->lock);
+  g_cond_clear (&decoder->cond);
+  g_array_free (decoder->segments, TRUE);
+  close (decoder->fd);
+  g_free (decoder->threads);
+  g_slice_free (TapDecoder, decoder);
+}
+
+
+
+/**
+ * tap_decoder_read:
+ * @decoder : a #TapDecoder.
+ * @buffer  : return location for the decoded data.
+ * @error   : return location for errors or %NULL.
+ *
+ * Waits for the next segment of the @decoder and returns its decoded
+ * data in @buffer, which stays valid until the next call. Only one
+ * thread may read from a #TapDecoder.
+ *
+ * Return value: the length of @buffer, %0 at the end, or %-1 on errors.
+ **/
+gssize
+tap_decoder_read (TapDecoder    *decoder,
+                  gconstpointer *buffer,
+                  GError       **error)
+{
+  TapDecoderSegment *segment;
+  gssize             length = 0;
+
+  g_mutex_lock (&decoder->lock);
+
+  for (;;)
+    {
+      /* release the segment read last, which makes room for the workers */
+      if (decoder->reading)
+        {
+          segment = &g_array_index (decoder->segments, TapDecoderSegment, decoder->consumed);
+          g_free (segment->data);
+          segment->data = NULL;
+          decoder->in_flight -= segment->size;
+          decoder->consumed += 1;
+          decoder->reading = FALSE;
+          g_cond_broadcast (&decoder->cond);
+        }
+
+      if (decoder->consumed >= decoder->segments->len)
+        break;
+
+      segment = &g_array_index (decoder->segments, TapDecoderSegment, decoder->consumed);
+      while (!segment->ready && decoder->error == NULL)
+        g_cond_wait (&decoder->cond, &decoder->lock);
+
+      if (G_UNLIKELY (decoder->error != NULL))
+        {
+          g_propagate_error (error, g_error_copy (decoder->error));
+          length = -1;
+          break;
+        }
+
+      /* empty segments would look like the end */
+      decoder->reading = TRUE;
+      if (segment->data_length > 0)
+        {
+          *buffer = segment->data;
+          length = segment->data_length;
+          break;
+        }
+    }
+
+  g_mutex_unlock (&decoder->lock);
+
+  return length;
+}
@@ -0,0 +1,40 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_DECODER_H__
+#define __TAP_DECODER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapDecoder TapDecoder;
+
+TapDecoder *tap_decoder_new  (const gchar   *filename,
+                              guint          n_threads) G_GNUC_INTERNAL G_GNUC_MALLOC;
+void        tap_decoder_free (TapDecoder    *decoder) G_GNUC_INTERNAL;
+
+gssize      tap_decoder_read (TapDecoder    *decoder,
+                              gconstpointer *buffer,
+                              GError       **error) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_DECODER_H__ */
@@ -0,0 +1,588 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-arena.h>
+#include <thunar-archive-plugin/tap-decoder.h>
+#include <thunar-archive-plugin/tap-extract.h>
+#include <thunar-archive-plugin/tap-index.h>
+#include <thunar-archive-plugin/tap-peek.h>
+#include <thunar-archive-plugin/tap-writer.h>
+#ifdef HAVE_ZLIB
+#include <thunar-archive-plugin/tap-zip.h>
+#endif
+
+
+
+/* the read block size used for archives */
+#define TAP_EXTRACT_BLOCK_SIZE (64 * 1024)
+
+/* the number of bytes between two progress reports */
+#define TAP_EXTRACT_PROGRESS_STEP (4 * 1024 * 1024)
+
+/* the size of the chunks for the metadata of an entry */
+#define TAP_EXTRACT_ARENA_SIZE (16 * 1024)
+
+/* never follow symlinks or ".." out of the destination folder; absolute
+ * paths are fine, since every entry is joined below the destination */
+#define TAP_EXTRACT_FLAGS (ARCHIVE_EXTRACT_TIME                \
+                           | ARCHIVE_EXTRACT_SECURE_SYMLINKS   \
+                           | ARCHIVE_EXTRACT_SECURE_NODOTDOT)
+
+
+
+static void       tap_extract_set_error   (GError        **error,
+                                           struct archive *archive,
+                                           const gchar    *filename);
+static la_ssize_t tap_extract_read        (struct archive *archive,
+                                           void           *client_data,
+                                           const void    **buffer);
+static gboolean   tap_extract_read_file   (struct archive *reader,
+                                           gpointer        data,
+                                           gsize           size);
+static gchar     *tap_extract_join        (TapArena       *arena,
+                                           const gchar    *folder,
+                                           const gchar    *pathname);
+static gchar     *tap_extract_unique_path (const gchar    *folder,
+                                           const gchar    *name) G_GNUC_MALLOC;
+static gboolean   tap_extract_relocate    (const gchar    *staging,
+                                           const gchar    *folder,
+                                           const gchar    *filename,
+                                           GError        **error);
+
+
+
+static void
+tap_extract_set_error (GError        **error,
+                       struct archive *archive,
+                       const gchar    *filename)
+{
+  const gchar *message;
+  gchar       *display_name;
+
+  message = archive_error_string (archive);
+  display_name = g_filename_display_basename (filename);
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Failed to extract \"%s\": %s"),
+               display_name, (message != NULL) ? message : _("Unknown error"));
+  g_free (display_name);
+}
+
+
+
+static la_ssize_t
+tap_extract_read (struct archive *archive,
+                  void           *client_data,
+                  const void    **buffer)
+{
+  GError *error = NULL;
+  gssize  length;
+
+  length = tap_decoder_read (client_data, buffer, &error);
+  if (G_UNLIKELY (length < 0))
+    {
+      archive_set_error (archive, EIO, "%s", error->message);
+      g_error_free (error);
+    }
+
+  return length;
+}
+
+
+
+static gboolean
+tap_extract_read_file (struct archive *reader,
+                       gpointer        data,
+                       gsize           size)
+{
+  const void *buffer;
+  la_int64_t  offset;
+  size_t      length;
+  gint        r;
+
+  /* sparse files leave holes, which are zero */
+  memset (data, 0, size);
+
+  while ((r = archive_read_data_block (reader, &buffer, &length, &offset)) == ARCHIVE_OK)
+    if (G_LIKELY (offset >= 0 && (gsize) offset <= size))
+      memcpy ((guint8 *) data + offset, buffer, MIN (length, size - (gsize) offset));
+
+  return (r >= ARCHIVE_WARN);
+}
+
+
+
+static gchar*
+tap_extract_join (TapArena    *arena,
+                  const gchar *folder,
+                  const gchar *pathname)
+{
+  gchar *path;
+  gsize  length;
+
+  /* absolute entries go below the folder as well */
+  while (G_IS_DIR_SEPARATOR (*pathname))
+    pathname++;
+
+  length = strlen (folder);
+  path = tap_arena_alloc (arena, length + strlen (pathname) + 2);
+  memcpy (path, folder, length);
+  path[length] = G_DIR_SEPARATOR;
+  strcpy (path + length + 1, pathname);
+
+  return path;
+}
+
+
+
+static gchar*
+tap_extract_unique_path (const gchar *folder,
+                         const gchar *name)
+{
+  gchar *path;
+  gchar *s;
+  guint  n;
+
+  /* append " (2)", " (3)", ... until the name is free */
+  path = g_build_filename (folder, name, NULL);
+  for (n = 2; g_file_test (path, G_FILE_TEST_EXISTS) || g_file_test (path, G_FILE_TEST_IS_SYMLINK); ++n)
+    {
+      g_free (path);
+      s = g_strdup_printf ("%s (%u)", name, n);
+      path = g_build_filename (folder, s, NULL);
+      g_free (s);
+    }
+
+  return path;
+}
+
+
+
+static gboolean
+tap_extract_relocate (const gchar *staging,
+                      const gchar *folder,
+                      const gchar *filename,
+                      GError     **error)
+{
+  const gchar *name;
+  gboolean     succeed = TRUE;
+  gboolean     single;
+  gchar       *source;
+  gchar       *target;
+  gchar       *first;
+  GDir        *dir;
+  gint         saved_errno;
+
+  /* determine whether the archive has a single root */
+  dir = g_dir_open (staging, 0, error);
+  if (G_UNLIKELY (dir == NULL))
+    return FALSE;
+  name = g_dir_read_name (dir);
+  first = g_strdup (name);
+  single = (name != NULL && g_dir_read_name (dir) == NULL);
+  g_dir_close (dir);
+
+  if (G_UNLIKELY (first == NULL))
+    {
+      /* nothing to move for empty archives */
+      g_rmdir (staging);
+      return TRUE;
+    }
+
+  if (single)
+    {
+      /* move the single root right into the folder */
+      source = g_build_filename (staging, first, NULL);
+      target = tap_extract_unique_path (folder, first);
+    }
+  else
+    {
+      /* keep the entries together in a folder named after the archive */
+      source = g_strdup (staging);
+      target = tap_peek_subfolder (folder, filename);
+    }
+
+  if (G_UNLIKELY (g_rename (source, target) < 0))
+    {
+      saved_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   _("Failed to move extracted files: %s"), g_strerror (saved_errno));
+      succeed = FALSE;
+    }
+  else if (single)
+    {
+      g_rmdir (staging);
+    }
+
+  g_free (target);
+  g_free (source);
+  g_free (first);
+
+  return succeed;
+}
+
+
+
+/**
+ * tap_extract_archive:
+ * @filename    : the path to the archive.
+ * @folder      : the folder in which to extract the archive.
+ * @n_threads   : the number of threads to decode on.
+ * @progress    : the function to report the progress to, or %NULL.
+ * @user_data   : the data to pass to @progress.
+ * @unsupported : set to %TRUE if libarchive cannot handle the archive.
+ * @error       : return location for errors or %NULL.
+ *
+ * Extracts the archive @filename with libarchive, streaming the entries
+ * straight to the disk, where folders and small files are written in
+ * batches by a #TapWriter. Archives with a single root end up directly in
+ * @folder, others in a folder named after the archive. The headers of
+ * the archive are peeked at first, so the entries are written to their
+ * final place right away, and only archives whose layout could not be
+ * determined, or whose root exists already, go through a staging folder
+ * that is moved into place afterwards. The entries of zip archives are
+ * inflated on @n_threads threads where possible, see tap_zip_extract(),
+ * and so are the segments of tarballs made by parallel compressors, see
+ * tap_decoder_new(). The memory stays the same however large the archive
+ * is: the metadata of every entry lives in an arena that is reset for
+ * the next one, small files go through the buffers of the #TapWriter,
+ * and the rest is streamed. Archives whose index says that they do not
+ * fit into the free space of @folder are not extracted at all, see
+ * tap_peek_check_space(). The entries are recorded in the index of the
+ * archive on the way, if the peek could not index it from the headers,
+ * so a later look at the archive needs no second walk. Archives that cannot be opened, or whose
+ * entries are encrypted, are not touched and flagged in @unsupported
+ * instead, so they can be passed to a wrapper.
+ *
+ * This function blocks, and may be called from any thread.
+ *
+ * Return value: %TRUE if the archive was extracted.
+ **/
+gboolean
+tap_extract_archive (const gchar       *filename,
+                     const gchar       *folder,
+                     guint              n_threads,
+                     TapExtractProgress progress,
+                     gpointer           user_data,
+                     gboolean          *unsupported,
+                     GError           **error)
+{
+  struct archive_entry *entry;
+  struct archive       *reader;
+  struct archive       *writer = NULL;
+  TapWriter            *batch = NULL;
+  TapDecoder           *decoder;
+  TapIndexBuilder      *index = NULL;
+  TapArena             *arena = NULL;
+  const gchar          *pathname;
+  const gchar          *hardlink;
+  const void           *buffer;
+  gpointer              data;
+  la_int64_t            offset;
+  gboolean              succeed = FALSE;
+  gboolean              created = FALSE;
+  GError               *err = NULL;
+  gchar                *destination = NULL;
+  gchar                *staging = NULL;
+  gchar                *root = NULL;
+  gchar                *path;
+  size_t                length;
+  TapPeekResult         layout;
+#ifdef HAVE_ZLIB
+  gboolean              handled;
+#endif
+  guint64               written = 0;
+  guint64               reported = 0;
+  gint64                mtime;
+  gint64                size;
+  gint                  saved_errno;
+  gint                  r;
+
+  *unsupported = FALSE;
+
+  /* tarballs of parallel compressors are decoded on several threads, and only parsed by libarchive */
+  decoder = tap_decoder_new (filename, n_threads);
+
+  reader = archive_read_new ();
+  if (G_LIKELY (decoder == NULL))
+    archive_read_support_filter_all (reader);
+  archive_read_support_format_all (reader);
+
+  /* archives libarchive cannot read, or that need a password, are left to the wrappers */
+  if (G_UNLIKELY (decoder != NULL))
+    r = archive_read_open (reader, decoder, NULL, tap_extract_read, NULL);
+  else
+    r = archive_read_open_filename (reader, filename, TAP_EXTRACT_BLOCK_SIZE);
+  if (G_LIKELY (r == ARCHIVE_OK))
+    r = archive_read_next_header (reader, &entry);
+  if (G_UNLIKELY (r < ARCHIVE_WARN || (r != ARCHIVE_EOF && archive_entry_is_encrypted (entry))))
+    {
+      *unsupported = TRUE;
+      archive_read_free (reader);
+      if (decoder != NULL)
+        tap_decoder_free (decoder);
+      return FALSE;
+    }
+
+  /* decide on the destination from the headers, which indexes the archive on the way,
+   * so archives that would run out of space are not even started */
+  layout = tap_peek_archive (filename, &root);
+  if (!tap_peek_check_space (filename, folder, error))
+    {
+      g_free (root);
+      archive_read_free (reader);
+      if (decoder != NULL)
+        tap_decoder_free (decoder);
+      return FALSE;
+    }
+
+  switch (layout)
+    {
+    case TAP_PEEK_SINGLE_ROOT:
+      path = g_build_filename (folder, root, NULL);
+      if (!g_file_test (path, G_FILE_TEST_EXISTS) && !g_file_test (path, G_FILE_TEST_IS_SYMLINK))
+        destination = g_strdup (folder);
+      g_free (path);
+      g_free (root);
+      break;
+
+    case TAP_PEEK_MULTIPLE_ROOTS:
+      path = tap_peek_subfolder (folder, filename);
+      created = (g_mkdir (path, 0777) == 0);
+      if (G_LIKELY (created))
+        destination = path;
+      else
+        g_free (path);
+      break;
+
+    default:
+      break;
+    }
+
+  /* otherwise extract into a private staging folder first */
+  if (G_UNLIKELY (destination == NULL))
+    {
+      staging = g_build_filename (folder, ".tap-XXXXXX", NULL);
+      if (G_UNLIKELY (g_mkdtemp_full (staging, 0777) == NULL))
+        {
+          saved_errno = errno;
+          g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                       _("Failed to create folder: %s"), g_strerror (saved_errno));
+          g_free (staging);
+          archive_read_free (reader);
+          if (decoder != NULL)
+            tap_decoder_free (decoder);
+          return FALSE;
+        }
+      destination = g_strdup (staging);
+    }
+
+  /* libarchive refuses symlinks in every component of the paths it gets, even in
+   * the destination itself, like /home -> var/home, so resolve those once */
+  path = realpath (destination, NULL);
+  if (G_LIKELY (path != NULL))
+    {
+      g_free (destination);
+      destination = g_strdup (path);
+      free (path);
+    }
+
+#ifdef HAVE_ZLIB
+  /* zip archives have their entries indexed, so they are inflated on several threads */
+  if ((archive_format (reader) & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP)
+    {
+      succeed = tap_zip_extract (filename, destination, n_threads, progress, user_data, &handled, error);
+      if (handled)
+        goto done;
+    }
+#endif
+
+  batch = tap_writer_new (destination, n_threads, error);
+  if (G_UNLIKELY (batch == NULL))
+    goto done;
+
+  writer = archive_write_disk_new ();
+  archive_write_disk_set_options (writer, TAP_EXTRACT_FLAGS);
+  archive_write_disk_set_standard_lookup (writer);
+
+  arena = tap_arena_new (TAP_EXTRACT_ARENA_SIZE);
+
+  /* the entries are walked anyway, so record the index of the archive on the way */
+  index = tap_index_builder_new (filename);
+
+  for (; r != ARCHIVE_EOF; r = archive_read_next_header (reader, &entry))
+    {
+      if (G_UNLIKELY (r < ARCHIVE_WARN))
+        {
+          tap_extract_set_error (error, reader, filename);
+          goto done;
+        }
+
+      tap_arena_reset (arena);
+
+      pathname = archive_entry_pathname (entry);
+      if (G_UNLIKELY (pathname == NULL))
+        continue;
+
+      /* folders and small files, the bulk of most archives, are written in batches */
+      mtime = archive_entry_mtime_is_set (entry) ? archive_entry_mtime (entry) : -1;
+      size = archive_entry_size_is_set (entry) ? archive_entry_size (entry) : -1;
+      if (index != NULL)
+        tap_index_builder_add (index, pathname, strlen (pathname), MAX (size, 0), archive_read_header_position (reader));
+      if (archive_entry_hardlink (entry) == NULL && archive_entry_filetype (entry) == AE_IFDIR)
+        {
+          if (!tap_writer_mkdir (batch, pathname, archive_entry_perm (entry) & 0777, mtime, error))
+            goto done;
+          continue;
+        }
+      else if (archive_entry_hardlink (entry) == NULL && archive_entry_filetype (entry) == AE_IFREG
+               && size >= 0 && size <= TAP_WRITER_BUFFER_SIZE)
+        {
+          data = tap_writer_acquire (batch);
+          if (G_UNLIKELY (!tap_extract_read_file (reader, data, size)))
+            {
+              tap_writer_release (batch, data);
+              tap_extract_set_error (error, reader, filename);
+              goto done;
+            }
+
+          if (!tap_writer_submit (batch, pathname, archive_entry_perm (entry) & 0777, mtime, data, size, error))
+            goto done;
+
+          written += size;
+          if (progress != NULL && written - reported >= TAP_EXTRACT_PROGRESS_STEP)
+            {
+              (*progress) (written, user_data);
+              reported = written;
+            }
+          continue;
+        }
+
+      /* everything else goes through libarchive, once the files before it exist */
+      if (!tap_writer_flush (batch, error))
+        goto done;
+
+      /* relocate the entry, and the target of hardlinks, into the destination */
+      archive_entry_set_pathname (entry, tap_extract_join (arena, destination, pathname));
+
+      hardlink = archive_entry_hardlink (entry);
+      if (G_UNLIKELY (hardlink != NULL))
+        archive_entry_set_hardlink (entry, tap_extract_join (arena, destination, hardlink));
+
+      if (G_UNLIKELY (archive_write_header (writer, entry) < ARCHIVE_WARN))
+        {
+          tap_extract_set_error (error, writer, filename);
+          goto done;
+        }
+
+      /* stream the data blocks straight to the disk */
+      if (archive_entry_filetype (entry) == AE_IFREG)
+        {
+          while ((r = archive_read_data_block (reader, &buffer, &length, &offset)) == ARCHIVE_OK)
+            {
+              if (G_UNLIKELY (archive_write_data_block (writer, buffer, length, offset) < ARCHIVE_WARN))
+                {
+                  tap_extract_set_error (error, writer, filename);
+                  goto done;
+                }
+
+              /* report the progress every few megabytes */
+              written += length;
+              if (progress != NULL && written - reported >= TAP_EXTRACT_PROGRESS_STEP)
+                {
+                  (*progress) (written, user_data);
+                  reported = written;
+                }
+            }
+
+          if (G_UNLIKELY (r < ARCHIVE_WARN))
+            {
+              tap_extract_set_error (error, reader, filename);
+              goto done;
+            }
+        }
+
+      if (G_UNLIKELY (archive_write_finish_entry (writer) < ARCHIVE_WARN))
+        {
+          tap_extract_set_error (error, writer, filename);
+          goto done;
+        }
+    }
+
+  /* apply the deferred folder times and permissions */
+  if (G_UNLIKELY (archive_write_close (writer) < ARCHIVE_WARN))
+    {
+      tap_extract_set_error (error, writer, filename);
+      goto done;
+    }
+
+  if (!tap_writer_finish (batch, error))
+    goto done;
+
+  succeed = TRUE;
+
+  if (index != NULL)
+    {
+      tap_index_builder_finish (index);
+      index = NULL;
+    }
+
+done:
+  if (index != NULL)
+    tap_index_builder_free (index);
+  if (arena != NULL)
+    tap_arena_free (arena);
+  if (batch != NULL)
+    tap_writer_free (batch);
+  archive_write_free (writer);
+  archive_read_free (reader);
+  if (decoder != NULL)
+    tap_decoder_free (decoder);
+
+  /* move the extracted files into place, even partial ones after errors */
+  if (staging != NULL && !tap_extract_relocate (staging, folder, filename, &err))
+    {
+      if (succeed)
+        g_propagate_error (error, err);
+      else
+        g_error_free (err);
+      succeed = FALSE;
+    }
+
+  /* don't leave the subfolder behind if nothing was extracted, which only succeeds while it is empty */
+  if (!succeed && created)
+    g_rmdir (destination);
+
+  g_free (destination);
+  g_free (staging);
+
+  return succeed;
+}
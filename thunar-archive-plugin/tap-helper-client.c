@@ -0,0 +1,152 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <thunar-archive-plugin/tap-helper-client.h>
+#include <thunar-archive-plugin/tap-helper-protocol.h>
+
+
+
+/* don't try to start the helper more often than this, in microseconds */
+#define TAP_HELPER_START_INTERVAL (10 * G_USEC_PER_SEC)
+
+
+
+static void tap_helper_start (void);
+
+
+
+static GMutex tap_helper_lock;
+static gint64 tap_helper_started = G_MININT64;
+
+
+
+static void
+tap_helper_start (void)
+{
+  GError *error = NULL;
+  gchar  *argv[2];
+  gint64  now;
+
+  g_mutex_lock (&tap_helper_lock);
+
+  now = g_get_monotonic_time ();
+  if (now - tap_helper_started >= TAP_HELPER_START_INTERVAL)
+    {
+      tap_helper_started = now;
+
+      /* the helper detaches from us, and exits on its own once idle */
+      argv[0] = (gchar *) TAP_HELPER_PATH;
+      argv[1] = NULL;
+      if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, NULL, &error))
+        {
+          g_warning ("Failed to start the archive helper: %s", error->message);
+          g_error_free (error);
+        }
+    }
+
+  g_mutex_unlock (&tap_helper_lock);
+}
+
+
+
+/**
+ * tap_helper_connect:
+ *
+ * Connects to the archive helper. If the helper is not running,
+ * it is started for the next jobs, but this function does not wait
+ * for it, so the caller can run the job locally right away.
+ *
+ * This function may be called from any thread.
+ *
+ * Return value: the connection to the helper, or %NULL.
+ **/
+GSocketConnection*
+tap_helper_connect (void)
+{
+  GSocketConnection *connection;
+  GSocketAddress    *address;
+  GSocketClient     *client;
+  gchar             *path;
+
+  path = tap_helper_socket_path ();
+  address = g_unix_socket_address_new (path);
+  client = g_socket_client_new ();
+
+  connection = g_socket_client_connect (client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+  if (G_UNLIKELY (connection == NULL))
+    tap_helper_start ();
+
+  g_object_unref (client);
+  g_object_unref (address);
+  g_free (path);
+
+  return connection;
+}
+
+
+
+/**
+ * tap_helper_call:
+ * @connection : the connection to the helper.
+ * @kind       : the kind of request, "spawn" or "extract".
+ * @request    : the a{sv} parameters of the request.
+ * @error      : return location for errors or %NULL.
+ *
+ * Sends the @request to the helper, and blocks until the helper
+ * replies with the result. Progress reports are skipped.
+ *
+ * Return value: the a{sv} result, or %NULL if the helper could
+ *               not be reached.
+ **/
+GVariant*
+tap_helper_call (GSocketConnection *connection,
+                 const gchar       *kind,
+                 GVariant          *request,
+                 GError           **error)
+{
+  GVariant *result;
+  gchar    *reply;
+
+  g_return_val_if_fail (G_IS_SOCKET_CONNECTION (connection), NULL);
+  g_return_val_if_fail (kind != NULL, NULL);
+
+  if (!tap_helper_send (g_io_stream_get_output_stream (G_IO_STREAM (connection)), kind, request, error))
+    return NULL;
+
+  for (;;)
+    {
+      result = tap_helper_receive (g_io_stream_get_input_stream (G_IO_STREAM (connection)), &reply, error);
+      if (G_UNLIKELY (result == NULL))
+        return NULL;
+
+      if (strcmp (reply, "result") == 0)
+        {
+          g_free (reply);
+          return result;
+        }
+
+      g_variant_unref (result);
+      g_free (reply);
+    }
+}
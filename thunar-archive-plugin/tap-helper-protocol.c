@@ -0,0 +1,141 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <thunar-archive-plugin/tap-helper-protocol.h>
+
+
+
+/* refuse messages larger than this, the biggest are environments */
+#define TAP_HELPER_MESSAGE_MAX (16 * 1024 * 1024)
+
+
+
+/**
+ * tap_helper_socket_path:
+ *
+ * Determines the path of the socket the helper listens on, in a
+ * private folder of the runtime directory of the user.
+ *
+ * Return value: the path to the socket.
+ **/
+gchar*
+tap_helper_socket_path (void)
+{
+  return g_build_filename (g_get_user_runtime_dir (), "thunar-archive-plugin", "helper.socket", NULL);
+}
+
+
+
+/**
+ * tap_helper_send:
+ * @stream     : the output stream of the connection.
+ * @kind       : the kind of message, e.g. "spawn" or "result".
+ * @parameters : a floating a{sv} #GVariant, which is consumed.
+ * @error      : return location for errors or %NULL.
+ *
+ * Writes a message to @stream, as its size in little endian
+ * followed by the serialized #GVariant. Blocks until it is sent.
+ *
+ * Return value: %TRUE if the message was sent.
+ **/
+gboolean
+tap_helper_send (GOutputStream *stream,
+                 const gchar   *kind,
+                 GVariant      *parameters,
+                 GError       **error)
+{
+  GVariant *message;
+  gboolean  succeed;
+  guint32   size;
+
+  message = g_variant_ref_sink (g_variant_new ("(s@a{sv})", kind, parameters));
+  size = GUINT32_TO_LE (g_variant_get_size (message));
+
+  succeed = g_output_stream_write_all (stream, &size, sizeof (size), NULL, NULL, error)
+         && g_output_stream_write_all (stream, g_variant_get_data (message), g_variant_get_size (message), NULL, NULL, error);
+
+  g_variant_unref (message);
+
+  return succeed;
+}
+
+
+
+/**
+ * tap_helper_receive:
+ * @stream : the input stream of the connection.
+ * @kind   : return location for the kind of the message, free
+ *          with g_free().
+ * @error  : return location for errors or %NULL.
+ *
+ * Reads a message from @stream, blocking until it is complete.
+ *
+ * Return value: the a{sv} parameters of the message, or %NULL on
+ *               error or if the peer closed the connection.
+ **/
+GVariant*
+tap_helper_receive (GInputStream *stream,
+                    gchar       **kind,
+                    GError      **error)
+{
+  GVariant *message;
+  GVariant *parameters;
+  gpointer  data;
+  guint32   size;
+  gsize     n;
+
+  if (!g_input_stream_read_all (stream, &size, sizeof (size), &n, NULL, error))
+    return NULL;
+  if (G_UNLIKELY (n == 0))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+      return NULL;
+    }
+
+  size = GUINT32_FROM_LE (size);
+  if (G_UNLIKELY (n != sizeof (size) || size > TAP_HELPER_MESSAGE_MAX))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Malformed message");
+      return NULL;
+    }
+
+  data = g_malloc (size);
+  if (!g_input_stream_read_all (stream, data, size, &n, NULL, error) || n != size)
+    {
+      if (error != NULL && *error == NULL)
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+      g_free (data);
+      return NULL;
+    }
+
+  /* the data comes from another process, so only accept well-formed messages */
+  message = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (TAP_HELPER_MESSAGE_TYPE), data, size, FALSE, g_free, data));
+  if (G_UNLIKELY (!g_variant_is_normal_form (message)))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Malformed message");
+      g_variant_unref (message);
+      return NULL;
+    }
+
+  g_variant_get (message, "(s@a{sv})", kind, &parameters);
+  g_variant_unref (message);
+
+  return parameters;
+}
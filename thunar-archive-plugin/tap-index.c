@@ -0,0 +1,599 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <thunar-archive-plugin/tap-index.h>
+#include <thunar-archive-plugin/tap-trace.h>
+
+
+
+/* the start of every index file, with the version of the format */
+#define TAP_INDEX_MAGIC "TAPTOC\0\1"
+
+/* the largest index that is built, in bytes, so the memory of an extraction stays bounded */
+#define TAP_INDEX_MAX_LENGTH (16 * 1024 * 1024)
+
+/* the indexes are dropped after a month, and the oldest once they take more than this */
+#define TAP_INDEX_MAX_AGE  (30 * G_TIME_SPAN_DAY)
+#define TAP_INDEX_MAX_SIZE (64 * 1024 * 1024)
+
+/* marks the root of archives without a single root */
+#define TAP_INDEX_NO_ROOT G_MAXUINT32
+
+
+
+typedef struct _TapIndexHeader TapIndexHeader;
+typedef struct _TapIndexEntry  TapIndexEntry;
+typedef struct _TapIndexFile   TapIndexFile;
+
+
+
+static gchar    *tap_index_path    (const gchar   *filename) G_GNUC_MALLOC;
+static gboolean  tap_index_stat    (const gchar   *filename,
+                                    guint64       *size,
+                                    gint64        *mtime);
+static gint      tap_index_compare (gconstpointer  a,
+                                    gconstpointer  b);
+static void      tap_index_prune   (const gchar   *dirname);
+
+
+
+/* the index files are native endian, they never leave the machine */
+struct _TapIndexHeader
+{
+  gchar   magic[8];
+
+  /* the archive the index describes, as it was when it was indexed */
+  guint64 archive_size;
+  gint64  archive_mtime;
+
+  guint64 n_entries;
+  guint64 total_size;
+  guint32 layout;
+
+  /* offsets into the strings that follow the entries */
+  guint32 root;
+  guint32 path;
+  guint32 padding;
+};
+
+struct _TapIndexEntry
+{
+  guint64 size;
+  guint64 offset;
+  guint32 name;
+  guint32 name_length;
+};
+
+struct _TapIndex
+{
+  GMappedFile          *mapped;
+  const TapIndexHeader *header;
+  const TapIndexEntry  *entries;
+  const gchar          *strings;
+  gsize                 strings_length;
+};
+
+struct _TapIndexBuilder
+{
+  gchar        *filename;
+
+  /* the archive as it was when the walk started */
+  guint64       archive_size;
+  gint64        archive_mtime;
+
+  GArray       *entries;
+  GString      *strings;
+  guint64       total_size;
+
+  /* the layout of the entries so far */
+  TapPeekResult layout;
+  gchar        *root;
+};
+
+struct _TapIndexFile
+{
+  gchar  *path;
+  gint64  mtime;
+  goffset size;
+};
+
+
+
+static gchar*
+tap_index_path (const gchar *filename)
+{
+  gchar *checksum;
+  gchar *name;
+  gchar *path;
+
+  /* the archives are keyed by their path, the size and mtime are checked later */
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, filename, -1);
+  name = g_strconcat (checksum, ".toc", NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "thunar-archive-plugin", "index", name, NULL);
+  g_free (checksum);
+  g_free (name);
+
+  return path;
+}
+
+
+
+static gboolean
+tap_index_stat (const gchar *filename,
+                guint64     *size,
+                gint64      *mtime)
+{
+  GStatBuf statb;
+
+  if (g_stat (filename, &statb) < 0 || !S_ISREG (statb.st_mode))
+    return FALSE;
+
+  *size = statb.st_size;
+  *mtime = (gint64) statb.st_mtime * G_USEC_PER_SEC;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+  *mtime += statb.st_mtim.tv_nsec / 1000;
+#endif
+
+  return TRUE;
+}
+
+
+
+static gint
+tap_index_compare (gconstpointer a,
+                   gconstpointer b)
+{
+  const TapIndexFile *fa = a;
+  const TapIndexFile *fb = b;
+
+  /* the most recently written first */
+  return (fa->mtime > fb->mtime) ? -1 : (fa->mtime < fb->mtime);
+}
+
+
+
+static void
+tap_index_prune (const gchar *dirname)
+{
+  TapIndexFile  file;
+  const gchar  *name;
+  GStatBuf      statb;
+  GArray       *files;
+  gint64        now;
+  goffset       total = 0;
+  GDir         *dir;
+  guint         n;
+
+  dir = g_dir_open (dirname, 0, NULL);
+  if (G_UNLIKELY (dir == NULL))
+    return;
+
+  files = g_array_new (FALSE, FALSE, sizeof (TapIndexFile));
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      if (!g_str_has_suffix (name, ".toc"))
+        continue;
+
+      file.path = g_build_filename (dirname, name, NULL);
+      if (g_stat (file.path, &statb) < 0 || !S_ISREG (statb.st_mode))
+        {
+          g_free (file.path);
+          continue;
+        }
+
+      file.mtime = (gint64) statb.st_mtime * G_USEC_PER_SEC;
+      file.size = statb.st_size;
+      g_array_append_val (files, file);
+    }
+  g_dir_close (dir);
+
+  /* drop the indexes of archives that were not extracted for a long time, and the
+   * oldest of the rest once they take too much space */
+  g_array_sort (files, tap_index_compare);
+  now = g_get_real_time ();
+  for (n = 0; n < files->len; ++n)
+    {
+      file = g_array_index (files, TapIndexFile, n);
+      total += file.size;
+      if (now - file.mtime > TAP_INDEX_MAX_AGE || total > TAP_INDEX_MAX_SIZE)
+        g_unlink (file.path);
+      g_free (file.path);
+    }
+  g_array_free (files, TRUE);
+}
+
+
+
+/**
+ * tap_index_lookup:
+ * @filename : the path to the archive.
+ *
+ * Looks up the index of the archive @filename, which lists the entries
+ * of the archive with their sizes and offsets. The index is mapped from
+ * the cache folder of the user, and only returned if the size and mtime
+ * of the archive did not change since it was built.
+ *
+ * This costs a stat() and a mapping, and may be called from any thread.
+ *
+ * Return value: the #TapIndex, to be freed with tap_index_free(), or
+ *               %NULL if there is no up to date index.
+ **/
+TapIndex*
+tap_index_lookup (const gchar *filename)
+{
+  const TapIndexHeader *header;
+  GMappedFile          *mapped;
+  TapIndex             *index;
+  guint64               size;
+  gint64                mtime;
+  gsize                 length;
+  gchar                *path;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  if (!tap_index_stat (filename, &size, &mtime))
+    return NULL;
+
+  path = tap_index_path (filename);
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  g_free (path);
+  if (G_LIKELY (mapped == NULL))
+    return NULL;
+
+  /* the file may be truncated or from another version */
+  header = (const TapIndexHeader *) g_mapped_file_get_contents (mapped);
+  length = g_mapped_file_get_length (mapped);
+  if (length < sizeof (TapIndexHeader)
+      || memcmp (header->magic, TAP_INDEX_MAGIC, sizeof (header->magic)) != 0
+      || header->archive_size != size
+      || header->archive_mtime != mtime
+      || header->n_entries > (length - sizeof (TapIndexHeader)) / sizeof (TapIndexEntry))
+    {
+      g_mapped_file_unref (mapped);
+      return NULL;
+    }
+
+  index = g_slice_new (TapIndex);
+  index->mapped = mapped;
+  index->header = header;
+  index->entries = (const TapIndexEntry *) (header + 1);
+  index->strings = (const gchar *) (index->entries + header->n_entries);
+  index->strings_length = length - sizeof (TapIndexHeader) - header->n_entries * sizeof (TapIndexEntry);
+
+  /* all strings must be terminated, and the first is the path of the archive */
+  if (index->strings_length == 0
+      || index->strings[index->strings_length - 1] != '\0'
+      || header->path >= index->strings_length
+      || strcmp (index->strings + header->path, filename) != 0
+      || (header->root != TAP_INDEX_NO_ROOT && header->root >= index->strings_length))
+    {
+      tap_index_free (index);
+      return NULL;
+    }
+
+  return index;
+}
+
+
+
+/**
+ * tap_index_free:
+ * @index : a #TapIndex.
+ *
+ * Unmaps the @index.
+ **/
+void
+tap_index_free (TapIndex *index)
+{
+  g_mapped_file_unref (index->mapped);
+  g_slice_free (TapIndex, index);
+}
+
+
+
+/**
+ * tap_index_get_n_entries:
+ * @index : a #TapIndex.
+ *
+ * Return value: the number of entries in the archive.
+ **/
+guint64
+tap_index_get_n_entries (const TapIndex *index)
+{
+  return index->header->n_entries;
+}
+
+
+
+/**
+ * tap_index_get_entry:
+ * @index  : a #TapIndex.
+ * @n      : the number of the entry, in the order of the archive.
+ * @size   : return location for the uncompressed size, or %NULL.
+ * @offset : return location for the offset of the header of the entry,
+ *           in the decompressed stream for compressed archives, or %NULL.
+ *
+ * Return value: the path of the entry as stored in the archive, which
+ *               is owned by the @index, or %NULL if the index is damaged.
+ **/
+const gchar*
+tap_index_get_entry (const TapIndex *index,
+                     guint64         n,
+                     guint64        *size,
+                     guint64        *offset)
+{
+  const TapIndexEntry *entry;
+
+  g_return_val_if_fail (n < index->header->n_entries, NULL);
+
+  entry = index->entries + n;
+  if (G_UNLIKELY (entry->name >= index->strings_length))
+    return NULL;
+
+  if (size != NULL)
+    *size = entry->size;
+  if (offset != NULL)
+    *offset = entry->offset;
+
+  return index->strings + entry->name;
+}
+
+
+
+/**
+ * tap_index_get_total_size:
+ * @index : a #TapIndex.
+ *
+ * Return value: the uncompressed size of all entries in the archive.
+ **/
+guint64
+tap_index_get_total_size (const TapIndex *index)
+{
+  return index->header->total_size;
+}
+
+
+
+/**
+ * tap_index_get_layout:
+ * @index : a #TapIndex.
+ * @root  : return location for the name of the single root, which is
+ *          owned by the @index, or %NULL.
+ *
+ * Determines the layout of the archive, like tap_peek_archive() does,
+ * but from all entries of the archive.
+ *
+ * Return value: the #TapPeekResult.
+ **/
+TapPeekResult
+tap_index_get_layout (const TapIndex *index,
+                      const gchar   **root)
+{
+  if (root != NULL)
+    *root = (index->header->root != TAP_INDEX_NO_ROOT) ? index->strings + index->header->root : NULL;
+
+  return index->header->layout;
+}
+
+
+
+/**
+ * tap_index_builder_new:
+ * @filename : the path to an archive.
+ *
+ * Starts to record the index of the archive @filename, while its headers
+ * are peeked at, see tap_peek_archive(), or while the archive is read for
+ * other reasons, like an extraction. The entries are passed to the builder with
+ * tap_index_builder_add() in the order of the archive, and the index is
+ * written with tap_index_builder_finish() once all of them were seen.
+ *
+ * Return value: the #TapIndexBuilder, or %NULL if the archive has an up
+ *               to date index already, or is no regular file.
+ **/
+TapIndexBuilder*
+tap_index_builder_new (const gchar *filename)
+{
+  TapIndexBuilder *builder;
+  TapIndex        *index;
+  guint64          size;
+  gint64           mtime;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  /* nothing to do if the index is still up to date */
+  index = tap_index_lookup (filename);
+  if (index != NULL)
+    {
+      tap_index_free (index);
+      return NULL;
+    }
+
+  if (!tap_index_stat (filename, &size, &mtime))
+    return NULL;
+
+  builder = g_slice_new0 (TapIndexBuilder);
+  builder->filename = g_strdup (filename);
+  builder->archive_size = size;
+  builder->archive_mtime = mtime;
+  builder->entries = g_array_new (FALSE, FALSE, sizeof (TapIndexEntry));
+  builder->strings = g_string_new (NULL);
+  builder->layout = TAP_PEEK_UNKNOWN;
+
+  /* the strings start with the path of the archive */
+  g_string_append (builder->strings, filename);
+  g_string_append_c (builder->strings, '\0');
+
+  return builder;
+}
+
+
+
+/**
+ * tap_index_builder_add:
+ * @builder  : a #TapIndexBuilder.
+ * @pathname : the path of the entry, as stored in the archive.
+ * @length   : the length of @pathname, which need not be nul-terminated.
+ * @size     : the uncompressed size of the entry.
+ * @offset   : the offset of the header of the entry in the archive, or
+ *             in the decompressed stream for compressed archives.
+ *
+ * Records the next entry of the archive. Archives with too many entries
+ * are not indexed, their entries are dropped once the index would get
+ * too large.
+ *
+ * Return value: %FALSE if the index was given up on.
+ **/
+gboolean
+tap_index_builder_add (TapIndexBuilder *builder,
+                       const gchar     *pathname,
+                       gsize            length,
+                       guint64          size,
+                       guint64          offset)
+{
+  TapIndexEntry entry;
+
+  /* the index was given up on */
+  if (G_UNLIKELY (builder->entries == NULL))
+    return FALSE;
+
+  if (G_UNLIKELY (builder->strings->len + length + 1 + (builder->entries->len + 1) * sizeof (TapIndexEntry) > TAP_INDEX_MAX_LENGTH))
+    {
+      g_array_free (builder->entries, TRUE);
+      g_string_free (builder->strings, TRUE);
+      builder->entries = NULL;
+      builder->strings = NULL;
+      return FALSE;
+    }
+
+  entry.size = size;
+  entry.offset = offset;
+  entry.name = builder->strings->len;
+  entry.name_length = length;
+  g_array_append_val (builder->entries, entry);
+
+  g_string_append_len (builder->strings, pathname, length);
+  g_string_append_c (builder->strings, '\0');
+  builder->total_size += size;
+
+  if (builder->layout == TAP_PEEK_UNKNOWN)
+    tap_peek_entry (&builder->layout, &builder->root, pathname, length);
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_index_builder_finish:
+ * @builder : a #TapIndexBuilder.
+ *
+ * Writes the index recorded by @builder to the cache folder of the user,
+ * unless the archive changed meanwhile, and frees the @builder. Indexes
+ * that were not used for a long time are dropped from the cache folder,
+ * and so are the oldest ones once they take too much space.
+ *
+ * This function blocks, and may be called from any thread.
+ **/
+void
+tap_index_builder_finish (TapIndexBuilder *builder)
+{
+  TapIndexHeader header;
+  GByteArray    *contents;
+  guint64        size;
+  gint64         mtime;
+  gchar         *dirname;
+  gchar         *path;
+
+  /* all entries were seen, and none had another root */
+  if (builder->layout == TAP_PEEK_UNKNOWN && builder->root != NULL)
+    builder->layout = TAP_PEEK_SINGLE_ROOT;
+
+  /* only write indexes of archives that did not change meanwhile */
+  if (builder->entries != NULL
+      && tap_index_stat (builder->filename, &size, &mtime)
+      && size == builder->archive_size && mtime == builder->archive_mtime
+      && (builder->layout != TAP_PEEK_SINGLE_ROOT
+          || builder->strings->len + strlen (builder->root) + 1 <= TAP_INDEX_MAX_LENGTH))
+    {
+      TAP_TRACE_SCOPE ("index");
+
+      memset (&header, 0, sizeof (header));
+      memcpy (header.magic, TAP_INDEX_MAGIC, sizeof (header.magic));
+      header.archive_size = size;
+      header.archive_mtime = mtime;
+      header.n_entries = builder->entries->len;
+      header.total_size = builder->total_size;
+      header.layout = builder->layout;
+      header.path = 0;
+      header.root = TAP_INDEX_NO_ROOT;
+      if (builder->layout == TAP_PEEK_SINGLE_ROOT)
+        {
+          header.root = builder->strings->len;
+          g_string_append (builder->strings, builder->root);
+          g_string_append_c (builder->strings, '\0');
+        }
+
+      contents = g_byte_array_sized_new (sizeof (header) + builder->entries->len * sizeof (TapIndexEntry) + builder->strings->len);
+      g_byte_array_append (contents, (const guint8 *) &header, sizeof (header));
+      g_byte_array_append (contents, (const guint8 *) builder->entries->data, builder->entries->len * sizeof (TapIndexEntry));
+      g_byte_array_append (contents, (const guint8 *) builder->strings->str, builder->strings->len);
+
+      /* replace the index atomically, readers may have the old one mapped */
+      path = tap_index_path (builder->filename);
+      dirname = g_path_get_dirname (path);
+      g_mkdir_with_parents (dirname, 0700);
+      g_file_set_contents (path, (const gchar *) contents->data, contents->len, NULL);
+      tap_index_prune (dirname);
+      g_byte_array_free (contents, TRUE);
+      g_free (dirname);
+      g_free (path);
+    }
+
+  tap_index_builder_free (builder);
+}
+
+
+
+/**
+ * tap_index_builder_free:
+ * @builder : a #TapIndexBuilder.
+ *
+ * Frees the @builder without writing the index, for walks through the
+ * archive that did not see all of its entries.
+ **/
+void
+tap_index_builder_free (TapIndexBuilder *builder)
+{
+  if (builder->entries != NULL)
+    g_array_free (builder->entries, TRUE);
+  if (builder->strings != NULL)
+    g_string_free (builder->strings, TRUE);
+  g_free (builder->filename);
+  g_free (builder->root);
+  g_slice_free (TapIndexBuilder, builder);
+}
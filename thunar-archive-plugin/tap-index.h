@@ -0,0 +1,54 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_INDEX_H__
+#define __TAP_INDEX_H__
+
+#include <thunar-archive-plugin/tap-peek.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapIndex        TapIndex;
+typedef struct _TapIndexBuilder TapIndexBuilder;
+
+TapIndex        *tap_index_lookup         (const gchar     *filename) G_GNUC_INTERNAL G_GNUC_MALLOC;
+void             tap_index_free           (TapIndex        *index) G_GNUC_INTERNAL;
+
+guint64          tap_index_get_n_entries  (const TapIndex  *index) G_GNUC_INTERNAL;
+const gchar     *tap_index_get_entry      (const TapIndex  *index,
+                                           guint64          n,
+                                           guint64         *size,
+                                           guint64         *offset) G_GNUC_INTERNAL;
+guint64          tap_index_get_total_size (const TapIndex  *index) G_GNUC_INTERNAL;
+TapPeekResult    tap_index_get_layout     (const TapIndex  *index,
+                                           const gchar    **root) G_GNUC_INTERNAL;
+
+TapIndexBuilder *tap_index_builder_new    (const gchar     *filename) G_GNUC_INTERNAL G_GNUC_MALLOC;
+gboolean         tap_index_builder_add    (TapIndexBuilder *builder,
+                                           const gchar     *pathname,
+                                           gsize            length,
+                                           guint64          size,
+                                           guint64          offset) G_GNUC_INTERNAL;
+void             tap_index_builder_finish (TapIndexBuilder *builder) G_GNUC_INTERNAL;
+void             tap_index_builder_free   (TapIndexBuilder *builder) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_INDEX_H__ */
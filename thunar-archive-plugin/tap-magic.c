@@ -0,0 +1,519 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sys/types.h>
+#ifdef HAVE_RWF_NOWAIT
+#include <sys/uio.h>
+#include <sys/vfs.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <thunar-archive-plugin/tap-magic.h>
+#include <thunar-archive-plugin/tap-trace.h>
+
+
+
+/* the number of bytes read from the start of a file */
+#define TAP_MAGIC_SIZE 512
+
+/* the cache is dropped once it grows beyond this many files */
+#define TAP_MAGIC_CACHE_MAX 4096
+
+/* the GVariant type of the cache file, (dev, inode, mtime, mime type) */
+#define TAP_MAGIC_CACHE_TYPE "a(ttxs)"
+
+
+
+typedef struct _TapMagicKey TapMagicKey;
+
+
+
+static guint        tap_magic_key_hash   (gconstpointer  key);
+static gboolean     tap_magic_key_equal  (gconstpointer  a,
+                                          gconstpointer  b);
+static void         tap_magic_key_free   (gpointer       data);
+static gchar       *tap_magic_cache_path (void) G_GNUC_MALLOC;
+static void         tap_magic_cache_load (void);
+static void         tap_magic_cache_add  (const TapMagicKey *key,
+                                          const gchar       *mime_type);
+static const gchar *tap_magic_classify   (const guchar  *data,
+                                          gsize          length);
+static gboolean     tap_magic_local      (gint           fd);
+static gssize       tap_magic_read       (const gchar   *path,
+                                          guchar        *buffer,
+                                          gboolean       nowait,
+                                          gboolean      *local);
+static void         tap_magic_thread     (GTask         *task,
+                                          gpointer       source_object,
+                                          gpointer       task_data,
+                                          GCancellable  *cancellable);
+static void         tap_magic_ready      (GObject       *object,
+                                          GAsyncResult  *result,
+                                          gpointer       user_data);
+
+
+
+struct _TapMagicKey
+{
+  guint64 dev;
+  guint64 ino;
+  gint64  mtime;
+
+  /* the file to probe, only set for pending probes */
+  gchar  *path;
+
+  /* whether the file is on a local filesystem, as found by the probe */
+  gboolean local;
+};
+
+
+
+/* the signatures of the archive formats, and the mime type they stand for */
+static const struct
+{
+  guint        offset;
+  guint        length;
+  const gchar  magic[8];
+  const gchar *mime_type;
+} TAP_MAGIC_SIGNATURES[] = {
+  {   0, 4, "PK\003\004",                 "application/zip" },
+  {   0, 4, "PK\005\006",                 "application/zip" },
+  {   0, 4, "PK\007\010",                 "application/zip" },
+  {   0, 6, "7z\274\257\047\034",         "application/x-7z-compressed" },
+  {   0, 7, "Rar!\032\007\000",           "application/x-rar" },
+  {   0, 8, "Rar!\032\007\001\000",       "application/x-rar" },
+  {   0, 6, "\3757zXZ\000",               "application/x-xz" },
+  {   0, 4, "\050\265\057\375",           "application/zstd" },
+  {   0, 2, "\037\213",                   "application/x-gzip" },
+  {   0, 4, "\004\042\115\030",           "application/x-lz4" },
+  { 257, 5, "ustar",                      "application/x-tar" },
+};
+
+/* maps TapMagicKey's to the interned mime type, or "" for no archive */
+static GHashTable *tap_magic_cache = NULL;
+static gboolean    tap_magic_cache_dirty = FALSE;
+
+/* the files being probed in the background */
+static GHashTable *tap_magic_pending = NULL;
+
+/* the devices a probe found to be local, the only ones opened on the main thread */
+static GHashTable *tap_magic_devices = NULL;
+
+
+
+static guint
+tap_magic_key_hash (gconstpointer key)
+{
+  const TapMagicKey *k = key;
+
+  return (guint) (k->ino ^ (k->ino >> 32) ^ k->dev ^ k->mtime);
+}
+
+
+
+static gboolean
+tap_magic_key_equal (gconstpointer a,
+                     gconstpointer b)
+{
+  const TapMagicKey *ka = a;
+  const TapMagicKey *kb = b;
+
+  return (ka->ino == kb->ino && ka->dev == kb->dev && ka->mtime == kb->mtime);
+}
+
+
+
+static void
+tap_magic_key_free (gpointer data)
+{
+  TapMagicKey *key = data;
+
+  g_free (key->path);
+  g_free (key);
+}
+
+
+
+static gchar*
+tap_magic_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "thunar-archive-plugin", "magic.cache", NULL);
+}
+
+
+
+static void
+tap_magic_cache_load (void)
+{
+  GVariantIter iter;
+  TapMagicKey  key;
+  const gchar *mime_type;
+  GVariant    *variant;
+  gchar       *contents;
+  gchar       *path;
+  gsize        length;
+
+  tap_magic_cache = g_hash_table_new_full (tap_magic_key_hash, tap_magic_key_equal, g_free, NULL);
+  tap_magic_pending = g_hash_table_new (tap_magic_key_hash, tap_magic_key_equal);
+  tap_magic_devices = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+
+  /* the results of earlier sessions */
+  path = tap_magic_cache_path ();
+  if (g_file_get_contents (path, &contents, &length, NULL))
+    {
+      variant = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (TAP_MAGIC_CACHE_TYPE),
+                                                            contents, length, FALSE, g_free, contents));
+      if (g_variant_is_normal_form (variant))
+        {
+          g_variant_iter_init (&iter, variant);
+          while (g_variant_iter_next (&iter, "(ttx&s)", &key.dev, &key.ino, &key.mtime, &mime_type))
+            tap_magic_cache_add (&key, mime_type);
+          tap_magic_cache_dirty = FALSE;
+        }
+      g_variant_unref (variant);
+    }
+  g_free (path);
+}
+
+
+
+static void
+tap_magic_cache_add (const TapMagicKey *key,
+                     const gchar       *mime_type)
+{
+  TapMagicKey *k;
+
+  /* start over instead of tracking the age of the entries */
+  if (G_UNLIKELY (g_hash_table_size (tap_magic_cache) >= TAP_MAGIC_CACHE_MAX))
+    g_hash_table_remove_all (tap_magic_cache);
+
+  k = g_new (TapMagicKey, 1);
+  k->dev = key->dev;
+  k->ino = key->ino;
+  k->mtime = key->mtime;
+  k->path = NULL;
+  k->local = FALSE;
+  g_hash_table_replace (tap_magic_cache, k, (gpointer) g_intern_string (mime_type));
+  tap_magic_cache_dirty = TRUE;
+}
+
+
+
+static const gchar*
+tap_magic_classify (const guchar *data,
+                    gsize         length)
+{
+  guint n;
+
+  for (n = 0; n < G_N_ELEMENTS (TAP_MAGIC_SIGNATURES); ++n)
+    if (TAP_MAGIC_SIGNATURES[n].offset + TAP_MAGIC_SIGNATURES[n].length <= length
+        && memcmp (data + TAP_MAGIC_SIGNATURES[n].offset, TAP_MAGIC_SIGNATURES[n].magic, TAP_MAGIC_SIGNATURES[n].length) == 0)
+      return TAP_MAGIC_SIGNATURES[n].mime_type;
+
+  /* "BZh" followed by the block size */
+  if (length >= 4 && memcmp (data, "BZh", 3) == 0 && data[3] >= '1' && data[3] <= '9')
+    return "application/x-bzip2";
+
+  return "";
+}
+
+
+
+static gboolean
+tap_magic_local (gint fd)
+{
+#ifdef HAVE_RWF_NOWAIT
+  struct statfs statfsb;
+
+  if (fstatfs (fd, &statfsb) < 0)
+    return FALSE;
+
+  /* even opening files on network and FUSE filesystems may hang */
+  switch ((guint32) statfsb.f_type)
+    {
+    case 0x6969:     /* NFS */
+    case 0x517b:     /* SMB */
+    case 0xff534d42: /* CIFS */
+    case 0xfe534d42: /* SMB2 */
+    case 0x65735546: /* FUSE */
+    case 0x01021997: /* 9P */
+    case 0x00c36400: /* Ceph */
+    case 0x5346414f: /* AFS */
+    case 0x73757245: /* Coda */
+      return FALSE;
+
+    default:
+      return TRUE;
+    }
+#else
+  return FALSE;
+#endif
+}
+
+
+
+static gssize
+tap_magic_read (const gchar *path,
+                guchar      *buffer,
+                gboolean     nowait,
+                gboolean    *local)
+{
+#ifdef HAVE_RWF_NOWAIT
+  struct iovec iov = { buffer, TAP_MAGIC_SIZE };
+#endif
+  gssize       n;
+  gint         fd;
+
+#ifndef HAVE_RWF_NOWAIT
+  /* there's no way to read without waiting for the disk */
+  if (nowait)
+    return -1;
+#endif
+
+  fd = g_open (path, O_RDONLY | O_CLOEXEC | O_NOCTTY, 0);
+  if (G_UNLIKELY (fd < 0))
+    return -1;
+
+#ifdef HAVE_RWF_NOWAIT
+  /* only take what is in the page cache already */
+  if (nowait)
+    {
+      do
+        n = preadv2 (fd, &iov, 1, 0, RWF_NOWAIT);
+      while (n < 0 && errno == EINTR);
+      close (fd);
+      return n;
+    }
+#endif
+
+  if (local != NULL)
+    *local = tap_magic_local (fd);
+
+  do
+    n = pread (fd, buffer, TAP_MAGIC_SIZE, 0);
+  while (n < 0 && errno == EINTR);
+  close (fd);
+
+  return n;
+}
+
+
+
+static void
+tap_magic_thread (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
+{
+  TapMagicKey *key = task_data;
+  guchar       buffer[TAP_MAGIC_SIZE];
+  gssize       n;
+
+  n = tap_magic_read (key->path, buffer, FALSE, &key->local);
+  g_task_return_pointer (task, (gpointer) ((n >= 0) ? tap_magic_classify (buffer, n) : ""), NULL);
+}
+
+
+
+static void
+tap_magic_ready (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  TapMagicKey *key = g_task_get_task_data (G_TASK (result));
+  const gchar *mime_type;
+  gint64      *dev;
+
+  mime_type = g_task_propagate_pointer (G_TASK (result), NULL);
+
+  /* the cache may be gone after a shutdown */
+  if (G_LIKELY (tap_magic_cache != NULL))
+    {
+      /* later files on this device may be read right away */
+      if (key->local && !g_hash_table_contains (tap_magic_devices, &key->dev))
+        {
+          dev = g_new (gint64, 1);
+          *dev = key->dev;
+          g_hash_table_add (tap_magic_devices, dev);
+        }
+
+      g_hash_table_remove (tap_magic_pending, key);
+      tap_magic_cache_add (key, mime_type);
+    }
+}
+
+
+
+/**
+ * tap_magic_shutdown:
+ *
+ * Saves the detection results for the next session, and releases
+ * the cache.
+ **/
+void
+tap_magic_shutdown (void)
+{
+  GVariantBuilder builder;
+  GHashTableIter  iter;
+  TapMagicKey    *key;
+  const gchar    *mime_type;
+  GVariant       *variant;
+  gchar          *dirname;
+  gchar          *path;
+
+  if (tap_magic_cache == NULL)
+    return;
+
+  if (tap_magic_cache_dirty)
+    {
+      g_variant_builder_init (&builder, G_VARIANT_TYPE (TAP_MAGIC_CACHE_TYPE));
+      g_hash_table_iter_init (&iter, tap_magic_cache);
+      while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &mime_type))
+        g_variant_builder_add (&builder, "(ttxs)", key->dev, key->ino, key->mtime, mime_type);
+      variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+      path = tap_magic_cache_path ();
+      dirname = g_path_get_dirname (path);
+      g_mkdir_with_parents (dirname, 0700);
+      g_file_set_contents (path, g_variant_get_data (variant), g_variant_get_size (variant), NULL);
+      g_variant_unref (variant);
+      g_free (dirname);
+      g_free (path);
+    }
+
+  g_hash_table_destroy (tap_magic_devices);
+  g_hash_table_destroy (tap_magic_pending);
+  g_hash_table_destroy (tap_magic_cache);
+  tap_magic_devices = NULL;
+  tap_magic_pending = NULL;
+  tap_magic_cache = NULL;
+  tap_magic_cache_dirty = FALSE;
+}
+
+
+
+/**
+ * tap_magic_lookup:
+ * @file_info : the #ThunarxFileInfo of a local file.
+ * @path      : the local path of the file.
+ * @mime_type : the mime type the file manager determined for it.
+ *
+ * Looks at the first bytes of regular files with an unknown or generic
+ * @mime_type, to recognize archives with a wrong or missing extension.
+ * The results are cached by device, inode and modification time, so
+ * only new or changed files are ever read.
+ *
+ * This function does not wait for the disk: if the start of the file
+ * is not in the page cache, it's read on a worker thread and the result
+ * is only available for the next lookup. Files are only opened here on
+ * devices an earlier probe found to be local, since opening a file on a
+ * network filesystem may block just as well, so the first file of every
+ * device, and all files on network and FUSE filesystems, are probed on
+ * the worker.
+ *
+ * Return value: the interned mime type of the archive, or %NULL.
+ **/
+const gchar*
+tap_magic_lookup (ThunarxFileInfo *file_info,
+                  const gchar     *path,
+                  const gchar     *mime_type)
+{
+  TapMagicKey  key;
+  TapMagicKey *pending;
+  const gchar *result;
+  GFileInfo   *info;
+  GTask       *task;
+  guchar       buffer[TAP_MAGIC_SIZE];
+  goffset      size;
+  gssize       n;
+
+  g_return_val_if_fail (THUNARX_IS_FILE_INFO (file_info), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (strcmp (mime_type, "application/octet-stream") != 0 && !g_content_type_is_unknown (mime_type))
+    return NULL;
+
+  TAP_TRACE_SCOPE ("magic");
+
+  /* the identity of the file, as last seen by the file manager */
+  info = thunarx_file_info_get_file_info (file_info);
+  if (G_UNLIKELY (info == NULL))
+    return NULL;
+  if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR
+      || !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE))
+    {
+      /* never open fifos or devices */
+      g_object_unref (G_OBJECT (info));
+      return NULL;
+    }
+  key.dev = g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE);
+  key.ino = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+  key.mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+            + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+  key.path = NULL;
+  key.local = FALSE;
+  size = g_file_info_get_size (info);
+  g_object_unref (G_OBJECT (info));
+
+  if (G_UNLIKELY (tap_magic_cache == NULL))
+    tap_magic_cache_load ();
+
+  result = g_hash_table_lookup (tap_magic_cache, &key);
+  if (result == NULL && !g_hash_table_contains (tap_magic_pending, &key))
+    {
+      n = -1;
+      if (g_hash_table_contains (tap_magic_devices, &key.dev))
+        n = tap_magic_read (path, buffer, TRUE, NULL);
+      if (n == TAP_MAGIC_SIZE || (n >= 0 && n == size))
+        {
+          /* the start of the file was cached already */
+          result = tap_magic_classify (buffer, n);
+          tap_magic_cache_add (&key, result);
+        }
+      else
+        {
+          /* read it in the background for the next time */
+          pending = g_new (TapMagicKey, 1);
+          *pending = key;
+          pending->path = g_strdup (path);
+          g_hash_table_add (tap_magic_pending, pending);
+
+          task = g_task_new (NULL, NULL, tap_magic_ready, NULL);
+          g_task_set_task_data (task, pending, tap_magic_key_free);
+          g_task_run_in_thread (task, tap_magic_thread);
+          g_object_unref (task);
+        }
+    }
+
+  return (result != NULL && *result != '\0') ? result : NULL;
+}
@@ -0,0 +1,36 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_MAGIC_H__
+#define __TAP_MAGIC_H__
+
+#include <thunarx/thunarx.h>
+
+G_BEGIN_DECLS;
+
+void         tap_magic_shutdown (void) G_GNUC_INTERNAL;
+
+const gchar *tap_magic_lookup   (ThunarxFileInfo *file_info,
+                                 const gchar     *path,
+                                 const gchar     *mime_type) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_MAGIC_H__ */
@@ -0,0 +1,645 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-create.h>
+#include <thunar-archive-plugin/tap-extract.h>
+#ifdef HAVE_HELPER
+#include <thunar-archive-plugin/tap-helper-client.h>
+#endif
+#include <thunar-archive-plugin/tap-native.h>
+#include <thunar-archive-plugin/tap-scheduler.h>
+
+
+
+typedef struct _TapNativeJob    TapNativeJob;
+typedef struct _TapNativeItem   TapNativeItem;
+typedef struct _TapNativeCreate TapNativeCreate;
+
+
+
+static void     tap_native_job_finish       (TapNativeJob     *job);
+static void     tap_native_item_free        (gpointer          data);
+static void     tap_native_error            (GtkWidget        *window,
+                                             const gchar      *message,
+                                             const GError     *error);
+#ifdef HAVE_HELPER
+static gboolean tap_native_item_remote      (TapNativeItem    *item,
+                                             guint             n_threads,
+                                             gboolean         *succeed);
+#endif
+static gint     tap_native_item_run         (guint             n_threads,
+                                             gpointer          user_data);
+static void     tap_native_item_done        (gint              status,
+                                             gpointer          user_data);
+static void     tap_native_format_changed   (GtkComboBox      *combo,
+                                             GtkSpinButton    *spin);
+static gint     tap_native_create_dialog    (const gchar      *folder,
+                                             TapSelection     *selection,
+                                             GtkWidget        *window,
+                                             gchar           **filename);
+static void     tap_native_create_free      (gpointer          data);
+static gint     tap_native_create_run       (guint             n_threads,
+                                             gpointer          user_data);
+static void     tap_native_create_done      (gint              status,
+                                             gpointer          user_data);
+
+
+
+struct _TapNativeJob
+{
+  TapSelection     *selection;
+  gchar            *folder;
+  GtkWidget        *window;
+  TapNativeFallback fallback;
+
+  /* the number of archives still being extracted */
+  guint             n_pending;
+
+  /* the first error, reported once all archives are done */
+  GError           *error;
+
+  /* the indices of the archives that are left to the fallback */
+  GArray           *unsupported;
+};
+
+struct _TapNativeItem
+{
+  TapNativeJob     *job;
+  guint             index;
+
+  /* the results, set on the worker thread */
+  gboolean          unsupported;
+  GError           *error;
+};
+
+struct _TapNativeCreate
+{
+  gchar            *filename;
+  gchar           **paths;
+  TapCreateFormat   format;
+  gint              level;
+  GtkWidget        *window;
+
+  /* the result, set on the worker thread */
+  GError           *error;
+};
+
+
+
+/* the formats libarchive handles well enough to replace a wrapper */
+static const gchar TAP_NATIVE_MIME_TYPES[][35] = {
+  "application/x-7z-compressed",
+  "application/x-bzip-compressed-tar",
+  "application/x-bzip2-compressed-tar",
+  "application/x-cd-image",
+  "application/x-compressed-tar",
+  "application/x-gtar",
+  "application/x-java-archive",
+  "application/x-jar",
+  "application/x-lz4-compressed-tar",
+  "application/x-lzip-compressed-tar",
+  "application/x-lzma-compressed-tar",
+  "application/x-tar",
+  "application/x-xz-compressed-tar",
+  "application/x-zip",
+  "application/x-zip-compressed",
+  "application/x-zstd-compressed-tar",
+  "application/zip",
+};
+
+static GHashTable *tap_native_mime_types = NULL;
+
+/* the format and level picked last time */
+static TapCreateFormat tap_native_create_format = TAP_CREATE_TAR_ZSTD;
+static gint            tap_native_create_level = -1;
+
+
+
+static void
+tap_native_job_finish (TapNativeJob *job)
+{
+  TapSelection *selection;
+  GError       *error = NULL;
+  GList        *files = NULL;
+  guint         n;
+
+  if (G_UNLIKELY (job->error != NULL))
+    tap_native_error (job->window, _("Failed to extract files"), job->error);
+
+  /* hand the remaining archives to the wrapper */
+  if (job->unsupported->len > 0)
+    {
+      for (n = job->unsupported->len; n > 0; --n)
+        files = g_list_prepend (files, job->selection->files[g_array_index (job->unsupported, guint, n - 1)]);
+      selection = tap_selection_new (files);
+      g_list_free (files);
+
+      if (!(*job->fallback) (job->folder, selection, job->window, &error) && error != NULL)
+        {
+          tap_native_error (job->window, _("Failed to extract files"), error);
+          g_error_free (error);
+        }
+
+      tap_selection_unref (selection);
+    }
+
+  tap_selection_unref (job->selection);
+  g_object_unref (G_OBJECT (job->window));
+  g_array_free (job->unsupported, TRUE);
+  g_clear_error (&job->error);
+  g_free (job->folder);
+  g_slice_free (TapNativeJob, job);
+}
+
+
+
+static void
+tap_native_item_free (gpointer data)
+{
+  TapNativeItem *item = data;
+
+  g_clear_error (&item->error);
+  g_slice_free (TapNativeItem, item);
+}
+
+
+
+static void
+tap_native_error (GtkWidget    *window,
+                  const gchar  *message,
+                  const GError *error)
+{
+  GtkWidget *dialog;
+
+  /* the job may finish after the window was closed */
+  dialog = gtk_message_dialog_new (gtk_widget_get_visible (window) ? GTK_WINDOW (window) : NULL,
+                                   GTK_DIALOG_DESTROY_WITH_PARENT,
+                                   GTK_MESSAGE_ERROR,
+                                   GTK_BUTTONS_CLOSE,
+                                   "%s.", message);
+  gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (dialog), "%s.", error->message);
+  g_signal_connect (G_OBJECT (dialog), "response", G_CALLBACK (gtk_widget_destroy), NULL);
+  gtk_widget_show (dialog);
+}
+
+
+
+#ifdef HAVE_HELPER
+static gboolean
+tap_native_item_remote (TapNativeItem *item,
+                        guint          n_threads,
+                        gboolean      *succeed)
+{
+  GSocketConnection *connection;
+  GVariantBuilder    builder;
+  TapNativeJob      *job = item->job;
+  const gchar       *message;
+  GVariant          *result;
+  GError            *error = NULL;
+
+  connection = tap_helper_connect ();
+  if (connection == NULL)
+    return FALSE;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "archive", g_variant_new_bytestring (job->selection->paths[item->index]));
+  g_variant_builder_add (&builder, "{sv}", "folder", g_variant_new_bytestring (job->folder));
+  g_variant_builder_add (&builder, "{sv}", "threads", g_variant_new_uint32 (n_threads));
+
+  result = tap_helper_call (connection, "extract", g_variant_builder_end (&builder), &error);
+  g_object_unref (connection);
+
+  if (G_UNLIKELY (result == NULL))
+    {
+      /* extract it here instead */
+      g_warning ("Failed to talk to the archive helper: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
+
+  *succeed = FALSE;
+  g_variant_lookup (result, "succeed", "b", succeed);
+  g_variant_lookup (result, "unsupported", "b", &item->unsupported);
+  if (g_variant_lookup (result, "error", "&s", &message))
+    g_set_error_literal (&item->error, G_IO_ERROR, G_IO_ERROR_FAILED, message);
+  g_variant_unref (result);
+
+  return TRUE;
+}
+#endif
+
+
+
+static gint
+tap_native_item_run (guint    n_threads,
+                     gpointer user_data)
+{
+  TapNativeItem *item = user_data;
+  TapNativeJob  *job = item->job;
+#ifdef HAVE_HELPER
+  gboolean       succeed;
+
+  /* the helper has libarchive and its codecs loaded already */
+  if (tap_native_item_remote (item, n_threads, &succeed))
+    return succeed ? 0 : 1;
+#endif
+
+  if (tap_extract_archive (job->selection->paths[item->index], job->folder, n_threads, NULL, NULL, &item->unsupported, &item->error))
+    return 0;
+
+  return 1;
+}
+
+
+
+static void
+tap_native_item_done (gint     status,
+                      gpointer user_data)
+{
+  TapNativeItem *item = user_data;
+  TapNativeJob  *job = item->job;
+
+  if (item->unsupported)
+    {
+      /* leave the archive to the wrapper */
+      g_array_append_val (job->unsupported, item->index);
+    }
+  else if (item->error != NULL && job->error == NULL)
+    {
+      /* report the first error, but continue with the other archives */
+      job->error = item->error;
+      item->error = NULL;
+    }
+
+  if (--job->n_pending == 0)
+    tap_native_job_finish (job);
+}
+
+
+
+static void
+tap_native_format_changed (GtkComboBox   *combo,
+                           GtkSpinButton *spin)
+{
+  const TapCreateFormatInfo *info;
+  TapCreateFormat            format;
+
+  /* every format has a range of levels of its own */
+  format = gtk_combo_box_get_active (combo);
+  info = tap_create_format_info (format);
+  gtk_spin_button_set_range (spin, info->min_level, info->max_level);
+  if (format == tap_native_create_format && tap_native_create_level >= 0)
+    gtk_spin_button_set_value (spin, tap_native_create_level);
+  else
+    gtk_spin_button_set_value (spin, info->default_level);
+}
+
+
+
+static gint
+tap_native_create_dialog (const gchar  *folder,
+                          TapSelection *selection,
+                          GtkWidget    *window,
+                          gchar       **filename)
+{
+  const TapCreateFormatInfo *info;
+  GtkWidget                 *dialog;
+  GtkWidget                 *grid;
+  GtkWidget                 *label;
+  GtkWidget                 *entry;
+  GtkWidget                 *combo;
+  GtkWidget                 *spin;
+  const gchar               *extension;
+  const gchar               *text;
+  gchar                     *stem;
+  gchar                     *name;
+  gchar                     *path;
+  gint                       response;
+  guint                      n;
+
+  dialog = gtk_dialog_new_with_buttons (_("Create Archive"),
+                                        GTK_WINDOW (window),
+                                        GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+                                        _("Use Archive _Manager"), GTK_RESPONSE_REJECT,
+                                        _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                        _("C_reate"), GTK_RESPONSE_OK,
+                                        NULL);
+  gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+  gtk_window_set_resizable (GTK_WINDOW (dialog), FALSE);
+
+  grid = gtk_grid_new ();
+  gtk_grid_set_column_spacing (GTK_GRID (grid), 12);
+  gtk_grid_set_row_spacing (GTK_GRID (grid), 6);
+  gtk_container_set_border_width (GTK_CONTAINER (grid), 6);
+  gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), grid, TRUE, TRUE, 0);
+  gtk_widget_show (grid);
+
+  /* the archive is named after the file, or the folder for multiple files */
+  label = gtk_label_new_with_mnemonic (_("_Name:"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_grid_attach (GTK_GRID (grid), label, 0, 0, 1, 1);
+  gtk_widget_show (label);
+
+  entry = gtk_entry_new ();
+  gtk_entry_set_activates_default (GTK_ENTRY (entry), TRUE);
+  gtk_widget_set_hexpand (entry, TRUE);
+  name = g_path_get_basename ((selection->n_files == 1) ? selection->paths[0] : folder);
+  gtk_entry_set_text (GTK_ENTRY (entry), name);
+  g_free (name);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), entry);
+  gtk_grid_attach (GTK_GRID (grid), entry, 1, 0, 1, 1);
+  gtk_widget_show (entry);
+
+  label = gtk_label_new_with_mnemonic (_("_Format:"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_grid_attach (GTK_GRID (grid), label, 0, 1, 1, 1);
+  gtk_widget_show (label);
+
+  combo = gtk_combo_box_text_new ();
+  for (n = 0; n < TAP_CREATE_N_FORMATS; ++n)
+    {
+      info = tap_create_format_info (n);
+      name = g_strdup_printf ("%s (%s)", _(info->name), info->extension);
+      gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (combo), name);
+      g_free (name);
+    }
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), combo);
+  gtk_grid_attach (GTK_GRID (grid), combo, 1, 1, 1, 1);
+  gtk_widget_show (combo);
+
+  label = gtk_label_new_with_mnemonic (_("Compression _level:"));
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_grid_attach (GTK_GRID (grid), label, 0, 2, 1, 1);
+  gtk_widget_show (label);
+
+  spin = gtk_spin_button_new_with_range (0, 19, 1);
+  gtk_spin_button_set_numeric (GTK_SPIN_BUTTON (spin), TRUE);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), spin);
+  gtk_grid_attach (GTK_GRID (grid), spin, 1, 2, 1, 1);
+  gtk_widget_show (spin);
+
+  g_signal_connect (G_OBJECT (combo), "changed", G_CALLBACK (tap_native_format_changed), spin);
+  gtk_combo_box_set_active (GTK_COMBO_BOX (combo), tap_native_create_format);
+
+  response = gtk_dialog_run (GTK_DIALOG (dialog));
+  if (response == GTK_RESPONSE_OK)
+    {
+      /* remember the choice for the next archive */
+      tap_native_create_format = gtk_combo_box_get_active (GTK_COMBO_BOX (combo));
+      tap_native_create_level = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (spin));
+
+      text = gtk_entry_get_text (GTK_ENTRY (entry));
+      stem = g_strdup ((*text != '\0') ? text : _("Archive"));
+      g_strdelimit (stem, G_DIR_SEPARATOR_S, '_');
+      extension = tap_create_format_info (tap_native_create_format)->extension;
+
+      /* append " (2)", " (3)", ... until the name is free */
+      name = g_strconcat (stem, extension, NULL);
+      path = g_build_filename (folder, name, NULL);
+      for (n = 2; g_file_test (path, G_FILE_TEST_EXISTS) || g_file_test (path, G_FILE_TEST_IS_SYMLINK); ++n)
+        {
+          g_free (path);
+          g_free (name);
+          name = g_strdup_printf ("%s (%u)%s", stem, n, extension);
+          path = g_build_filename (folder, name, NULL);
+        }
+      g_free (name);
+      g_free (stem);
+
+      *filename = path;
+    }
+
+  gtk_widget_destroy (dialog);
+
+  return response;
+}
+
+
+
+static void
+tap_native_create_free (gpointer data)
+{
+  TapNativeCreate *create = data;
+
+  g_object_unref (G_OBJECT (create->window));
+  g_clear_error (&create->error);
+  g_strfreev (create->paths);
+  g_free (create->filename);
+  g_slice_free (TapNativeCreate, create);
+}
+
+
+
+static gint
+tap_native_create_run (guint    n_threads,
+                       gpointer user_data)
+{
+  TapNativeCreate *create = user_data;
+
+  if (tap_create_archive (create->filename, (const gchar *const *) create->paths, g_strv_length (create->paths),
+                          create->format, create->level, n_threads, &create->error))
+    return 0;
+
+  return 1;
+}
+
+
+
+static void
+tap_native_create_done (gint     status,
+                        gpointer user_data)
+{
+  TapNativeCreate *create = user_data;
+
+  if (G_UNLIKELY (create->error != NULL))
+    tap_native_error (create->window, _("Failed to create archive"), create->error);
+}
+
+
+
+/**
+ * tap_native_supports:
+ * @selection : a #TapSelection.
+ *
+ * Checks whether the native engine can extract at least one of the
+ * archives in @selection, judging by their mime types.
+ *
+ * Return value: %TRUE if tap_native_extract_here() should be used.
+ **/
+gboolean
+tap_native_supports (TapSelection *selection)
+{
+  guint n;
+
+  g_return_val_if_fail (selection != NULL, FALSE);
+
+  if (G_UNLIKELY (tap_native_mime_types == NULL))
+    {
+      tap_native_mime_types = g_hash_table_new (g_direct_hash, g_direct_equal);
+      for (n = 0; n < G_N_ELEMENTS (TAP_NATIVE_MIME_TYPES); ++n)
+        g_hash_table_add (tap_native_mime_types, (gpointer) g_intern_static_string (TAP_NATIVE_MIME_TYPES[n]));
+    }
+
+  for (n = 0; n < selection->n_files; ++n)
+    if (g_hash_table_contains (tap_native_mime_types, selection->mime_types[n]))
+      return TRUE;
+
+  return FALSE;
+}
+
+
+
+/**
+ * tap_native_extract_here:
+ * @folder    : the path to the folder in which to extract the archives.
+ * @selection : the #TapSelection with the archives to extract.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @fallback  : the function to extract the archives the engine can't handle.
+ *
+ * Extracts the archives in @selection with libarchive, one job per archive
+ * on the scheduler, streaming the entries straight to the disk. Archives
+ * with a single root end up directly in @folder, others in a folder named
+ * after the archive. Archives the engine cannot read are passed to @fallback
+ * once all jobs finished, and errors are reported in a dialog.
+ **/
+void
+tap_native_extract_here (const gchar      *folder,
+                         TapSelection     *selection,
+                         GtkWidget        *window,
+                         TapNativeFallback fallback)
+{
+  TapNativeJob  *job;
+  TapNativeItem *item;
+  TapJob        *sched_job;
+  guint          n;
+
+  g_return_if_fail (g_path_is_absolute (folder));
+  g_return_if_fail (selection != NULL);
+  g_return_if_fail (GTK_IS_WINDOW (window));
+  g_return_if_fail (fallback != NULL);
+
+  /* tap_native_supports() sets up the table of supported mime types */
+  if (!tap_native_supports (selection))
+    return;
+
+  job = g_slice_new0 (TapNativeJob);
+  job->selection = tap_selection_ref (selection);
+  job->folder = g_strdup (folder);
+  job->window = g_object_ref (G_OBJECT (window));
+  job->fallback = fallback;
+  job->unsupported = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* decide on the main thread which archives the engine should try */
+  for (n = 0; n < selection->n_files; ++n)
+    if (g_hash_table_contains (tap_native_mime_types, selection->mime_types[n]))
+      job->n_pending += 1;
+    else
+      g_array_append_val (job->unsupported, n);
+
+  /* extract every archive in a job of its own, so the scheduler can run them concurrently */
+  for (n = 0; n < selection->n_files; ++n)
+    if (g_hash_table_contains (tap_native_mime_types, selection->mime_types[n]))
+      {
+        item = g_slice_new0 (TapNativeItem);
+        item->job = job;
+        item->index = n;
+
+        sched_job = tap_job_new_thread (folder, tap_native_item_run, tap_native_item_done, item, tap_native_item_free);
+        tap_job_add_input (sched_job, selection->paths[n]);
+        tap_job_set_info (sched_job, "extract-here", "libarchive", tap_selection_get_size (selection, n));
+
+        /* starting a thread cannot fail */
+        tap_scheduler_submit (sched_job, NULL);
+      }
+}
+
+
+
+/**
+ * tap_native_create:
+ * @folder    : the path to the folder in which to create the archive.
+ * @selection : the #TapSelection with the files to add to the archive.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @fallback  : the function to create the archive with the archive manager.
+ * @error     : return location for errors or %NULL.
+ *
+ * Asks the user for the name, format and compression level of a new
+ * archive in @folder, and creates it with libarchive in a job on the
+ * scheduler. The user may pick the archive manager instead, which
+ * hands the @selection to @fallback. Errors of the job are reported
+ * in a dialog.
+ *
+ * Note that %FALSE will also be returned when the user cancels this
+ * operation, but @error will not be set then.
+ *
+ * Return value: %TRUE if the archive creation was scheduled.
+ **/
+gboolean
+tap_native_create (const gchar      *folder,
+                   TapSelection     *selection,
+                   GtkWidget        *window,
+                   TapNativeFallback fallback,
+                   GError          **error)
+{
+  TapNativeCreate *create;
+  TapJob          *job;
+  guint64          size = 0;
+  gchar           *filename = NULL;
+  guint            n;
+
+  g_return_val_if_fail (g_path_is_absolute (folder), FALSE);
+  g_return_val_if_fail (selection != NULL && selection->n_files > 0, FALSE);
+  g_return_val_if_fail (GTK_IS_WINDOW (window), FALSE);
+  g_return_val_if_fail (fallback != NULL, FALSE);
+
+  switch (tap_native_create_dialog (folder, selection, window, &filename))
+    {
+    case GTK_RESPONSE_OK:
+      break;
+
+    case GTK_RESPONSE_REJECT:
+      return (*fallback) (folder, selection, window, error);
+
+    default:
+      return FALSE;
+    }
+
+  create = g_slice_new0 (TapNativeCreate);
+  create->filename = filename;
+  create->paths = g_new (gchar *, selection->n_files + 1);
+  for (n = 0; n < selection->n_files; ++n)
+    {
+      create->paths[n] = g_strdup (selection->paths[n]);
+      size += tap_selection_get_size (selection, n);
+    }
+  create->paths[n] = NULL;
+  create->format = tap_native_create_format;
+  create->level = tap_native_create_level;
+  create->window = g_object_ref (G_OBJECT (window));
+
+  job = tap_job_new_thread (folder, tap_native_create_run, tap_native_create_done, create, tap_native_create_free);
+  tap_job_add_input (job, selection->paths[0]);
+  tap_job_set_info (job, "create", "libarchive", size);
+
+  /* starting a thread cannot fail */
+  return tap_scheduler_submit (job, error);
+}
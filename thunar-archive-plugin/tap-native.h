@@ -0,0 +1,61 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_NATIVE_H__
+#define __TAP_NATIVE_H__
+
+#include <thunar-archive-plugin/tap-selection.h>
+
+G_BEGIN_DECLS;
+
+/**
+ * TapNativeFallback:
+ * @folder    : the folder in which to extract or create the archives.
+ * @selection : the files the native engine did not handle.
+ * @window    : a #GtkWindow, used to popup dialogs.
+ * @error     : return location for errors or %NULL.
+ *
+ * Passes the @selection to a wrapper script, for the archives the
+ * native engine was unable to read, or archives the user wanted to
+ * create with the archive manager.
+ *
+ * Return value: %TRUE if the wrapper was scheduled, %FALSE on error.
+ **/
+typedef gboolean (*TapNativeFallback) (const gchar  *folder,
+                                       TapSelection *selection,
+                                       GtkWidget    *window,
+                                       GError      **error);
+
+gboolean tap_native_supports     (TapSelection     *selection) G_GNUC_INTERNAL;
+
+void     tap_native_extract_here (const gchar      *folder,
+                                  TapSelection     *selection,
+                                  GtkWidget        *window,
+                                  TapNativeFallback fallback) G_GNUC_INTERNAL;
+
+gboolean tap_native_create       (const gchar      *folder,
+                                  TapSelection     *selection,
+                                  GtkWidget        *window,
+                                  TapNativeFallback fallback,
+                                  GError          **error) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_NATIVE_H__ */
@@ -0,0 +1,769 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-index.h>
+#include <thunar-archive-plugin/tap-peek.h>
+#include <thunar-archive-plugin/tap-trace.h>
+#include <thunar-archive-plugin/tap-zip.h>
+
+
+
+/* the number of entries to look at before giving up */
+#define TAP_PEEK_MAX_ENTRIES 2048
+
+/* the number of bytes libarchive may read from compressed archives */
+#define TAP_PEEK_MAX_BYTES (1024 * 1024)
+
+/* the read block size used for libarchive */
+#define TAP_PEEK_BLOCK_SIZE (16 * 1024)
+
+/* the largest long name or pax header read for tarballs */
+#define TAP_PEEK_MAX_HEADER (64 * 1024)
+
+/* the larger budgets of the walks that build the index of the archive */
+#define TAP_PEEK_INDEX_MAX_ENTRIES (64 * 1024)
+#define TAP_PEEK_INDEX_MAX_BYTES   (8 * 1024 * 1024)
+
+
+typedef struct _TapPeek TapPeek;
+
+
+
+static gboolean      tap_peek_read_at    (gint               fd,
+                                          gpointer           buffer,
+                                          gsize              length,
+                                          guint64            offset);
+static gboolean      tap_peek_add        (TapPeek           *peek,
+                                          const gchar       *pathname,
+                                          gsize              length,
+                                          guint64            size,
+                                          guint64            offset);
+static void          tap_peek_finish     (TapPeek           *peek);
+static gboolean      tap_peek_zip_entry  (const TapZipEntry *entry,
+                                          gpointer           user_data);
+static void          tap_peek_zip        (TapPeek           *peek,
+                                          gint               fd,
+                                          guint64            length);
+static guint64       tap_peek_octal      (const guchar      *field,
+                                          gsize              length);
+static const gchar  *tap_peek_pax_path   (const guchar      *data,
+                                          gsize              size,
+                                          gsize             *length);
+static void          tap_peek_tar        (TapPeek           *peek,
+                                          gint               fd,
+                                          guint64            length);
+#ifdef HAVE_LIBARCHIVE
+static la_ssize_t    tap_peek_read       (struct archive    *archive,
+                                          void              *client_data,
+                                          const void       **buffer);
+static la_int64_t    tap_peek_seek       (struct archive    *archive,
+                                          void              *client_data,
+                                          la_int64_t         offset,
+                                          int                whence);
+static void          tap_peek_libarchive (TapPeek           *peek,
+                                          const gchar       *filename);
+#endif
+static void          tap_peek_headers    (TapPeek           *peek,
+                                          const gchar       *filename);
+
+
+
+struct _TapPeek
+{
+  TapPeekResult    result;
+  gchar           *root;
+  guint            n_entries;
+
+  /* the index recorded on the way, or %NULL */
+  TapIndexBuilder *index;
+};
+
+#ifdef HAVE_LIBARCHIVE
+typedef struct
+{
+  gint    fd;
+  guint64 consumed;
+  guchar  buffer[TAP_PEEK_BLOCK_SIZE];
+} TapPeekReader;
+#endif
+
+
+
+static gboolean
+tap_peek_read_at (gint     fd,
+                  gpointer buffer,
+                  gsize    length,
+                  guint64  offset)
+{
+  gssize n;
+
+  for (; length > 0; length -= n, offset += n)
+    {
+      n = pread (fd, buffer, length, offset);
+      if (n < 0 && errno == EINTR)
+        {
+          n = 0;
+          continue;
+        }
+      if (n <= 0)
+        return FALSE;
+      buffer = (guchar *) buffer + n;
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_peek_add (TapPeek     *peek,
+              const gchar *pathname,
+              gsize        length,
+              guint64      size,
+              guint64      offset)
+{
+  tap_peek_entry (&peek->result, &peek->root, pathname, length);
+  peek->n_entries += 1;
+
+  /* walk through all headers for the index, unless the archive is too large */
+  if (peek->index != NULL)
+    {
+      if (tap_index_builder_add (peek->index, pathname, length, size, offset)
+          && peek->n_entries < TAP_PEEK_INDEX_MAX_ENTRIES)
+        return TRUE;
+
+      tap_index_builder_free (peek->index);
+      peek->index = NULL;
+    }
+
+  /* stop once the layout is decided */
+  if (peek->result == TAP_PEEK_MULTIPLE_ROOTS)
+    return FALSE;
+
+  /* don't walk through huge archives entry by entry */
+  return (peek->n_entries < TAP_PEEK_MAX_ENTRIES);
+}
+
+
+
+static void
+tap_peek_finish (TapPeek *peek)
+{
+  /* all entries were seen, and none had another root */
+  if (peek->result == TAP_PEEK_UNKNOWN && peek->root != NULL)
+    peek->result = TAP_PEEK_SINGLE_ROOT;
+
+  /* all entries were recorded, so write the index */
+  if (peek->index != NULL)
+    {
+      tap_index_builder_finish (peek->index);
+      peek->index = NULL;
+    }
+}
+
+
+
+static gboolean
+tap_peek_zip_entry (const TapZipEntry *entry,
+                    gpointer           user_data)
+{
+  return tap_peek_add (user_data, entry->name, entry->name_length, entry->size, entry->offset);
+}
+
+
+
+static void
+tap_peek_zip (TapPeek *peek,
+              gint     fd,
+              guint64  length)
+{
+  /* the central directory is all at the end of the archive */
+  if (tap_zip_foreach (fd, length, (peek->index != NULL) ? TAP_PEEK_INDEX_MAX_BYTES : TAP_PEEK_MAX_BYTES,
+                       tap_peek_zip_entry, peek, NULL))
+    tap_peek_finish (peek);
+}
+
+
+
+static guint64
+tap_peek_octal (const guchar *field,
+                gsize         length)
+{
+  guint64 value = 0;
+  gsize   n;
+
+  /* GNU tar stores sizes of 8 GiB and more in base-256 */
+  if ((field[0] & 0x80) != 0)
+    {
+      value = field[0] & 0x7f;
+      for (n = 1; n < length; ++n)
+        {
+          if (value > (G_MAXUINT64 >> 8))
+            return G_MAXUINT64;
+          value = (value << 8) | field[n];
+        }
+      return value;
+    }
+
+  for (n = 0; n < length && field[n] == ' '; ++n)
+    ;
+  for (; n < length && field[n] >= '0' && field[n] <= '7'; ++n)
+    value = (value << 3) | (field[n] - '0');
+
+  return value;
+}
+
+
+
+static const gchar*
+tap_peek_pax_path (const guchar *data,
+                   gsize         size,
+                   gsize        *length)
+{
+  const gchar *p = (const gchar *) data;
+  const gchar *end = p + size;
+  const gchar *record;
+  const gchar *key;
+  gsize        record_length;
+
+  /* pax records look like "<length> <key>=<value>\n" */
+  while (p < end)
+    {
+      record = p;
+      for (record_length = 0; p < end && g_ascii_isdigit (*p); ++p)
+        record_length = record_length * 10 + (*p - '0');
+      if (p >= end || *p != ' ' || record_length <= (gsize) (p - record) + 1 || record_length > (gsize) (end - record))
+        return NULL;
+
+      key = p + 1;
+      p = record + record_length;
+      if (p - key > 5 && strncmp (key, "path=", 5) == 0)
+        {
+          *length = p - key - 6;
+          return key + 5;
+        }
+    }
+
+  return NULL;
+}
+
+
+
+static void
+tap_peek_tar (TapPeek *peek,
+              gint     fd,
+              guint64  length)
+{
+  const gchar *path;
+  gboolean     more;
+  guchar       header[512];
+  guchar      *data;
+  guint64      offset;
+  guint64      size = 0;
+  gchar       *longname = NULL;
+  gchar       *name;
+  gsize        n;
+
+  /* only the headers are read, the data of the entries is skipped */
+  for (offset = 0; offset + 512 <= length; offset += 512 + ((size + 511) & ~(guint64) 511))
+    {
+      if (!tap_peek_read_at (fd, header, sizeof (header), offset))
+        break;
+
+      /* the end of the archive */
+      if (header[0] == '\0')
+        {
+          tap_peek_finish (peek);
+          break;
+        }
+
+      if (memcmp (header + 257, "ustar", 5) != 0)
+        break;
+
+      /* special files have no data, whatever their size says */
+      size = tap_peek_octal (header + 124, 12);
+      if (header[156] >= '2' && header[156] <= '6')
+        size = 0;
+      if (size > length - offset - 512)
+        break;
+
+      switch (header[156])
+        {
+        case 'L':
+        case 'x':
+          /* the GNU long name of the next entry, or the pax extended header that may override its path */
+          if (size > TAP_PEEK_MAX_HEADER)
+            goto done;
+          data = g_malloc (MAX (size, 1));
+          if (!tap_peek_read_at (fd, data, size, offset + 512))
+            {
+              g_free (data);
+              goto done;
+            }
+
+          if (header[156] == 'L')
+            {
+              g_free (longname);
+              longname = g_strndup ((const gchar *) data, size);
+            }
+          else if ((path = tap_peek_pax_path (data, size, &n)) != NULL)
+            {
+              g_free (longname);
+              longname = g_strndup (path, n);
+            }
+          g_free (data);
+          break;
+
+        case 'g':
+        case 'K':
+          /* pax global headers and GNU long link names */
+          break;
+
+        default:
+          if (longname != NULL)
+            {
+              name = longname;
+              longname = NULL;
+            }
+          else if (header[345] != '\0')
+            name = g_strdup_printf ("%.155s/%.100s", (const gchar *) header + 345, (const gchar *) header);
+          else
+            name = g_strndup ((const gchar *) header, 100);
+
+          more = tap_peek_add (peek, name, strlen (name), size, offset);
+          g_free (name);
+
+          if (!more)
+            goto done;
+          break;
+        }
+    }
+
+done:
+  g_free (longname);
+}
+
+
+
+#ifdef HAVE_LIBARCHIVE
+static la_ssize_t
+tap_peek_read (struct archive *archive,
+               void           *client_data,
+               const void    **buffer)
+{
+  TapPeekReader *reader = client_data;
+  gssize         n;
+
+  /* decompressing a huge first entry to reach the next header is not worth it */
+  if (reader->consumed >= TAP_PEEK_MAX_BYTES)
+    {
+      archive_set_error (archive, EFBIG, "Out of budget");
+      return -1;
+    }
+
+  do
+    n = read (reader->fd, reader->buffer, sizeof (reader->buffer));
+  while (n < 0 && errno == EINTR);
+
+  if (G_UNLIKELY (n < 0))
+    {
+      archive_set_error (archive, errno, "%s", g_strerror (errno));
+      return -1;
+    }
+
+  reader->consumed += n;
+  *buffer = reader->buffer;
+
+  return n;
+}
+
+
+
+static la_int64_t
+tap_peek_seek (struct archive *archive,
+               void           *client_data,
+               la_int64_t      offset,
+               int             whence)
+{
+  TapPeekReader *reader = client_data;
+
+  /* formats like 7z keep their headers at the end */
+  return lseek (reader->fd, offset, whence);
+}
+
+
+
+static void
+tap_peek_libarchive (TapPeek     *peek,
+                     const gchar *filename)
+{
+  struct archive_entry *entry;
+  struct archive       *archive;
+  TapPeekReader        *reader;
+  const gchar          *pathname;
+  la_int64_t            size;
+  gint                  r;
+
+  reader = g_new (TapPeekReader, 1);
+  reader->consumed = 0;
+  reader->fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (G_UNLIKELY (reader->fd < 0))
+    {
+      g_free (reader);
+      return;
+    }
+
+  archive = archive_read_new ();
+  archive_read_support_filter_all (archive);
+  archive_read_support_format_all (archive);
+  archive_read_set_read_callback (archive, tap_peek_read);
+  archive_read_set_seek_callback (archive, tap_peek_seek);
+  archive_read_set_callback_data (archive, reader);
+
+  if (archive_read_open1 (archive) == ARCHIVE_OK)
+    {
+      /* libarchive skips the data of the entries by reading through it */
+      while ((r = archive_read_next_header (archive, &entry)) >= ARCHIVE_WARN && r != ARCHIVE_EOF)
+        {
+          pathname = archive_entry_pathname (entry);
+          size = archive_entry_size (entry);
+          if (pathname != NULL && !tap_peek_add (peek, pathname, strlen (pathname), MAX (size, 0),
+                                                 archive_read_header_position (archive)))
+            break;
+        }
+
+      if (r == ARCHIVE_EOF)
+        tap_peek_finish (peek);
+    }
+
+  archive_read_free (archive);
+  close (reader->fd);
+  g_free (reader);
+}
+#endif
+
+
+
+static void
+tap_peek_headers (TapPeek     *peek,
+                  const gchar *filename)
+{
+  struct stat statb;
+  gboolean    known = FALSE;
+  guchar      header[512];
+  gint        fd;
+
+  /* the headers are read with pread(), a mapping would take the process down
+   * with a SIGBUS once the archive is truncated, or its media go away */
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (G_LIKELY (fd >= 0))
+    {
+      /* don't read ahead of the headers */
+      posix_fadvise (fd, 0, 0, POSIX_FADV_RANDOM);
+
+      if (fstat (fd, &statb) == 0 && statb.st_size >= 4
+          && tap_peek_read_at (fd, header, MIN ((guint64) statb.st_size, sizeof (header)), 0))
+        {
+          if (header[0] == 'P' && header[1] == 'K')
+            {
+              tap_peek_zip (peek, fd, statb.st_size);
+              known = TRUE;
+            }
+          else if (statb.st_size >= 512 && memcmp (header + 257, "ustar", 5) == 0)
+            {
+              tap_peek_tar (peek, fd, statb.st_size);
+              known = TRUE;
+            }
+        }
+
+      close (fd);
+    }
+
+#ifdef HAVE_LIBARCHIVE
+  if (!known)
+    tap_peek_libarchive (peek, filename);
+#else
+  (void) known;
+#endif
+}
+
+
+
+/**
+ * tap_peek_archive:
+ * @filename : the path to the archive.
+ * @root     : return location for the name of the single root, or %NULL.
+ *
+ * Finds out whether the archive @filename has a single root. The answer
+ * is taken from the index of the archive if there is an up to date one,
+ * and otherwise from just its headers: the central directory of zip
+ * archives, the headers of uncompressed tarballs, so the data in between
+ * is never read, and other formats with libarchive, up to a small budget
+ * of input bytes.
+ *
+ * The headers are walked to the end on the way, so the index of the
+ * archive is built as well, see tap_index_builder_new(). The walk is
+ * bounded to some ten thousand entries and a few megabytes of headers
+ * though, and archives beyond that are not indexed, and only looked at
+ * until their layout is decided, or for a few thousand entries.
+ *
+ * This function blocks, and may be called from any thread.
+ *
+ * Return value: the #TapPeekResult.
+ **/
+TapPeekResult
+tap_peek_archive (const gchar *filename,
+                  gchar      **root)
+{
+  TapPeekResult result;
+  const gchar  *name;
+  TapIndex     *index;
+  TapPeek       peek = { TAP_PEEK_UNKNOWN, NULL, 0, NULL };
+
+  g_return_val_if_fail (filename != NULL, TAP_PEEK_UNKNOWN);
+
+  TAP_TRACE_SCOPE ("peek");
+
+  /* archives that were indexed before need no I/O beyond the index */
+  index = tap_index_lookup (filename);
+  if (index != NULL)
+    {
+      result = tap_index_get_layout (index, &name);
+      if (root != NULL)
+        *root = (result == TAP_PEEK_SINGLE_ROOT) ? g_strdup (name) : NULL;
+      tap_index_free (index);
+      return result;
+    }
+
+  peek.index = tap_index_builder_new (filename);
+  tap_peek_headers (&peek, filename);
+  if (peek.index != NULL)
+    tap_index_builder_free (peek.index);
+
+  if (root != NULL)
+    *root = (peek.result == TAP_PEEK_SINGLE_ROOT) ? g_steal_pointer (&peek.root) : NULL;
+  g_free (peek.root);
+
+  return peek.result;
+}
+
+
+
+/**
+ * tap_peek_check_space:
+ * @filename : the path to the archive.
+ * @folder   : the folder in which the archive is extracted.
+ * @error    : return location for errors or %NULL.
+ *
+ * Checks from the index of the archive @filename whether its entries fit
+ * into the free space of the file system of @folder, with every file
+ * rounded up to whole blocks, and with an inode for every entry. Archives
+ * without an up to date index always pass, see tap_peek_archive().
+ *
+ * This function blocks, and may be called from any thread.
+ *
+ * Return value: %FALSE if the archive does not fit into @folder.
+ **/
+gboolean
+tap_peek_check_space (const gchar *filename,
+                      const gchar *folder,
+                      GError     **error)
+{
+  struct statvfs statvfsb;
+  TapIndex      *index;
+  gboolean       fits = TRUE;
+  guint64        n_entries;
+  guint64        available;
+  guint64        usage = 0;
+  guint64        block;
+  guint64        size;
+  guint64        n;
+  gchar         *display_name;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (folder != NULL, FALSE);
+
+  index = tap_index_lookup (filename);
+  if (index == NULL)
+    return TRUE;
+
+  if (statvfs (folder, &statvfsb) == 0 && statvfsb.f_frsize > 0)
+    {
+      block = statvfsb.f_frsize;
+      available = (guint64) statvfsb.f_bavail * block;
+      n_entries = tap_index_get_n_entries (index);
+
+      /* file systems that allocate inodes on-demand report none */
+      if (statvfsb.f_files > 0 && n_entries > statvfsb.f_favail)
+        {
+          fits = FALSE;
+        }
+      else if (tap_index_get_total_size (index) + n_entries * block > available)
+        {
+          /* only sum up the blocks of the entries if the archive may not fit */
+          for (n = 0; n < n_entries && usage <= available; ++n)
+            {
+              if (G_UNLIKELY (tap_index_get_entry (index, n, &size, NULL) == NULL))
+                {
+                  usage = 0;
+                  break;
+                }
+              usage += (size + block - 1) / block * block;
+            }
+          fits = (usage <= available);
+        }
+    }
+
+  tap_index_free (index);
+
+  if (G_UNLIKELY (!fits))
+    {
+      display_name = g_filename_display_basename (filename);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, _("Failed to extract \"%s\": %s"),
+                   display_name, g_strerror (ENOSPC));
+      g_free (display_name);
+    }
+
+  return fits;
+}
+
+
+
+/**
+ * tap_peek_entry:
+ * @result   : the layout of the entries so far, initially %TAP_PEEK_UNKNOWN.
+ * @root     : the root of the entries so far, initially %NULL.
+ * @pathname : the path of the next entry, as stored in the archive.
+ * @length   : the length of @pathname, which need not be nul-terminated.
+ *
+ * Updates the layout of an archive with its next entry, for walks through
+ * archives other than tap_peek_archive(), like extractions. Once all
+ * entries were seen, an archive whose @result is still %TAP_PEEK_UNKNOWN
+ * has a single root if @root is set.
+ **/
+void
+tap_peek_entry (TapPeekResult *result,
+                gchar        **root,
+                const gchar   *pathname,
+                gsize          length)
+{
+  const gchar *end = pathname + length;
+  const gchar *slash;
+
+  /* strip leading slashes and "./" components */
+  for (;;)
+    {
+      if (pathname < end && *pathname == '/')
+        pathname += 1;
+      else if (end - pathname >= 2 && pathname[0] == '.' && pathname[1] == '/')
+        pathname += 2;
+      else
+        break;
+    }
+
+  /* the first component is the root of the entry */
+  slash = memchr (pathname, '/', end - pathname);
+  if (slash != NULL)
+    end = slash;
+
+  /* the "." entry of some tarballs */
+  if (end == pathname || (end - pathname == 1 && pathname[0] == '.'))
+    return;
+
+  if (G_UNLIKELY (end - pathname == 2 && pathname[0] == '.' && pathname[1] == '.'))
+    {
+      /* better keep entries that try to escape in a subfolder */
+      *result = TAP_PEEK_MULTIPLE_ROOTS;
+    }
+  else if (*root == NULL)
+    {
+      *root = g_strndup (pathname, end - pathname);
+    }
+  else if (strlen (*root) != (gsize) (end - pathname) || memcmp (*root, pathname, end - pathname) != 0)
+    {
+      *result = TAP_PEEK_MULTIPLE_ROOTS;
+    }
+}
+
+
+
+/**
+ * tap_peek_subfolder:
+ * @folder   : the folder in which the archive is extracted.
+ * @filename : the path to the archive.
+ *
+ * Determines the path of a folder in @folder named after the archive,
+ * without extensions like ".tar.gz", that does not exist yet.
+ *
+ * Return value: the path of the subfolder, to be freed with g_free().
+ **/
+gchar*
+tap_peek_subfolder (const gchar *folder,
+                    const gchar *filename)
+{
+  gchar *stem;
+  gchar *path;
+  gchar *dot;
+  gchar *s;
+  guint  n;
+
+  stem = g_path_get_basename (filename);
+  dot = g_strrstr (stem, ".tar.");
+  if (dot == NULL)
+    dot = strrchr (stem, '.');
+  if (dot != NULL && dot != stem)
+    *dot = '\0';
+
+  /* append " (2)", " (3)", ... until the name is free */
+  path = g_build_filename (folder, stem, NULL);
+  for (n = 2; g_file_test (path, G_FILE_TEST_EXISTS) || g_file_test (path, G_FILE_TEST_IS_SYMLINK); ++n)
+    {
+      g_free (path);
+      s = g_strdup_printf ("%s (%u)", stem, n);
+      path = g_build_filename (folder, s, NULL);
+      g_free (s);
+    }
+
+  g_free (stem);
+
+  return path;
+}
@@ -0,0 +1,61 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_PEEK_H__
+#define __TAP_PEEK_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+/**
+ * TapPeekResult:
+ * @TAP_PEEK_UNKNOWN        : the headers could not be read within the
+ *                            budget, or the format is not known.
+ * @TAP_PEEK_SINGLE_ROOT    : all entries are below a single top-level
+ *                            file or folder.
+ * @TAP_PEEK_MULTIPLE_ROOTS : the archive has several top-level entries.
+ *
+ * What tap_peek_archive() found out about the layout of an archive.
+ **/
+typedef enum
+{
+  TAP_PEEK_UNKNOWN,
+  TAP_PEEK_SINGLE_ROOT,
+  TAP_PEEK_MULTIPLE_ROOTS,
+} TapPeekResult;
+
+TapPeekResult tap_peek_archive     (const gchar   *filename,
+                                    gchar        **root) G_GNUC_INTERNAL;
+gboolean      tap_peek_check_space (const gchar   *filename,
+                                    const gchar   *folder,
+                                    GError       **error) G_GNUC_INTERNAL;
+
+void          tap_peek_entry       (TapPeekResult *result,
+                                    gchar        **root,
+                                    const gchar   *pathname,
+                                    gsize          length) G_GNUC_INTERNAL;
+
+gchar        *tap_peek_subfolder   (const gchar   *folder,
+                                    const gchar   *filename) G_GNUC_INTERNAL G_GNUC_MALLOC;
+
+G_END_DECLS;
+
+#endif /* !__TAP_PEEK_H__ */
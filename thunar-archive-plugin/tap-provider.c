@@ -26,7 +26,10 @@
 #include <libxfce4util/libxfce4util.h>
 
 #include <thunar-archive-plugin/tap-backend.h>
+#include <thunar-archive-plugin/tap-magic.h>
 #include <thunar-archive-plugin/tap-provider.h>
+#include <thunar-archive-plugin/tap-selection.h>
+#include <thunar-archive-plugin/tap-trace.h>
 
 /* use g_access() on win32 */
 #if defined(G_OS_WIN32)
@@ -47,17 +50,14 @@ static GList *tap_provider_get_dnd_menu_items   (ThunarxMenuProvider      *menu_
                                                  ThunarxFileInfo          *folder,
                                                  GList                    *files);
 static void   tap_provider_execute              (TapProvider              *tap_provider,
-                                                 GPid                    (*action) (const gchar *folder,
-                                                                                    GList       *files,
-                                                                                    GtkWidget   *window,
-                                                                                    GError     **error),
+                                                 gboolean                (*action) (const gchar  *folder,
+                                                                                    TapSelection *selection,
+                                                                                    GtkWidget    *window,
+                                                                                    GError      **error),
                                                  GtkWidget                *window,
                                                  const gchar              *folder,
-                                                 GList                    *files,
+                                                 TapSelection             *selection,
                                                  const gchar              *error_message);
-static void   tap_provider_child_watch          (GPid                      pid,
-                                                 gint                      status,
-                                                 gpointer                  user_data);
 
 
 
@@ -125,7 +125,10 @@ static const gchar TAP_MIME_TYPES[][35] = {
   "multipart/x-zip",
 };
 
-static GQuark tap_item_files_quark;
+/* maps interned mime types to whether they are (subclasses of) supported archives */
+static GHashTable *tap_archive_types;
+
+static GQuark tap_item_selection_quark;
 static GQuark tap_item_folder_quark;
 static GQuark tap_item_provider_quark;
 
@@ -142,12 +145,18 @@ static void
 tap_provider_class_init (TapProviderClass *klass)
 {
   GObjectClass *gobject_class;
+  guint         n;
 
-  /* determine the "tap-item-files", "tap-item-folder" and "tap-item-provider" quarks */
-  tap_item_files_quark = g_quark_from_string ("tap-item-files");
+  /* determine the "tap-item-selection", "tap-item-folder" and "tap-item-provider" quarks */
+  tap_item_selection_quark = g_quark_from_string ("tap-item-selection");
   tap_item_folder_quark = g_quark_from_string ("tap-item-folder");
   tap_item_provider_quark = g_quark_from_string ("tap-item-provider");
 
+  /* setup the archive classifier with the supported mime types */
+  tap_archive_types = g_hash_table_new (g_direct_hash, g_direct_equal);
+  for (n = 0; n < G_N_ELEMENTS (TAP_MIME_TYPES); ++n)
+    g_hash_table_insert (tap_archive_types, (gpointer) g_intern_static_string (TAP_MIME_TYPES[n]), GINT_TO_POINTER (TRUE));
+
   gobject_class = G_OBJECT_CLASS (klass);
   gobject_class->finalize = tap_provider_finalize;
 }
@@ -179,45 +188,82 @@ tap_provider_finalize (GObject *object)
 
 
 static gboolean
-tap_is_archive (ThunarxFileInfo *file_info)
+tap_is_archive_type (const gchar *mime_type)
 {
-  guint n;
+  gpointer result;
+  guint    n;
+
+  TAP_TRACE_SCOPE ("is-archive");
 
+  /* check if we already know about this (interned) mime type */
+  if (g_hash_table_lookup_extended (tap_archive_types, mime_type, NULL, &result))
+    return GPOINTER_TO_INT (result);
+
+  /* resolve the subclasses once per mime type */
   for (n = 0; n < G_N_ELEMENTS (TAP_MIME_TYPES); ++n)
-    if (thunarx_file_info_has_mime_type (file_info, TAP_MIME_TYPES[n]))
-      return TRUE;
+    if (g_content_type_is_a (mime_type, TAP_MIME_TYPES[n]))
+      break;
+
+  g_hash_table_insert (tap_archive_types, (gpointer) mime_type, GINT_TO_POINTER (n < G_N_ELEMENTS (TAP_MIME_TYPES)));
 
-  return FALSE;
+  return (n < G_N_ELEMENTS (TAP_MIME_TYPES));
 }
 
 
 
 static gboolean
-tap_is_parent_writable (ThunarxFileInfo *file_info)
+tap_is_archive (TapSelection *selection,
+                guint         n)
 {
-  gboolean result = FALSE;
-  gchar   *filename;
-  gchar   *uri;
+  const gchar *mime_type;
 
-  /* determine the parent URI for the file info */
-  uri = thunarx_file_info_get_parent_uri (file_info);
-  if (G_LIKELY (uri != NULL))
-    {
-      /* determine the local filename for the URI */
-      filename = g_filename_from_uri (uri, NULL, NULL);
-      if (G_LIKELY (filename != NULL))
-        {
-          /* check if we can write to that folder */
-          result = (g_access (filename, W_OK) == 0);
+  if (tap_is_archive_type (selection->mime_types[n]))
+    return TRUE;
 
-          /* release the filename */
-          g_free (filename);
-        }
+  /* archives with a wrong or missing extension, judged by their first bytes, but
+   * only if the file is selected alone, so menus of huge selections never touch
+   * the disk on the main thread, even for files whose start is in the page cache */
+  if (selection->n_files != 1)
+    return FALSE;
 
-      /* release the URI */
-      g_free (uri);
+  mime_type = tap_magic_lookup (selection->files[n], selection->paths[n], selection->mime_types[n]);
+  if (G_LIKELY (mime_type == NULL))
+    return FALSE;
+
+  /* let the backend resolve the archive manager for the real type */
+  selection->mime_types[n] = mime_type;
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_is_parent_writable (const gchar *path,
+                        GHashTable  *parents)
+{
+  gboolean result;
+  gpointer cached;
+  gchar   *dirname;
+
+  TAP_TRACE_SCOPE ("is-parent-writable");
+
+  /* determine the parent folder of the local file */
+  dirname = g_path_get_dirname (path);
+
+  /* check every distinct parent folder only once */
+  if (g_hash_table_lookup_extended (parents, dirname, NULL, &cached))
+    {
+      g_free (dirname);
+      return GPOINTER_TO_INT (cached);
     }
 
+  /* check if we can write to that folder */
+  result = (g_access (dirname, W_OK) == 0);
+
+  /* remember the result, the table takes the dirname */
+  g_hash_table_insert (parents, dirname, GINT_TO_POINTER (result));
+
   return result;
 }
 
@@ -229,13 +275,13 @@ tap_extract_here (ThunarxMenuItem *item,
 {
   ThunarxFileInfo *folder;
   TapProvider     *tap_provider;
-  GList           *files;
+  TapSelection    *selection;
   gchar           *dirname;
   gchar           *uri;
 
   /* determine the files associated with the item */
-  files = g_object_get_qdata (G_OBJECT (item), tap_item_files_quark);
-  if (G_UNLIKELY (files == NULL))
+  selection = g_object_get_qdata (G_OBJECT (item), tap_item_selection_quark);
+  if (G_UNLIKELY (selection == NULL))
     return;
 
   /* determine the provider associated with the item */
@@ -247,33 +293,25 @@ tap_extract_here (ThunarxMenuItem *item,
   folder = g_object_get_qdata (G_OBJECT (item), tap_item_folder_quark);
   if (G_UNLIKELY (folder != NULL))
     {
-      /* determine the URI of the supplied folder */
+      /* determine the local path of the supplied folder */
       uri = thunarx_file_info_get_uri (folder);
+      dirname = g_filename_from_uri (uri, NULL, NULL);
+      g_free (uri);
     }
   else
     {
-      /* determine the parent URI of the first selected file */
-      uri = thunarx_file_info_get_parent_uri (files->data);
+      /* determine the directory of the first selected file */
+      dirname = g_path_get_dirname (selection->paths[0]);
     }
 
-  /* verify that we have an URI */
-  if (G_LIKELY (uri != NULL))
+  /* verify that we were able to determine a local path */
+  if (G_LIKELY (dirname != NULL))
     {
-      /* determine the directory of the first selected file */
-      dirname = g_filename_from_uri (uri, NULL, NULL);
+      /* execute the action associated with the menu item */
+      tap_provider_execute (tap_provider, tap_backend_extract_here, window, dirname, selection, _("Failed to extract files"));
 
-      /* verify that we were able to determine a local path */
-      if (G_LIKELY (dirname != NULL))
-        {
-          /* execute the action associated with the menu item */
-          tap_provider_execute (tap_provider, tap_backend_extract_here, window, dirname, files, _("Failed to extract files"));
-
-          /* release the dirname */
-          g_free (dirname);
-        }
-
-      /* release the URI */
-      g_free (uri);
+      /* release the dirname */
+      g_free (dirname);
     }
 }
 
@@ -284,13 +322,12 @@ tap_extract_to (ThunarxMenuItem *item,
                 GtkWidget       *window)
 {
   TapProvider     *tap_provider;
-  GList           *files;
+  TapSelection    *selection;
   gchar           *dirname;
-  gchar           *uri;
 
   /* determine the files associated with the item */
-  files = g_object_get_qdata (G_OBJECT (item), tap_item_files_quark);
-  if (G_UNLIKELY (files == NULL))
+  selection = g_object_get_qdata (G_OBJECT (item), tap_item_selection_quark);
+  if (G_UNLIKELY (selection == NULL))
     return;
 
   /* determine the provider associated with the item */
@@ -301,28 +338,11 @@ tap_extract_to (ThunarxMenuItem *item,
       return;
     }
 
-
-  /* determine the parent URI of the first selected file */
-  uri = thunarx_file_info_get_parent_uri (files->data);
-  if (G_UNLIKELY (uri == NULL))
-    {
-      g_warning ("Failed to get parent URI");
-      return;
-    }
-
   /* determine the directory of the first selected file */
-  dirname = g_filename_from_uri (uri, NULL, NULL);
-  g_free (uri);
-
-  /* verify that we were able to determine a local path */
-  if (G_UNLIKELY (dirname == NULL))
-    {
-      g_warning ("Failed to determine local path");
-      return;
-    }
+  dirname = g_path_get_dirname (selection->paths[0]);
 
   /* execute the action */
-  tap_provider_execute (tap_provider, tap_backend_extract_to, window, dirname, files, _("Failed to extract files"));
+  tap_provider_execute (tap_provider, tap_backend_extract_to, window, dirname, selection, _("Failed to extract files"));
 
   /* cleanup */
   g_free (dirname);
@@ -334,14 +354,13 @@ static void
 tap_create_archive (ThunarxMenuItem *item,
                     GtkWidget       *window)
 {
-  TapProvider *tap_provider;
-  GList       *files;
-  gchar       *dirname;
-  gchar       *uri;
+  TapProvider  *tap_provider;
+  TapSelection *selection;
+  gchar        *dirname;
 
   /* determine the files associated with the item */
-  files = g_object_get_qdata (G_OBJECT (item), tap_item_files_quark);
-  if (G_UNLIKELY (files == NULL))
+  selection = g_object_get_qdata (G_OBJECT (item), tap_item_selection_quark);
+  if (G_UNLIKELY (selection == NULL))
     return;
 
   /* determine the provider associated with the item */
@@ -349,25 +368,47 @@ tap_create_archive (ThunarxMenuItem *item,
   if (G_UNLIKELY (tap_provider == NULL))
     return;
 
-  /* determine the parent URI of the first selected file */
-  uri = thunarx_file_info_get_parent_uri (files->data);
-  if (G_UNLIKELY (uri == NULL))
-    return;
-
   /* determine the directory of the first selected file */
-  dirname = g_filename_from_uri (uri, NULL, NULL);
-  g_free (uri);
+  dirname = g_path_get_dirname (selection->paths[0]);
 
-  /* verify that we were able to determine a local path */
-  if (G_UNLIKELY (dirname == NULL))
+  /* execute the action associated with the menu item */
+  tap_provider_execute (tap_provider, tap_backend_create_archive, window, dirname, selection, _("Failed to create archive"));
+
+  /* cleanup */
+  g_free (dirname);
+}
+
+
+
+#ifdef HAVE_LIBARCHIVE
+static void
+tap_compress (ThunarxMenuItem *item,
+              GtkWidget       *window)
+{
+  TapProvider  *tap_provider;
+  TapSelection *selection;
+  gchar        *dirname;
+
+  /* determine the files associated with the item */
+  selection = g_object_get_qdata (G_OBJECT (item), tap_item_selection_quark);
+  if (G_UNLIKELY (selection == NULL))
     return;
 
-  /* execute the action associated with the menu item */
-  tap_provider_execute (tap_provider, tap_backend_create_archive, window, dirname, files, _("Failed to create archive"));
+  /* determine the provider associated with the item */
+  tap_provider = g_object_get_qdata (G_OBJECT (item), tap_item_provider_quark);
+  if (G_UNLIKELY (tap_provider == NULL))
+    return;
+
+  /* determine the directory of the first selected file */
+  dirname = g_path_get_dirname (selection->paths[0]);
+
+  /* create the archive without the archive manager */
+  tap_provider_execute (tap_provider, tap_backend_compress, window, dirname, selection, _("Failed to create archive"));
 
   /* cleanup */
   g_free (dirname);
 }
+#endif
 
 
 
@@ -376,39 +417,46 @@ tap_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
                                   GtkWidget           *window,
                                   GList               *files)
 {
-  gchar              *scheme;
   TapProvider        *tap_provider = TAP_PROVIDER (menu_provider);
   ThunarxMenuItem    *item;
+  TapSelection       *selection;
+  GHashTable         *parents;
   GClosure           *closure;
   gboolean            all_archives = TRUE;
   gboolean            can_write = TRUE;
   GList              *items = NULL;
-  GList              *lp;
-  gint                n_files = 0;
+  guint               n;
+
+  TAP_TRACE_SCOPE ("menu");
+
+  /* take a snapshot of the selection, shared by all items */
+  selection = tap_selection_new (files);
+
+  /* selections usually share a few parent folders, so check each of them only once */
+  parents = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   /* check all supplied files */
-  for (lp = files; lp != NULL; lp = lp->next, ++n_files)
+  for (n = 0; n < selection->n_files; ++n)
     {
-      /* check if the file is a local file */
-      scheme = thunarx_file_info_get_uri_scheme (lp->data);
-
       /* unable to handle non-local files */
-      if (G_UNLIKELY (strcmp (scheme, "file")))
+      if (G_UNLIKELY (selection->paths[n] == NULL))
         {
-          g_free (scheme);
+          g_hash_table_destroy (parents);
+          tap_selection_unref (selection);
           return NULL;
         }
-      g_free (scheme);
 
       /* check if this file is a supported archive */
-      if (all_archives && !tap_is_archive (lp->data))
+      if (all_archives && !tap_is_archive (selection, n))
         all_archives = FALSE;
 
       /* check if we can write to the parent folder */
-      if (can_write && !tap_is_parent_writable (lp->data))
+      if (can_write && !tap_is_parent_writable (selection->paths[n], parents))
         can_write = FALSE;
     }
 
+  g_hash_table_destroy (parents);
+
   /* check if all files are supported archives */
   if (all_archives)
     {
@@ -421,18 +469,18 @@ tap_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
                                         dngettext (GETTEXT_PACKAGE,
                                                    "Extract the selected archive in the current folder",
                                                    "Extract the selected archives in the current folder",
-                                                   n_files),
+                                                   selection->n_files),
                                         "tap-extract");
 
-          g_object_set_qdata_full (G_OBJECT (item), tap_item_files_quark,
-                                   thunarx_file_info_list_copy (files),
-                                   (GDestroyNotify) thunarx_file_info_list_free);
+          g_object_set_qdata_full (G_OBJECT (item), tap_item_selection_quark,
+                                   tap_selection_ref (selection),
+                                   (GDestroyNotify) tap_selection_unref);
           g_object_set_qdata_full (G_OBJECT (item), tap_item_provider_quark,
                                    g_object_ref (G_OBJECT (tap_provider)),
                                    (GDestroyNotify) g_object_unref);
           closure = g_cclosure_new_object (G_CALLBACK (tap_extract_here), G_OBJECT (window));
           g_signal_connect_closure (G_OBJECT (item), "activate", closure, TRUE);
-          items = g_list_append (items, item);
+          items = g_list_prepend (items, item);
         }
 
       /* append the "Extract To..." menu item */
@@ -441,18 +489,18 @@ tap_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
                                     dngettext (GETTEXT_PACKAGE,
                                                "Extract the selected archive",
                                                "Extract the selected archives",
-                                               n_files),
+                                               selection->n_files),
                                     "tap-extract-to");
 
-      g_object_set_qdata_full (G_OBJECT (item), tap_item_files_quark,
-                               thunarx_file_info_list_copy (files),
-                               (GDestroyNotify) thunarx_file_info_list_free);
+      g_object_set_qdata_full (G_OBJECT (item), tap_item_selection_quark,
+                               tap_selection_ref (selection),
+                               (GDestroyNotify) tap_selection_unref);
       g_object_set_qdata_full (G_OBJECT (item), tap_item_provider_quark,
                                g_object_ref (G_OBJECT (tap_provider)),
                                (GDestroyNotify) g_object_unref);
       closure = g_cclosure_new_object (G_CALLBACK (tap_extract_to), G_OBJECT (window));
       g_signal_connect_closure (G_OBJECT (item), "activate", closure, TRUE);
-      items = g_list_append (items, item);
+      items = g_list_prepend (items, item);
     }
 
     /* append the "Create Archive..." menu item */
@@ -461,20 +509,44 @@ tap_provider_get_file_menu_items (ThunarxMenuProvider *menu_provider,
                                   dngettext (GETTEXT_PACKAGE,
                                               "Create an archive with the selected object",
                                               "Create an archive with the selected objects",
-                                              n_files),
+                                              selection->n_files),
                                   "tap-create");
 
-    g_object_set_qdata_full (G_OBJECT (item), tap_item_files_quark,
-                              thunarx_file_info_list_copy (files),
-                              (GDestroyNotify) thunarx_file_info_list_free);
+    g_object_set_qdata_full (G_OBJECT (item), tap_item_selection_quark,
+                              tap_selection_ref (selection),
+                              (GDestroyNotify) tap_selection_unref);
     g_object_set_qdata_full (G_OBJECT (item), tap_item_provider_quark,
                               g_object_ref (G_OBJECT (tap_provider)),
                               (GDestroyNotify) g_object_unref);
     closure = g_cclosure_new_object (G_CALLBACK (tap_create_archive), G_OBJECT (window));
     g_signal_connect_closure (G_OBJECT (item), "activate", closure, TRUE);
-    items = g_list_append (items, item);
+    items = g_list_prepend (items, item);
+
+#ifdef HAVE_LIBARCHIVE
+    /* append the "Compress..." menu item, which creates the archive on several cores */
+    item = thunarx_menu_item_new ("Tap::compress",
+                                  _("C_ompress..."),
+                                  dngettext (GETTEXT_PACKAGE,
+                                              "Create a compressed archive with the selected object, without the archive manager",
+                                              "Create a compressed archive with the selected objects, without the archive manager",
+                                              selection->n_files),
+                                  "tap-create");
+
+    g_object_set_qdata_full (G_OBJECT (item), tap_item_selection_quark,
+                              tap_selection_ref (selection),
+                              (GDestroyNotify) tap_selection_unref);
+    g_object_set_qdata_full (G_OBJECT (item), tap_item_provider_quark,
+                              g_object_ref (G_OBJECT (tap_provider)),
+                              (GDestroyNotify) g_object_unref);
+    closure = g_cclosure_new_object (G_CALLBACK (tap_compress), G_OBJECT (window));
+    g_signal_connect_closure (G_OBJECT (item), "activate", closure, TRUE);
+    items = g_list_prepend (items, item);
+#endif
+
+  /* the items hold their own references now */
+  tap_selection_unref (selection);
 
-  return items;
+  return g_list_reverse (items);
 }
 
 
@@ -488,9 +560,9 @@ tap_provider_get_dnd_menu_items (ThunarxMenuProvider *menu_provider,
   gchar              *scheme;
   TapProvider        *tap_provider = TAP_PROVIDER (menu_provider);
   ThunarxMenuItem    *item;
+  TapSelection       *selection;
   GClosure           *closure;
-  GList              *lp;
-  gint                n_files = 0;
+  guint               n;
 
   /* check if the folder is a local folder */
   scheme = thunarx_file_info_get_uri_scheme (folder);
@@ -503,23 +575,18 @@ tap_provider_get_dnd_menu_items (ThunarxMenuProvider *menu_provider,
     }
   g_free (scheme);
 
+  /* take a snapshot of the dropped files */
+  selection = tap_selection_new (files);
+
   /* check all supplied files */
-  for (lp = files; lp != NULL; lp = lp->next, ++n_files)
+  for (n = 0; n < selection->n_files; ++n)
     {
-      /* check if the file is a local file */
-      scheme = thunarx_file_info_get_uri_scheme (lp->data);
-
-      /* unable to handle non-local files */
-      if (G_UNLIKELY (strcmp (scheme, "file")))
+      /* unable to handle non-local files, and check if this file is a supported archive */
+      if (G_UNLIKELY (selection->paths[n] == NULL) || G_LIKELY (!tap_is_archive (selection, n)))
         {
-          g_free (scheme);
+          tap_selection_unref (selection);
           return NULL;
         }
-      g_free (scheme);
-
-      /* check if this file is a supported archive */
-      if (G_LIKELY (!tap_is_archive (lp->data)))
-        return NULL;
     }
 
   /* setup the "Extract here" menu item */
@@ -529,12 +596,12 @@ tap_provider_get_dnd_menu_items (ThunarxMenuProvider *menu_provider,
                                 dngettext (GETTEXT_PACKAGE,
                                            "Extract the selected archive here",
                                            "Extract the selected archives here",
-                                           n_files),
+                                           selection->n_files),
                                 "tap-extract");
 
-  g_object_set_qdata_full (G_OBJECT (item), tap_item_files_quark,
-                           thunarx_file_info_list_copy (files),
-                           (GDestroyNotify) thunarx_file_info_list_free);
+  g_object_set_qdata_full (G_OBJECT (item), tap_item_selection_quark,
+                           selection,
+                           (GDestroyNotify) tap_selection_unref);
   g_object_set_qdata_full (G_OBJECT (item), tap_item_provider_quark,
                            g_object_ref (G_OBJECT (tap_provider)),
                            (GDestroyNotify) g_object_unref);
@@ -551,28 +618,21 @@ tap_provider_get_dnd_menu_items (ThunarxMenuProvider *menu_provider,
 
 
 static void
-tap_provider_execute (TapProvider *tap_provider,
-                      GPid       (*action) (const gchar *folder,
-                                            GList       *files,
-                                            GtkWidget   *window,
-                                            GError     **error),
-                      GtkWidget   *window,
-                      const gchar *folder,
-                      GList       *files,
-                      const gchar *error_message)
+tap_provider_execute (TapProvider  *tap_provider,
+                      gboolean    (*action) (const gchar  *folder,
+                                             TapSelection *selection,
+                                             GtkWidget    *window,
+                                             GError      **error),
+                      GtkWidget    *window,
+                      const gchar  *folder,
+                      TapSelection *selection,
+                      const gchar  *error_message)
 {
   GtkWidget *dialog;
   GError    *error = NULL;
-  GPid       pid;
 
-  /* try to execute the action */
-  pid = (*action) (folder, files, window, &error);
-  if (G_LIKELY (pid >= 0))
-    {
-      /* schedule the new child watch */
-      g_child_watch_add_full (G_PRIORITY_LOW, pid, tap_provider_child_watch, NULL, NULL);
-    }
-  else if (error != NULL)
+  /* try to execute the action, the scheduler reaps the children */
+  if (!(*action) (folder, selection, window, &error) && error != NULL)
     {
       /* display an error dialog */
       dialog = gtk_message_dialog_new (GTK_WINDOW (window),
@@ -587,17 +647,3 @@ tap_provider_execute (TapProvider *tap_provider,
       g_error_free (error);
     }
 }
-
-
-
-static void
-tap_provider_child_watch (GPid     pid,
-                          gint     status,
-                          gpointer user_data)
-{
-  /* need to cleanup */
-  g_spawn_close_pid (pid);
-}
-
-
-
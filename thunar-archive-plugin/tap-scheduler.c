@@ -0,0 +1,952 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#ifdef HAVE_PIDFD_OPEN
+#include <sys/syscall.h>
+#endif
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <signal.h>
+#ifdef HAVE_POSIX_SPAWN_NP
+#include <spawn.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#ifdef HAVE_HELPER
+#include <thunar-archive-plugin/tap-helper-client.h>
+#endif
+#include <thunar-archive-plugin/tap-scheduler.h>
+#include <thunar-archive-plugin/tap-telemetry.h>
+#include <thunar-archive-plugin/tap-trace.h>
+
+
+
+/* the maximum number of distinct devices a job is accounted on */
+#define TAP_JOB_MAX_DEVICES 4
+
+/* converts a struct timeval to microseconds */
+#define TAP_TIMEVAL_USEC(tv) ((gint64) (tv).tv_sec * G_USEC_PER_SEC + (tv).tv_usec)
+
+
+
+typedef struct _TapDevice TapDevice;
+
+
+
+static TapDevice *tap_scheduler_device       (dev_t          dev);
+static gboolean   tap_scheduler_can_start    (TapJob        *job);
+static gboolean   tap_scheduler_start        (TapJob        *job,
+                                              GError       **error);
+static void       tap_scheduler_record       (TapJob        *job,
+                                              gint           status,
+                                              struct rusage *usage);
+static void       tap_scheduler_finish       (TapJob        *job,
+                                              gint           status,
+                                              struct rusage *usage);
+static void       tap_scheduler_pump         (void);
+static gboolean   tap_scheduler_spawn        (TapJob        *job,
+                                              GError       **error);
+static void       tap_scheduler_watch        (TapJob        *job);
+#ifndef HAVE_POSIX_SPAWN_NP
+static void       tap_scheduler_child_setup  (gpointer       user_data);
+#endif
+#ifdef HAVE_PIDFD_OPEN
+static gboolean   tap_scheduler_pidfd_ready  (gint           fd,
+                                              GIOCondition   condition,
+                                              gpointer       user_data);
+#endif
+static void       tap_scheduler_child_watch  (GPid           pid,
+                                              gint           status,
+                                              gpointer       user_data);
+static void       tap_scheduler_pool_func    (gpointer       data,
+                                              gpointer       user_data);
+static gboolean   tap_scheduler_pool_ready   (gpointer       user_data);
+static void       tap_scheduler_thread       (TapJob        *job);
+#ifdef HAVE_HELPER
+static gboolean   tap_scheduler_remote       (TapJob        *job);
+static void       tap_scheduler_remote_call  (TapJob        *job);
+static void       tap_scheduler_remote_ready (TapJob        *job);
+#endif
+static TapJob    *tap_job_new                (const gchar   *folder);
+static void       tap_job_free               (TapJob        *job);
+
+
+
+struct _TapJob
+{
+  gchar         *folder;
+
+  /* what the job does, for the telemetry */
+  const gchar   *action;
+  const gchar   *archiver;
+  guint64        input_bytes;
+  gint64         start_time;
+
+  /* the devices this job reads from or writes to */
+  dev_t          devices[TAP_JOB_MAX_DEVICES];
+  guint          n_devices;
+
+  /* spawned jobs, the vectors are borrowed until the job is queued */
+  gchar        **argv;
+  gchar        **envp;
+  gboolean       owns_vectors;
+  gint           stdin_fd;
+  GPid           pid;
+
+#ifdef HAVE_HELPER
+  /* spawned by the helper, the request is built on the main thread */
+  GSocketConnection *helper;
+  GVariant          *request;
+  GVariant          *result;
+#endif
+
+  /* in-process jobs, the resource usage is measured on the worker */
+  struct rusage  usage;
+  gint           status;
+  guint          n_threads;
+  TapJobFunc     func;
+  TapJobDoneFunc done;
+  gpointer       user_data;
+  GDestroyNotify destroy;
+};
+
+struct _TapDevice
+{
+  gint64 dev;
+  guint  budget;
+  guint  running;
+};
+
+
+
+/* jobs waiting for a free slot, in submission order */
+static GQueue      tap_scheduler_queue = G_QUEUE_INIT;
+
+/* the child-watch table, maps the GPid of every spawned job to the job */
+static GHashTable *tap_scheduler_children = NULL;
+
+/* the I/O budgets, maps device numbers to TapDevice's */
+static GHashTable *tap_scheduler_devices = NULL;
+
+/* the workers of the in-process jobs, and of the calls to the helper, which
+ * are not run in the shared pool of GTask, so they cannot starve GIO */
+static GThreadPool *tap_scheduler_pool = NULL;
+
+/* the resource usage of the reaped children at the last child watch */
+static struct rusage tap_scheduler_children_usage;
+
+/* the cores taken by the running jobs, and the limit derived from the CPU count */
+static guint       tap_scheduler_running = 0;
+static guint       tap_scheduler_limit = 0;
+
+
+
+static TapDevice*
+tap_scheduler_device (dev_t dev)
+{
+  TapDevice *device;
+  gint64     key = dev;
+  gchar     *contents = NULL;
+  gchar     *path;
+
+  device = g_hash_table_lookup (tap_scheduler_devices, &key);
+  if (G_LIKELY (device != NULL))
+    return device;
+
+  device = g_slice_new0 (TapDevice);
+  device->dev = dev;
+
+  /* rotating disks only get one job at a time, since parallel streams
+   * would just make them seek; everything else shares half the cores.
+   */
+  path = g_strdup_printf ("/sys/dev/block/%u:%u/queue/rotational", major (dev), minor (dev));
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      /* partitions inherit the queue of their disk */
+      g_free (path);
+      path = g_strdup_printf ("/sys/dev/block/%u:%u/../queue/rotational", major (dev), minor (dev));
+      g_file_get_contents (path, &contents, NULL, NULL);
+    }
+  device->budget = (contents != NULL && contents[0] == '1') ? 1 : MAX (2, tap_scheduler_limit / 2);
+  g_free (contents);
+  g_free (path);
+
+  g_hash_table_insert (tap_scheduler_devices, &device->dev, device);
+
+  return device;
+}
+
+
+
+static gboolean
+tap_scheduler_can_start (TapJob *job)
+{
+  TapDevice *device;
+  guint      n;
+
+  if (tap_scheduler_running >= tap_scheduler_limit)
+    return FALSE;
+
+  for (n = 0; n < job->n_devices; ++n)
+    {
+      device = tap_scheduler_device (job->devices[n]);
+      if (device->running >= device->budget)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+static gboolean
+tap_scheduler_start (TapJob  *job,
+                     GError **error)
+{
+  guint n;
+
+  job->start_time = g_get_monotonic_time ();
+
+  if (job->argv != NULL)
+    {
+#ifdef HAVE_HELPER
+      /* the helper cannot receive the file list on stdin */
+      if (job->stdin_fd < 0 && tap_scheduler_remote (job))
+        goto account;
+#endif
+
+      /* spawn the job, and watch for its exit */
+      if (!tap_scheduler_spawn (job, error))
+        return FALSE;
+      tap_scheduler_watch (job);
+
+      /* the child has its own copy of the file list now */
+      if (job->stdin_fd >= 0)
+        {
+          close (job->stdin_fd);
+          job->stdin_fd = -1;
+        }
+    }
+  else
+    {
+      /* the job gets half of the free cores, so the ones submitted next still
+       * get some, and the threads of all jobs together do not exceed the limit */
+      job->n_threads = (tap_scheduler_limit - tap_scheduler_running + 1) / 2;
+
+      /* run the job on a worker thread */
+      g_thread_pool_push (tap_scheduler_pool, job, NULL);
+    }
+
+#ifdef HAVE_HELPER
+account:
+#endif
+  /* account the job on the CPU and I/O budgets, external processes for one core */
+  tap_scheduler_running += MAX (job->n_threads, 1);
+  for (n = 0; n < job->n_devices; ++n)
+    tap_scheduler_device (job->devices[n])->running += 1;
+
+  return TRUE;
+}
+
+
+
+static void
+tap_scheduler_record (TapJob        *job,
+                      gint           status,
+                      struct rusage *usage)
+{
+  TapJobRecord record;
+
+  /* record the measurements of the job */
+  if (job->action != NULL)
+    {
+      record.timestamp = g_get_real_time ();
+      record.action = job->action;
+      record.archiver = job->archiver;
+      record.input_bytes = job->input_bytes;
+      record.latency = g_get_monotonic_time () - job->start_time;
+      record.signal = 0;
+      if (job->func != NULL || status < 0)
+        {
+          /* the return value of in-process jobs, or -1 for jobs that did not run */
+          record.exit_code = status;
+        }
+      else if (WIFSIGNALED (status))
+        {
+          record.exit_code = -1;
+          record.signal = WTERMSIG (status);
+        }
+      else
+        {
+          record.exit_code = WEXITSTATUS (status);
+        }
+      record.utime = TAP_TIMEVAL_USEC (usage->ru_utime);
+      record.stime = TAP_TIMEVAL_USEC (usage->ru_stime);
+      record.maxrss = usage->ru_maxrss;
+      tap_telemetry_record (&record);
+    }
+}
+
+
+
+static void
+tap_scheduler_finish (TapJob        *job,
+                      gint           status,
+                      struct rusage *usage)
+{
+  guint n;
+
+  /* release the budgets */
+  tap_scheduler_running -= MAX (job->n_threads, 1);
+  for (n = 0; n < job->n_devices; ++n)
+    tap_scheduler_device (job->devices[n])->running -= 1;
+
+  tap_scheduler_record (job, status, usage);
+
+  if (job->done != NULL)
+    (*job->done) (status, job->user_data);
+  tap_job_free (job);
+
+  /* start the jobs waiting for the released slots */
+  tap_scheduler_pump ();
+}
+
+
+
+static void
+tap_scheduler_pump (void)
+{
+  GError *error = NULL;
+  TapJob *job;
+  GList  *next;
+  GList  *lp;
+
+  /* start the queued jobs in order, skipping those whose devices are busy */
+  for (lp = tap_scheduler_queue.head; lp != NULL && tap_scheduler_running < tap_scheduler_limit; lp = next)
+    {
+      next = lp->next;
+      job = lp->data;
+
+      if (!tap_scheduler_can_start (job))
+        continue;
+
+      g_queue_delete_link (&tap_scheduler_queue, lp);
+      if (G_UNLIKELY (!tap_scheduler_start (job, &error)))
+        {
+          g_warning ("Failed to start queued job: %s", error->message);
+          g_clear_error (&error);
+
+          tap_scheduler_record (job, -1, &job->usage);
+          if (job->done != NULL)
+            (*job->done) (-1, job->user_data);
+          tap_job_free (job);
+        }
+    }
+}
+
+
+
+static gboolean
+tap_scheduler_spawn (TapJob  *job,
+                     GError **error)
+{
+#ifdef HAVE_POSIX_SPAWN_NP
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t          attr;
+  sigset_t                   signals;
+  pid_t                      pid;
+  gint                       err;
+#endif
+
+  TAP_TRACE_SCOPE ("spawn");
+
+#ifdef HAVE_POSIX_SPAWN_NP
+  /* glibc implements posix_spawn() with a vfork-style clone, so the cost
+   * does not grow with the heap of the file manager like fork() does.
+   */
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_addchdir_np (&actions, job->folder);
+  if (job->stdin_fd >= 0)
+    posix_spawn_file_actions_adddup2 (&actions, job->stdin_fd, STDIN_FILENO);
+  posix_spawn_file_actions_addclosefrom_np (&actions, STDERR_FILENO + 1);
+
+  /* start with no blocked signals and a default SIGPIPE, like a shell would */
+  posix_spawnattr_init (&attr);
+  sigemptyset (&signals);
+  posix_spawnattr_setsigmask (&attr, &signals);
+  sigaddset (&signals, SIGPIPE);
+  posix_spawnattr_setsigdefault (&attr, &signals);
+  posix_spawnattr_setflags (&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  err = posix_spawn (&pid, job->argv[0], &actions, &attr, job->argv, (job->envp != NULL) ? job->envp : environ);
+
+  posix_spawnattr_destroy (&attr);
+  posix_spawn_file_actions_destroy (&actions);
+
+  if (G_UNLIKELY (err != 0))
+    {
+      g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                   _("Failed to execute child process \"%s\" (%s)"),
+                   job->argv[0], g_strerror (err));
+      return FALSE;
+    }
+
+  job->pid = pid;
+
+  return TRUE;
+#else
+  return g_spawn_async (job->folder, job->argv, job->envp, G_SPAWN_DO_NOT_REAP_CHILD,
+                        (job->stdin_fd >= 0) ? tap_scheduler_child_setup : NULL,
+                        GINT_TO_POINTER (job->stdin_fd), &job->pid, error);
+#endif
+}
+
+
+
+static void
+tap_scheduler_watch (TapJob *job)
+{
+#ifdef HAVE_PIDFD_OPEN
+  gint fd;
+
+  /* watch the pidfd right in the main loop, and reap with wait4() for the exact usage */
+  fd = syscall (SYS_pidfd_open, job->pid, 0);
+  if (G_LIKELY (fd >= 0))
+    {
+      g_unix_fd_add (fd, G_IO_IN, tap_scheduler_pidfd_ready, job);
+      return;
+    }
+#endif
+
+  /* kernels without pidfds, register it in the child-watch table */
+  g_hash_table_insert (tap_scheduler_children, GINT_TO_POINTER (job->pid), job);
+  g_child_watch_add_full (G_PRIORITY_DEFAULT, job->pid, tap_scheduler_child_watch, NULL, NULL);
+}
+
+
+
+#ifdef HAVE_PIDFD_OPEN
+static gboolean
+tap_scheduler_pidfd_ready (gint         fd,
+                           GIOCondition condition,
+                           gpointer     user_data)
+{
+  struct rusage usage;
+  TapJob       *job = user_data;
+  gint          status = 0;
+
+  /* the child exited, so this does not block */
+  while (wait4 (job->pid, &status, 0, &usage) < 0 && errno == EINTR)
+    ;
+
+  close (fd);
+
+  tap_scheduler_finish (job, status, &usage);
+
+  return G_SOURCE_REMOVE;
+}
+#endif
+
+
+
+#ifndef HAVE_POSIX_SPAWN_NP
+static void
+tap_scheduler_child_setup (gpointer user_data)
+{
+  /* make the file list the stdin of the wrapper */
+  dup2 (GPOINTER_TO_INT (user_data), STDIN_FILENO);
+}
+#endif
+
+
+
+static void
+tap_scheduler_child_watch (GPid     pid,
+                           gint     status,
+                           gpointer user_data)
+{
+  struct rusage usage;
+  struct rusage delta;
+  TapJob       *job;
+
+  /* need to cleanup */
+  g_spawn_close_pid (pid);
+
+  /* GLib reaped the child already, so attribute the growth of the children
+   * usage since the last watch to this child. That includes other children
+   * of the file manager that exited meanwhile, and maxrss is the peak of all.
+   */
+  getrusage (RUSAGE_CHILDREN, &usage);
+  timersub (&usage.ru_utime, &tap_scheduler_children_usage.ru_utime, &delta.ru_utime);
+  timersub (&usage.ru_stime, &tap_scheduler_children_usage.ru_stime, &delta.ru_stime);
+  delta.ru_maxrss = usage.ru_maxrss;
+  tap_scheduler_children_usage = usage;
+
+  job = g_hash_table_lookup (tap_scheduler_children, GINT_TO_POINTER (pid));
+  if (G_LIKELY (job != NULL))
+    {
+      g_hash_table_remove (tap_scheduler_children, GINT_TO_POINTER (pid));
+      tap_scheduler_finish (job, status, &delta);
+    }
+}
+
+
+
+static void
+tap_scheduler_pool_func (gpointer data,
+                         gpointer user_data)
+{
+  TapJob *job = data;
+
+#ifdef HAVE_HELPER
+  if (job->helper != NULL)
+    tap_scheduler_remote_call (job);
+  else
+#endif
+    tap_scheduler_thread (job);
+
+  /* finish the job on the main thread */
+  g_idle_add_full (G_PRIORITY_DEFAULT, tap_scheduler_pool_ready, job, NULL);
+}
+
+
+
+static gboolean
+tap_scheduler_pool_ready (gpointer user_data)
+{
+  TapJob *job = user_data;
+
+#ifdef HAVE_HELPER
+  if (job->helper != NULL)
+    tap_scheduler_remote_ready (job);
+  else
+#endif
+    tap_scheduler_finish (job, job->status, &job->usage);
+
+  return G_SOURCE_REMOVE;
+}
+
+
+
+static void
+tap_scheduler_thread (TapJob *job)
+{
+  struct rusage before;
+
+  /* measure the usage of this thread only */
+  getrusage (RUSAGE_THREAD, &before);
+  job->status = (*job->func) (job->n_threads, job->user_data);
+  getrusage (RUSAGE_THREAD, &job->usage);
+  timersub (&job->usage.ru_utime, &before.ru_utime, &job->usage.ru_utime);
+  timersub (&job->usage.ru_stime, &before.ru_stime, &job->usage.ru_stime);
+}
+
+
+
+#ifdef HAVE_HELPER
+static gboolean
+tap_scheduler_remote (TapJob *job)
+{
+  GVariantBuilder builder;
+
+  /* the helper starts itself for the next jobs if it's not running */
+  job->helper = tap_helper_connect ();
+  if (job->helper == NULL)
+    return FALSE;
+
+  /* copy the borrowed vectors into the request right away, as bytestrings,
+   * since file names and the environment need not be UTF-8 */
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "folder", g_variant_new_bytestring (job->folder));
+  g_variant_builder_add (&builder, "{sv}", "argv", g_variant_new_bytestring_array ((const gchar * const *) job->argv, -1));
+  if (job->envp != NULL)
+    g_variant_builder_add (&builder, "{sv}", "envp", g_variant_new_bytestring_array ((const gchar * const *) job->envp, -1));
+  job->request = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+  /* wait for the reply of the helper on a worker thread */
+  g_thread_pool_push (tap_scheduler_pool, job, NULL);
+
+  return TRUE;
+}
+
+
+
+static void
+tap_scheduler_remote_call (TapJob *job)
+{
+  GError *error = NULL;
+
+  job->result = tap_helper_call (job->helper, "spawn", job->request, &error);
+  if (G_UNLIKELY (job->result == NULL))
+    {
+      g_warning ("Failed to talk to the archive helper: %s", error->message);
+      g_error_free (error);
+    }
+}
+
+
+
+static void
+tap_scheduler_remote_ready (TapJob *job)
+{
+  const gchar *message;
+  GError      *error = NULL;
+  gint64       utime = 0;
+  gint64       stime = 0;
+  gint64       maxrss = 0;
+  gint         status = -1;
+
+  if (G_UNLIKELY (job->result == NULL))
+    {
+      /* the helper went away, so spawn the job here after all, from the
+       * request, since the vectors of queued jobs were copied into it */
+      if (job->owns_vectors)
+        {
+          g_strfreev (job->envp);
+          g_strfreev (job->argv);
+        }
+      job->argv = NULL;
+      job->envp = NULL;
+      job->owns_vectors = TRUE;
+
+      if (!g_variant_lookup (job->request, "argv", "^aay", &job->argv))
+        {
+          g_warning ("Failed to start job: the request has no command");
+        }
+      else
+        {
+          if (!g_variant_lookup (job->request, "envp", "^aay", &job->envp))
+            job->envp = NULL;
+
+          if (tap_scheduler_spawn (job, &error))
+            {
+              tap_scheduler_watch (job);
+              return;
+            }
+
+          g_warning ("Failed to start job: %s", error->message);
+          g_error_free (error);
+        }
+    }
+  else if (g_variant_lookup (job->result, "error", "&s", &message))
+    {
+      g_warning ("The archive helper failed to start job: %s", message);
+    }
+  else
+    {
+      g_variant_lookup (job->result, "status", "i", &status);
+      g_variant_lookup (job->result, "utime", "x", &utime);
+      g_variant_lookup (job->result, "stime", "x", &stime);
+      g_variant_lookup (job->result, "maxrss", "x", &maxrss);
+    }
+
+  job->usage.ru_utime.tv_sec = utime / G_USEC_PER_SEC;
+  job->usage.ru_utime.tv_usec = utime % G_USEC_PER_SEC;
+  job->usage.ru_stime.tv_sec = stime / G_USEC_PER_SEC;
+  job->usage.ru_stime.tv_usec = stime % G_USEC_PER_SEC;
+  job->usage.ru_maxrss = maxrss;
+
+  tap_scheduler_finish (job, status, &job->usage);
+}
+#endif
+
+
+
+static void
+tap_job_free (TapJob *job)
+{
+  if (job->destroy != NULL)
+    (*job->destroy) (job->user_data);
+  if (job->stdin_fd >= 0)
+    close (job->stdin_fd);
+  if (job->owns_vectors)
+    {
+      g_strfreev (job->envp);
+      g_strfreev (job->argv);
+    }
+#ifdef HAVE_HELPER
+  if (job->result != NULL)
+    g_variant_unref (job->result);
+  if (job->request != NULL)
+    g_variant_unref (job->request);
+  if (job->helper != NULL)
+    g_object_unref (job->helper);
+#endif
+  g_free (job->folder);
+  g_slice_free (TapJob, job);
+}
+
+
+
+static TapJob*
+tap_job_new (const gchar *folder)
+{
+  TapJob  *job;
+  GStatBuf statb;
+
+  job = g_slice_new0 (TapJob);
+  job->folder = g_strdup (folder);
+  job->stdin_fd = -1;
+
+  /* the destination device */
+  if (g_stat (folder, &statb) == 0)
+    job->devices[job->n_devices++] = statb.st_dev;
+
+  return job;
+}
+
+
+
+/**
+ * tap_job_new_spawn:
+ * @folder   : the working directory, and the folder written to.
+ * @argv     : the command to run, which is only borrowed until
+ *             tap_scheduler_submit() returns.
+ * @envp     : the environment, or %NULL to inherit it, which is
+ *             borrowed just like the @argv.
+ * @stdin_fd : a file descriptor for the stdin of the command, which
+ *             is owned by the job, or %-1.
+ *
+ * Allocates a job that spawns a command once it is scheduled. The
+ * @argv and @envp are only copied if the job has to wait for a free
+ * slot, so that the common case does not duplicate huge selections
+ * or the environment.
+ *
+ * Return value: the new #TapJob, to pass to tap_scheduler_submit().
+ **/
+TapJob*
+tap_job_new_spawn (const gchar *folder,
+                   gchar      **argv,
+                   gchar      **envp,
+                   gint         stdin_fd)
+{
+  TapJob *job;
+
+  g_return_val_if_fail (g_path_is_absolute (folder), NULL);
+  g_return_val_if_fail (argv != NULL, NULL);
+
+  job = tap_job_new (folder);
+  job->argv = argv;
+  job->envp = envp;
+  job->stdin_fd = stdin_fd;
+
+  return job;
+}
+
+
+
+/**
+ * tap_job_new_thread:
+ * @folder    : the folder written to.
+ * @func      : the function to run on a worker thread.
+ * @done      : the function to call on the main thread afterwards.
+ * @user_data : the data passed to @func and @done.
+ * @destroy   : the function to release @user_data, or %NULL.
+ *
+ * Allocates a job that runs @func on a worker thread once it is
+ * scheduled, with the number of threads it may use out of the free
+ * slots of the CPU budget.
+ *
+ * Return value: the new #TapJob, to pass to tap_scheduler_submit().
+ **/
+TapJob*
+tap_job_new_thread (const gchar   *folder,
+                    TapJobFunc     func,
+                    TapJobDoneFunc done,
+                    gpointer       user_data,
+                    GDestroyNotify destroy)
+{
+  TapJob *job;
+
+  g_return_val_if_fail (g_path_is_absolute (folder), NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  job = tap_job_new (folder);
+  job->func = func;
+  job->done = done;
+  job->user_data = user_data;
+  job->destroy = destroy;
+
+  return job;
+}
+
+
+
+/**
+ * tap_job_set_done:
+ * @job       : a #TapJob created with tap_job_new_spawn().
+ * @done      : the function to call on the main thread once the command exited.
+ * @user_data : the data passed to @done.
+ * @destroy   : the function to release @user_data, or %NULL.
+ *
+ * Sets the function to call with the wait status of the command of the
+ * @job, or %-1 if it could not be started.
+ **/
+void
+tap_job_set_done (TapJob        *job,
+                  TapJobDoneFunc done,
+                  gpointer       user_data,
+                  GDestroyNotify destroy)
+{
+  g_return_if_fail (job != NULL);
+  g_return_if_fail (job->func == NULL);
+  g_return_if_fail (job->done == NULL);
+
+  job->done = done;
+  job->user_data = user_data;
+  job->destroy = destroy;
+}
+
+
+
+/**
+ * tap_job_add_input:
+ * @job      : a #TapJob.
+ * @filename : a file read by the @job.
+ *
+ * Accounts the @job on the I/O budget of the device that holds
+ * @filename as well.
+ **/
+void
+tap_job_add_input (TapJob      *job,
+                   const gchar *filename)
+{
+  GStatBuf statb;
+  guint    n;
+
+  g_return_if_fail (job != NULL);
+
+  if (job->n_devices >= TAP_JOB_MAX_DEVICES || g_stat (filename, &statb) < 0)
+    return;
+
+  for (n = 0; n < job->n_devices; ++n)
+    if (job->devices[n] == statb.st_dev)
+      return;
+
+  job->devices[job->n_devices++] = statb.st_dev;
+}
+
+
+
+/**
+ * tap_job_set_info:
+ * @job         : a #TapJob.
+ * @action      : the action run by the @job.
+ * @archiver    : the id of the archive manager used by the @job.
+ * @input_bytes : the size of the files read by the @job.
+ *
+ * Describes the @job for the telemetry. Jobs without description
+ * are not recorded.
+ **/
+void
+tap_job_set_info (TapJob      *job,
+                  const gchar *action,
+                  const gchar *archiver,
+                  guint64      input_bytes)
+{
+  g_return_if_fail (job != NULL);
+  g_return_if_fail (action != NULL);
+
+  job->action = g_intern_string (action);
+  job->archiver = g_intern_string (archiver);
+  job->input_bytes = input_bytes;
+}
+
+
+
+/**
+ * tap_scheduler_submit:
+ * @job   : the #TapJob to run, the scheduler takes ownership.
+ * @error : return location for errors or %NULL.
+ *
+ * Starts the @job right away if there's a free slot, or queues it
+ * until the running jobs release enough of the CPU and I/O budgets.
+ * Errors of queued jobs are logged when they are started.
+ *
+ * Return value: %FALSE if the @job was started right away and failed.
+ **/
+gboolean
+tap_scheduler_submit (TapJob  *job,
+                      GError **error)
+{
+  g_return_val_if_fail (job != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (G_UNLIKELY (tap_scheduler_children == NULL))
+    {
+      tap_scheduler_children = g_hash_table_new (g_direct_hash, g_direct_equal);
+      tap_scheduler_devices = g_hash_table_new (g_int64_hash, g_int64_equal);
+      tap_scheduler_limit = MAX (1, g_get_num_processors ());
+
+      /* every worker takes at least one slot, so the limit bounds them */
+      tap_scheduler_pool = g_thread_pool_new (tap_scheduler_pool_func, NULL, tap_scheduler_limit, FALSE, NULL);
+      getrusage (RUSAGE_CHILDREN, &tap_scheduler_children_usage);
+    }
+
+  /* start right away, unless earlier jobs are still waiting */
+  if (g_queue_is_empty (&tap_scheduler_queue) && tap_scheduler_can_start (job))
+    {
+      if (!tap_scheduler_start (job, error))
+        {
+          tap_scheduler_record (job, -1, &job->usage);
+          tap_job_free (job);
+          return FALSE;
+        }
+
+      /* the vectors are not needed after the spawn */
+      if (!job->owns_vectors)
+        {
+          job->argv = NULL;
+          job->envp = NULL;
+        }
+
+      return TRUE;
+    }
+
+  /* the caller's vectors will be gone by the time the job starts */
+  if (job->argv != NULL)
+    {
+      job->argv = g_strdupv (job->argv);
+      job->envp = g_strdupv (job->envp);
+      job->owns_vectors = TRUE;
+    }
+
+  g_queue_push_tail (&tap_scheduler_queue, job);
+
+  return TRUE;
+}
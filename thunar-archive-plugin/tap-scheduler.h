@@ -0,0 +1,78 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_SCHEDULER_H__
+#define __TAP_SCHEDULER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapJob TapJob;
+
+/**
+ * TapJobFunc:
+ * @n_threads : the number of threads the job may use.
+ * @user_data : the data passed to tap_job_new_thread().
+ *
+ * Runs an in-process job on a worker thread. The job is accounted
+ * on the CPU budget for @n_threads, so it should not start more.
+ *
+ * Return value: the exit status of the job, %0 on success.
+ **/
+typedef gint (*TapJobFunc) (guint    n_threads,
+                            gpointer user_data);
+
+/**
+ * TapJobDoneFunc:
+ * @status    : the exit status of the job.
+ * @user_data : the data passed to tap_job_new_thread() or tap_job_set_done().
+ *
+ * Called on the main thread once a job finished.
+ **/
+typedef void (*TapJobDoneFunc) (gint     status,
+                                gpointer user_data);
+
+TapJob  *tap_job_new_spawn    (const gchar    *folder,
+                               gchar         **argv,
+                               gchar         **envp,
+                               gint            stdin_fd) G_GNUC_INTERNAL G_GNUC_MALLOC;
+TapJob  *tap_job_new_thread   (const gchar    *folder,
+                               TapJobFunc      func,
+                               TapJobDoneFunc  done,
+                               gpointer        user_data,
+                               GDestroyNotify  destroy) G_GNUC_INTERNAL G_GNUC_MALLOC;
+void     tap_job_set_done     (TapJob         *job,
+                               TapJobDoneFunc  done,
+                               gpointer        user_data,
+                               GDestroyNotify  destroy) G_GNUC_INTERNAL;
+void     tap_job_add_input    (TapJob         *job,
+                               const gchar    *filename) G_GNUC_INTERNAL;
+void     tap_job_set_info     (TapJob         *job,
+                               const gchar    *action,
+                               const gchar    *archiver,
+                               guint64         input_bytes) G_GNUC_INTERNAL;
+
+gboolean tap_scheduler_submit (TapJob         *job,
+                               GError        **error) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_SCHEDULER_H__ */
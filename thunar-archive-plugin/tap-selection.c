@@ -0,0 +1,161 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <thunar-archive-plugin/tap-selection.h>
+
+
+
+/**
+ * tap_selection_new:
+ * @files : a #GList of #ThunarxFileInfo<!---->s.
+ *
+ * Takes a snapshot of the @files, querying the URI, the local path
+ * and the mime type of every file exactly once.
+ *
+ * Return value: the new #TapSelection, release with tap_selection_unref().
+ **/
+TapSelection*
+tap_selection_new (GList *files)
+{
+  TapSelection *selection;
+  gpointer     *block;
+  gchar        *mime_type;
+  gchar        *path;
+  gchar        *uri;
+  GList        *lp;
+  guint         n;
+
+  selection = g_slice_new0 (TapSelection);
+  selection->ref_count = 1;
+  selection->n_files = g_list_length (files);
+
+  /* allocate the arrays in a single block, and the strings from a
+   * chunk sized for the selection, so both are released in one go.
+   */
+  block = g_new (gpointer, 4 * selection->n_files);
+  selection->files = (ThunarxFileInfo **) block;
+  selection->uris = (gchar **) (block + selection->n_files);
+  selection->paths = (gchar **) (block + 2 * selection->n_files);
+  selection->mime_types = (const gchar **) (block + 3 * selection->n_files);
+  selection->strings = g_string_chunk_new (CLAMP (selection->n_files * 128, 1024, 1024 * 1024));
+
+  for (lp = files, n = 0; lp != NULL; lp = lp->next, ++n)
+    {
+      selection->files[n] = g_object_ref (lp->data);
+
+      uri = thunarx_file_info_get_uri (lp->data);
+      selection->uris[n] = g_string_chunk_insert (selection->strings, uri);
+
+      path = g_filename_from_uri (uri, NULL, NULL);
+      selection->paths[n] = (path != NULL) ? g_string_chunk_insert (selection->strings, path) : NULL;
+      g_free (path);
+      g_free (uri);
+
+      /* intern the mime type, so it can be compared by pointer */
+      mime_type = thunarx_file_info_get_mime_type (lp->data);
+      selection->mime_types[n] = g_intern_string (mime_type);
+      g_free (mime_type);
+    }
+
+  return selection;
+}
+
+
+
+/**
+ * tap_selection_ref:
+ * @selection : a #TapSelection.
+ *
+ * Increases the reference count on @selection.
+ *
+ * Return value: the @selection.
+ **/
+TapSelection*
+tap_selection_ref (TapSelection *selection)
+{
+  g_return_val_if_fail (selection != NULL, NULL);
+  g_return_val_if_fail (selection->ref_count > 0, NULL);
+
+  g_atomic_int_inc (&selection->ref_count);
+
+  return selection;
+}
+
+
+
+/**
+ * tap_selection_unref:
+ * @selection : a #TapSelection.
+ *
+ * Decreases the reference count on @selection, and releases
+ * it once the last reference is dropped.
+ **/
+void
+tap_selection_unref (TapSelection *selection)
+{
+  guint n;
+
+  g_return_if_fail (selection != NULL);
+  g_return_if_fail (selection->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&selection->ref_count))
+    {
+      for (n = 0; n < selection->n_files; ++n)
+        g_object_unref (selection->files[n]);
+
+      /* the arrays and strings were allocated in one block each */
+      g_string_chunk_free (selection->strings);
+      g_free (selection->files);
+      g_slice_free (TapSelection, selection);
+    }
+}
+
+
+
+/**
+ * tap_selection_get_size:
+ * @selection : a #TapSelection.
+ * @index     : the index of a file in @selection.
+ *
+ * Returns the size of the file at @index, as last seen by the
+ * file manager. Folders and special files count as %0.
+ *
+ * Return value: the size of the file in bytes.
+ **/
+guint64
+tap_selection_get_size (TapSelection *selection,
+                        guint         index)
+{
+  GFileInfo *info;
+  guint64    size = 0;
+
+  g_return_val_if_fail (selection != NULL, 0);
+  g_return_val_if_fail (index < selection->n_files, 0);
+
+  info = thunarx_file_info_get_file_info (selection->files[index]);
+  if (G_LIKELY (info != NULL))
+    {
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR)
+        size = g_file_info_get_size (info);
+      g_object_unref (G_OBJECT (info));
+    }
+
+  return size;
+}
@@ -0,0 +1,70 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_SELECTION_H__
+#define __TAP_SELECTION_H__
+
+#include <thunarx/thunarx.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapSelection TapSelection;
+
+/**
+ * TapSelection:
+ * @n_files    : the number of selected files.
+ * @files      : the #ThunarxFileInfo<!---->s of the selected files.
+ * @uris       : the URIs of the selected files.
+ * @paths      : the local paths of the selected files, %NULL for
+ *               files that are not local.
+ * @mime_types : the interned mime types of the selected files, where
+ *               the provider may replace generic types with the type
+ *               of the archive detected from the contents.
+ *
+ * A snapshot of the files selected for a menu, shared
+ * by all items of the menu and the actions run from them. The
+ * strings are owned by the selection and released in one shot.
+ * Apart from the content sniffing, which happens on the main
+ * thread before the menu items are created, it is immutable.
+ **/
+struct _TapSelection
+{
+  /*< private >*/
+  gint              ref_count;
+  GStringChunk     *strings;
+
+  /*< public >*/
+  guint             n_files;
+  ThunarxFileInfo **files;
+  gchar           **uris;
+  gchar           **paths;
+  const gchar     **mime_types;
+};
+
+TapSelection *tap_selection_new      (GList        *files) G_GNUC_INTERNAL G_GNUC_MALLOC;
+TapSelection *tap_selection_ref      (TapSelection *selection) G_GNUC_INTERNAL;
+void          tap_selection_unref    (TapSelection *selection) G_GNUC_INTERNAL;
+
+guint64       tap_selection_get_size (TapSelection *selection,
+                                      guint         index) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_SELECTION_H__ */
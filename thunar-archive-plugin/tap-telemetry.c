@@ -0,0 +1,225 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <thunar-archive-plugin/tap-telemetry.h>
+
+
+
+/* the number of records kept in memory */
+#define TAP_TELEMETRY_RING_SIZE (64)
+
+/* the size at which the log is rotated to jobs.jsonl.1 */
+#define TAP_TELEMETRY_LOG_MAX (1024 * 1024)
+
+
+
+static void tap_telemetry_append_string (GString            *line,
+                                         const gchar        *string);
+static void tap_telemetry_write         (gpointer            data,
+                                         gpointer            user_data);
+
+
+
+/* the most recent records, the oldest is overwritten first */
+static TapJobRecord tap_telemetry_ring[TAP_TELEMETRY_RING_SIZE];
+static guint        tap_telemetry_ring_head = 0;
+static guint        tap_telemetry_ring_length = 0;
+
+/* the thread appending to the log, since the cache may be on a network share */
+static GThreadPool *tap_telemetry_pool = NULL;
+
+/* the path to the JSON-lines log, determined on-demand by the writer */
+static gchar       *tap_telemetry_log = NULL;
+
+
+
+static void
+tap_telemetry_append_string (GString     *line,
+                             const gchar *string)
+{
+  const gchar *s;
+
+  if (G_UNLIKELY (string == NULL))
+    {
+      g_string_append (line, "null");
+      return;
+    }
+
+  /* desktop ids are plain ASCII in practice, but stay valid JSON anyway */
+  g_string_append_c (line, '"');
+  for (s = string; *s != '\0'; ++s)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_c (line, '\\');
+      if ((guchar) *s < 0x20)
+        g_string_append_printf (line, "\\u%04x", (guint) *s);
+      else
+        g_string_append_c (line, *s);
+    }
+  g_string_append_c (line, '"');
+}
+
+
+
+static void
+tap_telemetry_write (gpointer data,
+                     gpointer user_data)
+{
+  TapJobRecord *record = data;
+  GStatBuf      statb;
+  GString      *line;
+  gchar        *rotated;
+  gchar        *dirname;
+  gint          fd;
+
+  if (G_UNLIKELY (tap_telemetry_log == NULL))
+    {
+      tap_telemetry_log = g_build_filename (g_get_user_cache_dir (), "thunar-archive-plugin", "jobs.jsonl", NULL);
+      dirname = g_path_get_dirname (tap_telemetry_log);
+      g_mkdir_with_parents (dirname, 0700);
+      g_free (dirname);
+    }
+
+  /* keep at most two generations of the log around */
+  if (g_stat (tap_telemetry_log, &statb) == 0 && statb.st_size >= TAP_TELEMETRY_LOG_MAX)
+    {
+      rotated = g_strconcat (tap_telemetry_log, ".1", NULL);
+      g_rename (tap_telemetry_log, rotated);
+      g_free (rotated);
+    }
+
+  line = g_string_sized_new (256);
+  g_string_append_printf (line, "{\"timestamp\":%" G_GINT64_FORMAT ",\"action\":", record->timestamp);
+  tap_telemetry_append_string (line, record->action);
+  g_string_append (line, ",\"archiver\":");
+  tap_telemetry_append_string (line, record->archiver);
+  g_string_append_printf (line, ",\"input_bytes\":%" G_GUINT64_FORMAT
+                                ",\"latency_us\":%" G_GINT64_FORMAT,
+                          record->input_bytes, record->latency);
+
+  /* jobs either exited or were killed */
+  if (record->signal != 0)
+    g_string_append_printf (line, ",\"signal\":%d", record->signal);
+  else
+    g_string_append_printf (line, ",\"exit_status\":%d", record->exit_code);
+
+  g_string_append_printf (line, ",\"utime_us\":%" G_GINT64_FORMAT
+                                ",\"stime_us\":%" G_GINT64_FORMAT
+                                ",\"maxrss_kb\":%ld}\n",
+                          record->utime, record->stime, record->maxrss);
+
+  /* a single append-mode write keeps lines from concurrent Thunar instances intact */
+  fd = g_open (tap_telemetry_log, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (G_LIKELY (fd >= 0))
+    {
+      if (write (fd, line->str, line->len) < 0)
+        g_debug ("Failed to write job record: %s", g_strerror (errno));
+      close (fd);
+    }
+
+  g_string_free (line, TRUE);
+  g_slice_free (TapJobRecord, record);
+}
+
+
+
+/**
+ * tap_telemetry_shutdown:
+ *
+ * Releases the resources allocated by the telemetry.
+ **/
+void
+tap_telemetry_shutdown (void)
+{
+  /* append the pending records first */
+  if (tap_telemetry_pool != NULL)
+    {
+      g_thread_pool_free (tap_telemetry_pool, FALSE, TRUE);
+      tap_telemetry_pool = NULL;
+    }
+
+  g_free (tap_telemetry_log);
+  tap_telemetry_log = NULL;
+}
+
+
+
+/**
+ * tap_telemetry_record:
+ * @record : the #TapJobRecord of a finished job.
+ *
+ * Stores @record in the ring buffer, and appends it to the log in
+ * $XDG_CACHE_HOME/thunar-archive-plugin/jobs.jsonl on a separate
+ * thread. The log is rotated once it exceeds 1 MiB, so its size
+ * stays bounded.
+ **/
+void
+tap_telemetry_record (const TapJobRecord *record)
+{
+  guint n;
+
+  g_return_if_fail (record != NULL);
+
+  /* store the record, overwriting the oldest one if the ring is full */
+  n = (tap_telemetry_ring_head + tap_telemetry_ring_length) % TAP_TELEMETRY_RING_SIZE;
+  tap_telemetry_ring[n] = *record;
+  if (tap_telemetry_ring_length < TAP_TELEMETRY_RING_SIZE)
+    tap_telemetry_ring_length += 1;
+  else
+    tap_telemetry_ring_head = (tap_telemetry_ring_head + 1) % TAP_TELEMETRY_RING_SIZE;
+
+  /* a single writer keeps the records in order, the strings are interned */
+  if (G_UNLIKELY (tap_telemetry_pool == NULL))
+    tap_telemetry_pool = g_thread_pool_new (tap_telemetry_write, NULL, 1, FALSE, NULL);
+  g_thread_pool_push (tap_telemetry_pool, g_slice_dup (TapJobRecord, record), NULL);
+}
+
+
+
+/**
+ * tap_telemetry_foreach:
+ * @func      : the function to call for every record.
+ * @user_data : the data to pass to @func.
+ *
+ * Calls @func for the records in the ring buffer, oldest first.
+ **/
+void
+tap_telemetry_foreach (TapTelemetryFunc func,
+                       gpointer         user_data)
+{
+  guint n;
+
+  g_return_if_fail (func != NULL);
+
+  for (n = 0; n < tap_telemetry_ring_length; ++n)
+    (*func) (&tap_telemetry_ring[(tap_telemetry_ring_head + n) % TAP_TELEMETRY_RING_SIZE], user_data);
+}
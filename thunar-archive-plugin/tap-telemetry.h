@@ -0,0 +1,83 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_TELEMETRY_H__
+#define __TAP_TELEMETRY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+typedef struct _TapJobRecord TapJobRecord;
+
+/**
+ * TapJobRecord:
+ * @timestamp   : the wall clock time the job finished, in microseconds
+ *                since the epoch.
+ * @action      : the interned action, "create", "extract-here" or
+ *                "extract-to".
+ * @archiver    : the interned id of the archive manager, or "libarchive"
+ *                for in-process jobs.
+ * @input_bytes : the size of the files read by the job.
+ * @latency     : the time from the start of the job to its exit, in
+ *                microseconds.
+ * @exit_code   : the exit code of the job, or %-1 if it was killed by
+ *                a signal or could not be run.
+ * @signal      : the signal that killed the job, or %0.
+ * @utime       : the user CPU time of the job, in microseconds.
+ * @stime       : the system CPU time of the job, in microseconds.
+ * @maxrss      : the peak resident set size of the job, in KiB.
+ *
+ * The measurements of a finished job. Records never contain file
+ * names, so the log can be shared without leaking user data.
+ **/
+struct _TapJobRecord
+{
+  gint64       timestamp;
+  const gchar *action;
+  const gchar *archiver;
+  guint64      input_bytes;
+  gint64       latency;
+  gint         exit_code;
+  gint         signal;
+  gint64       utime;
+  gint64       stime;
+  glong        maxrss;
+};
+
+/**
+ * TapTelemetryFunc:
+ * @record    : a #TapJobRecord.
+ * @user_data : the data passed to tap_telemetry_foreach().
+ *
+ * Called for every record in the ring buffer.
+ **/
+typedef void (*TapTelemetryFunc) (const TapJobRecord *record,
+                                  gpointer            user_data);
+
+void tap_telemetry_shutdown (void) G_GNUC_INTERNAL;
+
+void tap_telemetry_record   (const TapJobRecord *record) G_GNUC_INTERNAL;
+void tap_telemetry_foreach  (TapTelemetryFunc    func,
+                             gpointer            user_data) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_TELEMETRY_H__ */
@@ -0,0 +1,92 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_TRACE_H__
+#define __TAP_TRACE_H__
+
+#include <glib.h>
+
+#ifdef HAVE_TRACING
+#include <sys/sdt.h>
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+#endif
+
+G_BEGIN_DECLS;
+
+/**
+ * TAP_TRACE_SCOPE:
+ * @name : a string literal naming the phase.
+ *
+ * Marks the rest of the enclosing block as the phase @name, which
+ * fires the USDT probes thunar_archive_plugin:phase_begin and
+ * thunar_archive_plugin:phase_end (with the name and the duration
+ * in nanoseconds), and adds a mark to a running sysprof capture.
+ *
+ * Compiles to nothing unless the plugin is built with -Dtracing.
+ * Attach with e.g.
+ *
+ *   bpftrace -e 'usdt:*:thunar_archive_plugin:phase_end
+ *                { @[str(arg0)] = hist(arg1); }' -p $(pidof thunar)
+ **/
+#ifdef HAVE_TRACING
+
+typedef struct
+{
+  const gchar *name;
+  gint64       begin;
+} TapTraceScope;
+
+static inline gint64
+tap_trace_now (void)
+{
+#ifdef HAVE_SYSPROF
+  return SYSPROF_CAPTURE_CURRENT_TIME;
+#else
+  return g_get_monotonic_time () * 1000;
+#endif
+}
+
+static inline void
+tap_trace_scope_end (TapTraceScope *scope)
+{
+  gint64 duration = tap_trace_now () - scope->begin;
+
+  DTRACE_PROBE2 (thunar_archive_plugin, phase_end, scope->name, duration);
+#ifdef HAVE_SYSPROF
+  sysprof_collector_mark (scope->begin, duration, "thunar-archive-plugin", scope->name, NULL);
+#endif
+}
+
+#define TAP_TRACE_SCOPE(name)                                                           \
+  TapTraceScope tap_trace_scope __attribute__ ((cleanup (tap_trace_scope_end))) =       \
+    { (name), tap_trace_now () };                                                       \
+  DTRACE_PROBE1 (thunar_archive_plugin, phase_begin, tap_trace_scope.name)
+
+#else
+
+#define TAP_TRACE_SCOPE(name) G_STMT_START{ (void) 0; }G_STMT_END
+
+#endif
+
+G_END_DECLS;
+
+#endif /* !__TAP_TRACE_H__ */
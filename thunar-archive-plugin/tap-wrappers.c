@@ -0,0 +1,517 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <thunar-archive-plugin/tap-trace.h>
+#include <thunar-archive-plugin/tap-wrappers.h>
+
+
+
+/* the benchmarks point this to a folder with synthetic wrappers */
+#ifndef TAP_WRAPPERS_DIR
+#define TAP_WRAPPERS_DIR LIBEXECDIR G_DIR_SEPARATOR_S "thunar-archive-plugin"
+#endif
+
+
+
+static void                   tap_wrappers_free           (gpointer           data);
+static TapWrapperCapabilities tap_wrappers_capabilities   (gchar            **words);
+static void                   tap_wrappers_add_script     (const gchar       *name);
+static void                   tap_wrappers_add_descriptor (const gchar       *name);
+static gchar                 *tap_wrappers_expand         (const gchar       *template,
+                                                           const gchar       *folder,
+                                                           GStringChunk      *strings);
+static void                   tap_wrappers_scan           (void);
+static gboolean               tap_wrappers_rescan_idle    (gpointer           user_data);
+static void                   tap_wrappers_changed        (GFileMonitor      *monitor,
+                                                           GFile             *file,
+                                                           GFile             *other_file,
+                                                           GFileMonitorEvent  event_type,
+                                                           gpointer           user_data);
+
+
+
+/* maps the basename of a .desktop file (without the extension) to the
+ * .tapd descriptor or the executable .tap wrapper, with symlinks resolved,
+ * and its capabilities. The wrappers are owned by the list, since the
+ * aliases of a descriptor share it.
+ */
+static GHashTable   *tap_wrappers = NULL;
+static GPtrArray    *tap_wrappers_list = NULL;
+static GFileMonitor *tap_wrappers_monitor = NULL;
+static guint         tap_wrappers_rescan_id = 0;
+
+
+
+static void
+tap_wrappers_free (gpointer data)
+{
+  TapWrapper *wrapper = data;
+
+  if (wrapper->actions != NULL)
+    g_hash_table_destroy (wrapper->actions);
+  g_free (wrapper->filename);
+  g_slice_free (TapWrapper, wrapper);
+}
+
+
+
+static TapWrapperCapabilities
+tap_wrappers_capabilities (gchar **words)
+{
+  TapWrapperCapabilities capabilities = 0;
+  guint                  n;
+
+  for (n = 0; words != NULL && words[n] != NULL; ++n)
+    {
+      if (strcmp (words[n], "file-list-stdin") == 0)
+        capabilities |= TAP_WRAPPER_FILE_LIST_STDIN;
+      else if (strcmp (words[n], "multi-file") == 0)
+        capabilities |= TAP_WRAPPER_MULTI_FILE;
+      else if (strcmp (words[n], "progress") == 0)
+        capabilities |= TAP_WRAPPER_PROGRESS;
+      else if (strcmp (words[n], "destination") == 0)
+        capabilities |= TAP_WRAPPER_DESTINATION;
+    }
+
+  return capabilities;
+}
+
+
+
+static void
+tap_wrappers_add_script (const gchar *name)
+{
+  TapWrapper *wrapper;
+  gchar     **lines;
+  gchar     **words;
+  gchar      *contents;
+  gchar      *filename;
+  gchar      *resolved;
+  gchar      *target;
+  guint       n;
+
+  /* resolve symlinks like org.gnome.FileRoller.tap to their targets */
+  filename = g_build_filename (TAP_WRAPPERS_DIR, name, NULL);
+  resolved = realpath (filename, NULL);
+  target = (resolved != NULL) ? g_strdup (resolved) : NULL;
+  free (resolved);
+  g_free (filename);
+
+  /* only executable wrappers are usable */
+  if (G_UNLIKELY (target == NULL || !g_file_test (target, G_FILE_TEST_IS_EXECUTABLE)))
+    {
+      g_free (target);
+      return;
+    }
+
+  /* scripts take all files in "$@" */
+  wrapper = g_slice_new0 (TapWrapper);
+  wrapper->filename = target;
+  wrapper->capabilities = TAP_WRAPPER_MULTI_FILE;
+
+  /* look for the "# TAP-Capabilities: ..." comment in the script */
+  if (g_file_get_contents (target, &contents, NULL, NULL))
+    {
+      lines = g_strsplit (contents, "\n", -1);
+      for (n = 0; lines[n] != NULL; ++n)
+        {
+          if (!g_str_has_prefix (lines[n], "# TAP-Capabilities:"))
+            continue;
+
+          words = g_strsplit_set (lines[n] + 19, " \t,;", -1);
+          wrapper->capabilities |= tap_wrappers_capabilities (words);
+          g_strfreev (words);
+        }
+
+      g_strfreev (lines);
+      g_free (contents);
+    }
+
+  g_ptr_array_add (tap_wrappers_list, wrapper);
+  g_hash_table_replace (tap_wrappers, g_strndup (name, strlen (name) - 4), wrapper);
+}
+
+
+
+static void
+tap_wrappers_add_descriptor (const gchar *name)
+{
+  TapWrapper *wrapper;
+  TapWrapper *script;
+  GKeyFile   *key_file;
+  GError     *error = NULL;
+  gchar     **aliases;
+  gchar     **groups;
+  gchar     **words;
+  gchar     **argv;
+  gchar      *filename;
+  gchar      *exec;
+  gchar      *key;
+  guint       n;
+
+  filename = g_build_filename (TAP_WRAPPERS_DIR, name, NULL);
+  key_file = g_key_file_new ();
+  if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, &error))
+    {
+      g_warning ("Failed to load descriptor %s: %s", filename, error->message);
+      g_error_free (error);
+      g_key_file_free (key_file);
+      g_free (filename);
+      return;
+    }
+  g_free (filename);
+
+  /* skip descriptors of archive managers that are not installed */
+  exec = g_key_file_get_string (key_file, "Wrapper", "Exec", NULL);
+  filename = (exec != NULL) ? g_find_program_in_path (exec) : NULL;
+  g_free (exec);
+  if (filename == NULL)
+    {
+      g_key_file_free (key_file);
+      return;
+    }
+
+  wrapper = g_slice_new0 (TapWrapper);
+  wrapper->filename = filename;
+  wrapper->actions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_strfreev);
+
+  words = g_key_file_get_string_list (key_file, "Wrapper", "Capabilities", NULL, NULL);
+  wrapper->capabilities = tap_wrappers_capabilities (words);
+  g_strfreev (words);
+
+  /* the argv templates of the "[Action <name>]" groups */
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (n = 0; groups[n] != NULL; ++n)
+    {
+      if (!g_str_has_prefix (groups[n], "Action "))
+        continue;
+
+      argv = g_key_file_get_string_list (key_file, groups[n], "Argv", NULL, NULL);
+      if (G_LIKELY (argv != NULL))
+        g_hash_table_replace (wrapper->actions, g_strdup (groups[n] + 7), argv);
+    }
+  g_strfreev (groups);
+
+  g_ptr_array_add (tap_wrappers_list, wrapper);
+
+  /* register the descriptor in place of the scripts for the same desktop ids */
+  aliases = g_key_file_get_string_list (key_file, "Wrapper", "Aliases", NULL, NULL);
+  key = g_strndup (name, strlen (name) - 5);
+  for (n = 0; key != NULL; ++n)
+    {
+      script = g_hash_table_lookup (tap_wrappers, key);
+      if (script != NULL && script->actions == NULL && wrapper->fallback == NULL)
+        wrapper->fallback = script;
+      g_hash_table_replace (tap_wrappers, key, wrapper);
+
+      key = (aliases != NULL && aliases[n] != NULL) ? g_strdup (aliases[n]) : NULL;
+    }
+  g_strfreev (aliases);
+
+  g_key_file_free (key_file);
+}
+
+
+
+static gchar*
+tap_wrappers_expand (const gchar  *template,
+                     const gchar  *folder,
+                     GStringChunk *strings)
+{
+  const gchar *p;
+  GString     *string;
+  gchar       *result;
+
+  /* expand %d to the folder, and %% to a percent sign */
+  string = g_string_sized_new (strlen (template) + strlen (folder));
+  for (p = template; *p != '\0'; ++p)
+    {
+      if (p[0] == '%' && p[1] == 'd')
+        {
+          g_string_append (string, folder);
+          ++p;
+        }
+      else if (p[0] == '%' && p[1] == '%')
+        {
+          g_string_append_c (string, '%');
+          ++p;
+        }
+      else
+        {
+          g_string_append_c (string, *p);
+        }
+    }
+
+  result = g_string_chunk_insert_len (strings, string->str, string->len);
+  g_string_free (string, TRUE);
+
+  return result;
+}
+
+
+
+static void
+tap_wrappers_scan (void)
+{
+  const gchar *name;
+  GDir        *dir;
+
+  g_hash_table_remove_all (tap_wrappers);
+  g_ptr_array_set_size (tap_wrappers_list, 0);
+
+  /* the wrapper directory may be missing, then we just have no wrappers */
+  dir = g_dir_open (TAP_WRAPPERS_DIR, 0, NULL);
+  if (G_UNLIKELY (dir == NULL))
+    return;
+
+  /* the .tap scripts first, so the descriptors can replace them */
+  while ((name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_suffix (name, ".tap"))
+      tap_wrappers_add_script (name);
+
+  g_dir_rewind (dir);
+  while ((name = g_dir_read_name (dir)) != NULL)
+    if (g_str_has_suffix (name, ".tapd"))
+      tap_wrappers_add_descriptor (name);
+
+  g_dir_close (dir);
+}
+
+
+
+static gboolean
+tap_wrappers_rescan_idle (gpointer user_data)
+{
+  tap_wrappers_rescan_id = 0;
+
+  if (G_LIKELY (tap_wrappers != NULL))
+    tap_wrappers_scan ();
+
+  return FALSE;
+}
+
+
+
+static void
+tap_wrappers_changed (GFileMonitor      *monitor,
+                      GFile             *file,
+                      GFile             *other_file,
+                      GFileMonitorEvent  event_type,
+                      gpointer           user_data)
+{
+  /* coalesce the bursts of events emitted by package managers */
+  if (tap_wrappers_rescan_id == 0)
+    tap_wrappers_rescan_id = g_idle_add (tap_wrappers_rescan_idle, NULL);
+}
+
+
+
+/**
+ * tap_wrappers_initialize:
+ *
+ * Scans the wrapper directory once and starts monitoring it, so later
+ * lookups only need to consult the in-memory registry.
+ **/
+void
+tap_wrappers_initialize (void)
+{
+  GFile *directory;
+
+  g_return_if_fail (tap_wrappers == NULL);
+
+  tap_wrappers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  tap_wrappers_list = g_ptr_array_new_with_free_func (tap_wrappers_free);
+  tap_wrappers_scan ();
+
+  /* keep the registry up to date when wrappers are (un)installed */
+  directory = g_file_new_for_path (TAP_WRAPPERS_DIR);
+  tap_wrappers_monitor = g_file_monitor_directory (directory, G_FILE_MONITOR_NONE, NULL, NULL);
+  if (G_LIKELY (tap_wrappers_monitor != NULL))
+    g_signal_connect (G_OBJECT (tap_wrappers_monitor), "changed", G_CALLBACK (tap_wrappers_changed), NULL);
+  g_object_unref (directory);
+}
+
+
+
+/**
+ * tap_wrappers_shutdown:
+ *
+ * Releases the wrapper registry.
+ **/
+void
+tap_wrappers_shutdown (void)
+{
+  if (G_LIKELY (tap_wrappers_monitor != NULL))
+    {
+      g_signal_handlers_disconnect_by_func (G_OBJECT (tap_wrappers_monitor), tap_wrappers_changed, NULL);
+      g_file_monitor_cancel (tap_wrappers_monitor);
+      g_clear_object (&tap_wrappers_monitor);
+    }
+
+  if (tap_wrappers_rescan_id != 0)
+    {
+      g_source_remove (tap_wrappers_rescan_id);
+      tap_wrappers_rescan_id = 0;
+    }
+
+  if (G_LIKELY (tap_wrappers != NULL))
+    {
+      g_hash_table_destroy (tap_wrappers);
+      g_ptr_array_free (tap_wrappers_list, TRUE);
+      tap_wrappers = NULL;
+      tap_wrappers_list = NULL;
+    }
+}
+
+
+
+/**
+ * tap_wrappers_lookup:
+ * @mime_application : a #GAppInfo.
+ * @action           : the action to run, or %NULL for any.
+ *
+ * Looks up the wrapper for the @mime_application in the registry,
+ * without touching the file system. Descriptors without a template
+ * for the @action are replaced by the .tap script they shadow.
+ *
+ * Return value: the #TapWrapper, owned by the registry, or %NULL
+ *               if there's no wrapper.
+ **/
+const TapWrapper*
+tap_wrappers_lookup (GAppInfo    *mime_application,
+                     const gchar *action)
+{
+  const TapWrapper *wrapper;
+  const gchar      *desktop_id;
+  const gchar      *base_name;
+  const gchar      *dot;
+  gchar            *key;
+
+  g_return_val_if_fail (G_IS_APP_INFO (mime_application), NULL);
+
+  TAP_TRACE_SCOPE ("wrapper-lookup");
+
+  /* scan on-demand if the registry wasn't set up yet */
+  if (G_UNLIKELY (tap_wrappers == NULL))
+    tap_wrappers_initialize ();
+
+  /* determine the basename of the .desktop file */
+  desktop_id = g_app_info_get_id (mime_application);
+  if (G_UNLIKELY (desktop_id == NULL))
+    return NULL;
+  base_name = strrchr (desktop_id, G_DIR_SEPARATOR);
+  base_name = (base_name != NULL) ? base_name + 1 : desktop_id;
+
+  /* strip the extension */
+  dot = strrchr (base_name, '.');
+  key = (dot != NULL) ? g_strndup (base_name, dot - base_name) : g_strdup (base_name);
+
+  wrapper = g_hash_table_lookup (tap_wrappers, key);
+  g_free (key);
+
+  if (action != NULL && wrapper != NULL && wrapper->actions != NULL
+      && !g_hash_table_contains (wrapper->actions, action))
+    wrapper = wrapper->fallback;
+
+  return wrapper;
+}
+
+
+
+/**
+ * tap_wrapper_argv:
+ * @wrapper : a #TapWrapper.
+ * @action  : the action to run.
+ * @folder  : the folder to run the @action in.
+ * @files   : the files to pass to the @wrapper.
+ * @n_files : the number of @files.
+ * @strings : the #GStringChunk for the expanded arguments.
+ *
+ * Builds the command line for the @action. Scripts are run with the
+ * @action, the @folder and the @files. Descriptors run the archive
+ * manager right away, with the template of the @action, in which
+ * %F expands to the @files, %f to the first of the @files, and %d
+ * in any argument to the @folder.
+ *
+ * The strings in the vector are borrowed from the @wrapper, the
+ * @files or the @strings, so only the vector itself is to be
+ * released with g_free().
+ *
+ * Return value: the argv, or %NULL if the descriptor lacks the @action.
+ **/
+gchar**
+tap_wrapper_argv (const TapWrapper *wrapper,
+                  const gchar      *action,
+                  const gchar      *folder,
+                  gchar           **files,
+                  guint             n_files,
+                  GStringChunk     *strings)
+{
+  gchar **template;
+  gchar **argv;
+  guint   n;
+  guint   i;
+
+  g_return_val_if_fail (wrapper != NULL, NULL);
+  g_return_val_if_fail (action != NULL, NULL);
+
+  if (wrapper->actions == NULL)
+    {
+      argv = g_new (gchar *, 4 + n_files);
+      argv[0] = wrapper->filename;
+      argv[1] = (gchar *) action;
+      argv[2] = (gchar *) folder;
+      memcpy (argv + 3, files, n_files * sizeof (gchar *));
+      argv[3 + n_files] = NULL;
+      return argv;
+    }
+
+  template = g_hash_table_lookup (wrapper->actions, action);
+  if (G_UNLIKELY (template == NULL))
+    return NULL;
+
+  argv = g_new (gchar *, 2 + g_strv_length (template) + n_files);
+  argv[0] = wrapper->filename;
+  for (n = 0, i = 1; template[n] != NULL; ++n)
+    {
+      if (strcmp (template[n], "%F") == 0)
+        {
+          memcpy (argv + i, files, n_files * sizeof (gchar *));
+          i += n_files;
+        }
+      else if (strcmp (template[n], "%f") == 0)
+        {
+          if (G_LIKELY (n_files > 0))
+            argv[i++] = files[0];
+        }
+      else if (strchr (template[n], '%') == NULL)
+        argv[i++] = template[n];
+      else
+        argv[i++] = tap_wrappers_expand (template[n], folder, strings);
+    }
+  argv[i] = NULL;
+
+  return argv;
+}
@@ -0,0 +1,85 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_WRAPPERS_H__
+#define __TAP_WRAPPERS_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS;
+
+/**
+ * TapWrapperCapabilities:
+ * @TAP_WRAPPER_FILE_LIST_STDIN : the wrapper reads a NUL-separated list of
+ *                                files from stdin, if $TAP_FILE_LIST is set
+ *                                to "stdin".
+ * @TAP_WRAPPER_MULTI_FILE      : the wrapper accepts several archives in one
+ *                                command, which all scripts do.
+ * @TAP_WRAPPER_PROGRESS        : the archive manager reports the progress
+ *                                of the job itself.
+ * @TAP_WRAPPER_DESTINATION     : "extract-here" puts the entries right into
+ *                                the folder, without a subfolder of its own,
+ *                                so the plugin decides on the subfolder.
+ *                                Descriptors run "extract-here-subfolder"
+ *                                instead if the plugin could not decide.
+ *
+ * The optional features a wrapper declares in a "TAP-Capabilities:"
+ * comment line in its header, or in the Capabilities key of its
+ * descriptor.
+ **/
+typedef enum /*< flags >*/
+{
+  TAP_WRAPPER_FILE_LIST_STDIN = 1 << 0,
+  TAP_WRAPPER_MULTI_FILE      = 1 << 1,
+  TAP_WRAPPER_PROGRESS        = 1 << 2,
+  TAP_WRAPPER_DESTINATION     = 1 << 3,
+} TapWrapperCapabilities;
+
+typedef struct _TapWrapper TapWrapper;
+
+struct _TapWrapper
+{
+  /* the .tap script, or the archive manager for descriptors */
+  gchar                 *filename;
+  TapWrapperCapabilities capabilities;
+
+  /* descriptors only, maps actions to their argv templates */
+  GHashTable            *actions;
+
+  /* descriptors only, the .tap script of the same archive manager */
+  const TapWrapper      *fallback;
+};
+
+void              tap_wrappers_initialize (void) G_GNUC_INTERNAL;
+void              tap_wrappers_shutdown   (void) G_GNUC_INTERNAL;
+
+const TapWrapper *tap_wrappers_lookup     (GAppInfo         *mime_application,
+                                           const gchar      *action) G_GNUC_INTERNAL;
+
+gchar           **tap_wrapper_argv        (const TapWrapper *wrapper,
+                                           const gchar      *action,
+                                           const gchar      *folder,
+                                           gchar           **files,
+                                           guint             n_files,
+                                           GStringChunk     *strings) G_GNUC_INTERNAL G_GNUC_MALLOC;
+
+G_END_DECLS;
+
+#endif /* !__TAP_WRAPPERS_H__ */
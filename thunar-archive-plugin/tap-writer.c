@@ -0,0 +1,1297 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-arena.h>
+#include <thunar-archive-plugin/tap-buffer-pool.h>
+#include <thunar-archive-plugin/tap-writer.h>
+
+
+
+/* the number of files written at once by tap_writer_submit() */
+#define TAP_WRITER_BATCH 64
+
+/* the buffers for the files in flight; io_uring only submits a batch once it
+ * is full, so the pool must hold a whole batch plus the buffer of the caller,
+ * or tap_writer_acquire() would wait for a batch that is never submitted */
+#define TAP_WRITER_N_BUFFERS (TAP_WRITER_BATCH + 1)
+
+/* the flags of the files created by the writer */
+#define TAP_WRITER_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC)
+
+/* the number of folders kept open, well below the usual limit of 1024 descriptors */
+#define TAP_WRITER_MAX_DIRS 128
+
+/* the number of folders kept in memory, before they go to the journal */
+#define TAP_WRITER_MAX_FOLDERS 4096
+
+/* the size of the chunks the journal is read in */
+#define TAP_WRITER_JOURNAL_CHUNK (64 * 1024)
+
+
+
+typedef struct _TapWriterDir    TapWriterDir;
+typedef struct _TapWriterFile   TapWriterFile;
+typedef struct _TapWriterFolder TapWriterFolder;
+typedef struct _TapWriterRecord TapWriterRecord;
+
+
+
+static void          tap_writer_set_error    (GError         **error,
+                                              const gchar     *pathname,
+                                              gint             saved_errno);
+static TapWriterDir *tap_writer_dir_new      (TapWriter       *writer,
+                                              const gchar     *path,
+                                              gint             fd);
+static void          tap_writer_dir_release  (TapWriter       *writer,
+                                              TapWriterDir    *dir);
+static void          tap_writer_dir_free     (TapWriterDir    *dir);
+static TapWriterDir *tap_writer_parent       (TapWriter       *writer,
+                                              const gchar     *pathname,
+                                              gchar          **basename,
+                                              GError         **error);
+static void          tap_writer_file_free    (TapWriter       *writer,
+                                              TapWriterFile   *file);
+static void          tap_writer_fail         (TapWriter       *writer,
+                                              GError          *error);
+static void          tap_writer_prepare      (TapWriter       *writer);
+static gboolean      tap_writer_spill        (TapWriter       *writer,
+                                              GError         **error);
+static void          tap_writer_apply        (TapWriter       *writer,
+                                              const gchar     *pathname,
+                                              guint            mode,
+                                              gint64           mtime);
+static void          tap_writer_replay       (TapWriter       *writer);
+static void          tap_writer_pool_func    (gpointer         data,
+                                              gpointer         user_data);
+#ifdef HAVE_LIBURING
+static void          tap_writer_complete     (TapWriter       *writer,
+                                              guint            n_submitted);
+static void          tap_writer_run_batch    (TapWriter       *writer);
+#endif
+static gint          tap_writer_compare      (gconstpointer    a,
+                                              gconstpointer    b);
+
+
+
+struct _TapWriter
+{
+  /* the folder everything is written to, all paths are relative to it */
+  TapWriterDir    *root;
+
+  /* the open parent folders by their path, least recently used last */
+  GHashTable      *dirs;
+  GQueue           lru;
+
+  /* the files of tap_writer_submit() in flight, by their path */
+  GHashTable      *queued;
+  gboolean         prepared;
+#ifdef HAVE_LIBURING
+  struct io_uring  ring;
+  gboolean         uring;
+  TapWriterFile   *batch[TAP_WRITER_BATCH];
+  guint            n_batch;
+#endif
+
+  /* the fallback, without io_uring, with the threads granted to the job */
+  GThreadPool     *pool;
+  guint            n_threads;
+  guint            n_pending;
+  guint            max_pending;
+
+  /* the data of the files in flight, which bounds their memory */
+  TapBufferPool   *buffers;
+
+  GMutex           lock;
+  GCond            cond;
+  GError          *error;
+
+  /* the folders whose metadata is applied last, with their paths in the
+   * arena, and the older ones in the journal, an unlinked temporary file */
+  GArray          *folders;
+  TapArena        *arena;
+  gint             journal;
+  guint64          journal_size;
+
+  /* the folders that lose the search permission, which must go deepest first */
+  GArray          *locked;
+};
+
+
+
+struct _TapWriterDir
+{
+  gchar *path;
+  gint   fd;
+
+  /* the files in flight hold references, which keep the folder open */
+  guint  ref_count;
+  GList  link;
+};
+
+struct _TapWriterFile
+{
+  gchar        *pathname;
+  gchar        *basename;
+  TapWriterDir *dir;
+  guint         mode;
+  gint64        mtime;
+  gpointer      data;
+  gsize         length;
+
+  /* the result of the last operation on the file */
+  gint          result;
+  gint          fd;
+};
+
+struct _TapWriterFolder
+{
+  gchar  *pathname;
+  guint   mode;
+  gint64  mtime;
+};
+
+/* the header of a folder in the journal, followed by its path and a nul */
+struct _TapWriterRecord
+{
+  guint32 length;
+  guint32 mode;
+  gint64  mtime;
+};
+
+
+
+static void
+tap_writer_set_error (GError     **error,
+                      const gchar *pathname,
+                      gint         saved_errno)
+{
+  gchar *display_name;
+
+  display_name = g_filename_display_name (pathname);
+  g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+               _("Failed to write \"%s\": %s"), display_name, g_strerror (saved_errno));
+  g_free (display_name);
+}
+
+
+
+static TapWriterDir*
+tap_writer_dir_new (TapWriter   *writer,
+                    const gchar *path,
+                    gint         fd)
+{
+  TapWriterDir *dir;
+
+  dir = g_slice_new0 (TapWriterDir);
+  dir->path = g_strdup (path);
+  dir->fd = fd;
+  dir->ref_count = 1;
+  dir->link.data = dir;
+
+  /* the root is never cached, and never evicted */
+  if (writer->root != NULL)
+    {
+      g_hash_table_insert (writer->dirs, dir->path, dir);
+      g_queue_push_head_link (&writer->lru, &dir->link);
+    }
+
+  return dir;
+}
+
+
+
+static void
+tap_writer_dir_release (TapWriter    *writer,
+                        TapWriterDir *dir)
+{
+  /* the files of the thread pool are released from its threads */
+  g_mutex_lock (&writer->lock);
+  dir->ref_count -= 1;
+  g_mutex_unlock (&writer->lock);
+}
+
+
+
+static void
+tap_writer_dir_free (TapWriterDir *dir)
+{
+  close (dir->fd);
+  g_free (dir->path);
+  g_slice_free (TapWriterDir, dir);
+}
+
+
+
+static TapWriterDir*
+tap_writer_parent (TapWriter   *writer,
+                   const gchar *pathname,
+                   gchar      **basename,
+                   GError     **error)
+{
+  TapWriterDir *dir = NULL;
+  TapWriterDir *parent;
+  GPtrArray    *components;
+  GString      *path;
+  GList        *lp;
+  gchar       **segments;
+  const gchar  *name;
+  gchar        *end;
+  guint         n_components;
+  guint         n;
+  gint          fd;
+
+  /* leading slashes, empty and "." components are dropped */
+  segments = g_strsplit (pathname, "/", -1);
+  components = g_ptr_array_new ();
+  for (n = 0; segments[n] != NULL; ++n)
+    {
+      if (*segments[n] == '\0' || strcmp (segments[n], ".") == 0)
+        continue;
+
+      /* never write outside of the folder */
+      if (G_UNLIKELY (strcmp (segments[n], "..") == 0))
+        {
+          tap_writer_set_error (error, pathname, EPERM);
+          g_ptr_array_free (components, TRUE);
+          g_strfreev (segments);
+          return NULL;
+        }
+
+      g_ptr_array_add (components, segments[n]);
+    }
+
+  n_components = components->len;
+  if (G_UNLIKELY (n_components == 0))
+    {
+      tap_writer_set_error (error, pathname, EINVAL);
+      g_ptr_array_free (components, TRUE);
+      g_strfreev (segments);
+      return NULL;
+    }
+
+  /* look for the deepest parent that is open already */
+  path = g_string_new (NULL);
+  for (n = 0; n + 1 < n_components; ++n)
+    {
+      if (n > 0)
+        g_string_append_c (path, '/');
+      g_string_append (path, g_ptr_array_index (components, n));
+    }
+
+  g_mutex_lock (&writer->lock);
+  for (n = n_components - 1; n > 0; --n)
+    {
+      dir = g_hash_table_lookup (writer->dirs, path->str);
+      if (dir != NULL)
+        break;
+
+      end = strrchr (path->str, '/');
+      g_string_truncate (path, (end != NULL) ? (gsize) (end - path->str) : 0);
+    }
+
+  if (dir != NULL)
+    {
+      dir->ref_count += 1;
+      g_queue_unlink (&writer->lru, &dir->link);
+      g_queue_push_head_link (&writer->lru, &dir->link);
+    }
+  else
+    {
+      dir = writer->root;
+      dir->ref_count += 1;
+    }
+  g_mutex_unlock (&writer->lock);
+
+  /* open the missing folders relative to their parent, creating them on demand */
+  for (; n + 1 < n_components; ++n)
+    {
+      name = g_ptr_array_index (components, n);
+      fd = openat (dir->fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd < 0 && errno == ENOENT)
+        {
+          if (mkdirat (dir->fd, name, 0777) < 0 && errno != EEXIST)
+            {
+              tap_writer_set_error (error, pathname, errno);
+              goto failed;
+            }
+
+          fd = openat (dir->fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+
+      if (G_UNLIKELY (fd < 0))
+        {
+          tap_writer_set_error (error, pathname, errno);
+          goto failed;
+        }
+
+      if (path->len > 0)
+        g_string_append_c (path, '/');
+      g_string_append (path, name);
+
+      parent = dir;
+      g_mutex_lock (&writer->lock);
+      dir = tap_writer_dir_new (writer, path->str, fd);
+      parent->ref_count -= 1;
+      g_mutex_unlock (&writer->lock);
+    }
+
+  /* close the least recently used folders that no file needs anymore */
+  g_mutex_lock (&writer->lock);
+  for (lp = writer->lru.tail; lp != NULL && writer->lru.length > TAP_WRITER_MAX_DIRS; )
+    {
+      parent = lp->data;
+      lp = lp->prev;
+
+      if (parent->ref_count == 0)
+        {
+          g_queue_unlink (&writer->lru, &parent->link);
+          g_hash_table_remove (writer->dirs, parent->path);
+          tap_writer_dir_free (parent);
+        }
+    }
+  g_mutex_unlock (&writer->lock);
+
+  *basename = g_strdup (g_ptr_array_index (components, n_components - 1));
+  g_string_free (path, TRUE);
+  g_ptr_array_free (components, TRUE);
+  g_strfreev (segments);
+
+  return dir;
+
+failed:
+  tap_writer_dir_release (writer, dir);
+  g_string_free (path, TRUE);
+  g_ptr_array_free (components, TRUE);
+  g_strfreev (segments);
+
+  return NULL;
+}
+
+
+
+static void
+tap_writer_file_free (TapWriter     *writer,
+                      TapWriterFile *file)
+{
+  g_mutex_lock (&writer->lock);
+  g_hash_table_remove (writer->queued, file->pathname);
+  g_mutex_unlock (&writer->lock);
+
+  tap_writer_dir_release (writer, file->dir);
+  tap_buffer_pool_release (writer->buffers, file->data);
+  g_free (file->basename);
+  g_free (file->pathname);
+  g_slice_free (TapWriterFile, file);
+}
+
+
+
+static void
+tap_writer_fail (TapWriter *writer,
+                 GError    *error)
+{
+  /* keep the first error, for the next call of the thread that submits */
+  g_mutex_lock (&writer->lock);
+  if (writer->error == NULL)
+    writer->error = error;
+  else
+    g_error_free (error);
+  g_mutex_unlock (&writer->lock);
+}
+
+
+
+static void
+tap_writer_prepare (TapWriter *writer)
+{
+#ifdef HAVE_LIBURING
+  struct io_uring_probe *probe;
+#endif
+
+  writer->prepared = TRUE;
+
+  /* the files in flight never take more than a batch of buffers */
+  writer->buffers = tap_buffer_pool_new (TAP_WRITER_BUFFER_SIZE, TAP_WRITER_N_BUFFERS);
+
+#ifdef HAVE_LIBURING
+  /* opening and closing files needs linux 5.6, and io_uring may be disabled altogether */
+  if (io_uring_queue_init (TAP_WRITER_BATCH, &writer->ring, 0) == 0)
+    {
+      probe = io_uring_get_probe_ring (&writer->ring);
+      writer->uring = (probe != NULL
+                       && io_uring_opcode_supported (probe, IORING_OP_OPENAT)
+                       && io_uring_opcode_supported (probe, IORING_OP_WRITE)
+                       && io_uring_opcode_supported (probe, IORING_OP_CLOSE));
+      if (probe != NULL)
+        io_uring_free_probe (probe);
+
+      if (writer->uring)
+        return;
+
+      io_uring_queue_exit (&writer->ring);
+    }
+#endif
+
+  /* otherwise a few threads hide the latency of the syscalls */
+  writer->max_pending = 4 * writer->n_threads;
+  writer->pool = g_thread_pool_new (tap_writer_pool_func, writer, writer->n_threads, FALSE, NULL);
+}
+
+
+
+static gboolean
+tap_writer_spill (TapWriter *writer,
+                  GError   **error)
+{
+  TapWriterFolder *folder;
+  TapWriterRecord  record;
+  GByteArray      *records;
+  gboolean         succeed;
+  gchar           *path;
+  guint            n;
+
+  if (writer->journal < 0)
+    {
+      /* the journal is never seen, and goes away with the writer */
+      writer->journal = g_file_open_tmp ("tap-XXXXXX", &path, error);
+      if (G_UNLIKELY (writer->journal < 0))
+        return FALSE;
+      g_unlink (path);
+      g_free (path);
+    }
+
+  records = g_byte_array_sized_new (writer->folders->len * (sizeof (record) + 32));
+  for (n = 0; n < writer->folders->len; ++n)
+    {
+      folder = &g_array_index (writer->folders, TapWriterFolder, n);
+
+      record.length = strlen (folder->pathname) + 1;
+      record.mode = folder->mode;
+      record.mtime = folder->mtime;
+      g_byte_array_append (records, (const guint8 *) &record, sizeof (record));
+      g_byte_array_append (records, (const guint8 *) folder->pathname, record.length);
+    }
+
+  succeed = tap_writer_write (writer, writer->journal, records->data, records->len,
+                              writer->journal_size, g_get_tmp_dir (), error);
+  writer->journal_size += records->len;
+  g_byte_array_free (records, TRUE);
+
+  /* the paths of all folders in memory go at once */
+  g_array_set_size (writer->folders, 0);
+  tap_arena_reset (writer->arena);
+
+  return succeed;
+}
+
+
+
+static void
+tap_writer_apply (TapWriter   *writer,
+                  const gchar *pathname,
+                  guint        mode,
+                  gint64       mtime)
+{
+  TapWriterDir    *dir;
+  struct timespec  times[2];
+  struct stat      statb;
+  gchar           *basename;
+
+  dir = tap_writer_parent (writer, pathname, &basename, NULL);
+  if (G_UNLIKELY (dir == NULL))
+    return;
+
+  if (mtime >= 0)
+    {
+      times[0].tv_sec = 0;
+      times[0].tv_nsec = UTIME_OMIT;
+      times[1].tv_sec = mtime;
+      times[1].tv_nsec = 0;
+      utimensat (dir->fd, basename, times, AT_SYMLINK_NOFOLLOW);
+    }
+
+  /* take away the permissions the folder had only for writing into it */
+  if ((mode & S_IRWXU) != S_IRWXU
+      && fstatat (dir->fd, basename, &statb, AT_SYMLINK_NOFOLLOW) == 0
+      && S_ISDIR (statb.st_mode))
+    fchmodat (dir->fd, basename, statb.st_mode & 07777 & ~(S_IRWXU & ~mode), 0);
+
+  tap_writer_dir_release (writer, dir);
+  g_free (basename);
+}
+
+
+
+static void
+tap_writer_replay (TapWriter *writer)
+{
+  TapWriterRecord record;
+  guint64         offset = 0;
+  guint8         *buffer;
+  gssize          n;
+  gsize           size = TAP_WRITER_JOURNAL_CHUNK;
+  gsize           filled = 0;
+  gsize           start;
+
+  buffer = g_malloc (size);
+
+  while (offset < writer->journal_size)
+    {
+      n = pread (writer->journal, buffer + filled, size - filled, offset);
+      if (G_UNLIKELY (n <= 0))
+        {
+          if (n < 0 && errno == EINTR)
+            continue;
+          break;
+        }
+
+      offset += n;
+      filled += n;
+
+      /* apply the folders that are complete in the buffer */
+      for (start = 0; start + sizeof (record) <= filled; start += sizeof (record) + record.length)
+        {
+          memcpy (&record, buffer + start, sizeof (record));
+          if (start + sizeof (record) + record.length > filled)
+            break;
+
+          tap_writer_apply (writer, (const gchar *) buffer + start + sizeof (record), record.mode, record.mtime);
+        }
+
+      /* keep the partial folder, growing the buffer for very long paths */
+      start = MIN (start, filled);
+      memmove (buffer, buffer + start, filled - start);
+      filled -= start;
+      if (G_UNLIKELY (filled == size))
+        {
+          size *= 2;
+          buffer = g_realloc (buffer, size);
+        }
+    }
+
+  g_free (buffer);
+}
+
+
+
+static void
+tap_writer_pool_func (gpointer data,
+                      gpointer user_data)
+{
+  TapWriterFile *file = data;
+  TapWriter     *writer = user_data;
+  GError        *error = NULL;
+  gint           fd;
+
+  fd = openat (file->dir->fd, file->basename, TAP_WRITER_OPEN_FLAGS, file->mode);
+  if (G_UNLIKELY (fd < 0))
+    tap_writer_set_error (&error, file->pathname, errno);
+  else if (!tap_writer_write (writer, fd, file->data, file->length, 0, file->pathname, &error))
+    close (fd);
+  else
+    tap_writer_close (writer, fd, file->mtime, file->pathname, &error);
+
+  if (G_UNLIKELY (error != NULL))
+    tap_writer_fail (writer, error);
+
+  tap_writer_file_free (writer, file);
+
+  g_mutex_lock (&writer->lock);
+  writer->n_pending -= 1;
+  g_cond_broadcast (&writer->cond);
+  g_mutex_unlock (&writer->lock);
+}
+
+
+
+#ifdef HAVE_LIBURING
+static void
+tap_writer_complete (TapWriter *writer,
+                     guint      n_submitted)
+{
+  struct io_uring_cqe *cqe;
+  TapWriterFile       *file;
+  guint                n;
+
+  /* a single syscall submits the operations and waits for all of them */
+  while (io_uring_submit_and_wait (&writer->ring, n_submitted) == -EINTR)
+    ;
+
+  for (n = 0; n < n_submitted; ++n)
+    {
+      while (io_uring_wait_cqe (&writer->ring, &cqe) == -EINTR)
+        ;
+
+      file = io_uring_cqe_get_data (cqe);
+      file->result = cqe->res;
+      io_uring_cqe_seen (&writer->ring, cqe);
+    }
+}
+
+
+
+static void
+tap_writer_run_batch (TapWriter *writer)
+{
+  struct io_uring_sqe *sqe;
+  struct timespec      times[2];
+  TapWriterFile       *file;
+  GError              *error = NULL;
+  guint                n_submitted;
+  guint                n;
+
+  /* open all files at once */
+  for (n = 0; n < writer->n_batch; ++n)
+    {
+      file = writer->batch[n];
+      sqe = io_uring_get_sqe (&writer->ring);
+      io_uring_prep_openat (sqe, file->dir->fd, file->basename, TAP_WRITER_OPEN_FLAGS, file->mode);
+      io_uring_sqe_set_data (sqe, file);
+    }
+  tap_writer_complete (writer, writer->n_batch);
+
+  /* write the files that were opened */
+  for (n = 0, n_submitted = 0; n < writer->n_batch; ++n)
+    {
+      file = writer->batch[n];
+      file->fd = file->result;
+      if (G_UNLIKELY (file->fd < 0))
+        {
+          tap_writer_set_error (&error, file->pathname, -file->fd);
+          tap_writer_fail (writer, error);
+          error = NULL;
+        }
+      else if (file->length > 0)
+        {
+          sqe = io_uring_get_sqe (&writer->ring);
+          io_uring_prep_write (sqe, file->fd, file->data, file->length, 0);
+          io_uring_sqe_set_data (sqe, file);
+          n_submitted += 1;
+        }
+      else
+        {
+          file->result = 0;
+        }
+    }
+  tap_writer_complete (writer, n_submitted);
+
+  /* set the times once the data is written, and close the files at once */
+  for (n = 0, n_submitted = 0; n < writer->n_batch; ++n)
+    {
+      file = writer->batch[n];
+      if (file->fd < 0)
+        continue;
+
+      /* finish short writes synchronously */
+      if (G_UNLIKELY (file->result < 0))
+        {
+          tap_writer_set_error (&error, file->pathname, -file->result);
+          tap_writer_fail (writer, error);
+          error = NULL;
+        }
+      else if (G_UNLIKELY ((gsize) file->result < file->length)
+               && !tap_writer_write (writer, file->fd, (guint8 *) file->data + file->result,
+                                     file->length - file->result, file->result, file->pathname, &error))
+        {
+          tap_writer_fail (writer, error);
+          error = NULL;
+        }
+      else if (file->mtime >= 0)
+        {
+          /* io_uring has no operation for this */
+          times[0].tv_sec = 0;
+          times[0].tv_nsec = UTIME_OMIT;
+          times[1].tv_sec = file->mtime;
+          times[1].tv_nsec = 0;
+          futimens (file->fd, times);
+        }
+
+      sqe = io_uring_get_sqe (&writer->ring);
+      io_uring_prep_close (sqe, file->fd);
+      io_uring_sqe_set_data (sqe, file);
+      n_submitted += 1;
+    }
+  tap_writer_complete (writer, n_submitted);
+
+  for (n = 0; n < writer->n_batch; ++n)
+    {
+      file = writer->batch[n];
+
+      /* network filesystems report write errors on close */
+      if (G_UNLIKELY (file->fd >= 0 && file->result < 0))
+        {
+          tap_writer_set_error (&error, file->pathname, -file->result);
+          tap_writer_fail (writer, error);
+          error = NULL;
+        }
+
+      tap_writer_file_free (writer, file);
+    }
+
+  writer->n_batch = 0;
+}
+#endif
+
+
+
+static gint
+tap_writer_compare (gconstpointer a,
+                    gconstpointer b)
+{
+  const TapWriterFolder *fa = a;
+  const TapWriterFolder *fb = b;
+
+  /* subfolders sort after their parents, so reversed they go first */
+  return strcmp (fb->pathname, fa->pathname);
+}
+
+
+
+/**
+ * tap_writer_new:
+ * @folder    : the folder to write to.
+ * @n_threads : the number of threads to write small files on, if
+ *              io_uring is not available.
+ * @error     : return location for errors or %NULL.
+ *
+ * Allocates a writer for the files of an archive, which are written
+ * below @folder. All paths passed to the writer are relative to the
+ * @folder, and the writer refuses to follow "..", or symlinks in the
+ * folders below @folder, so archives cannot write outside of it.
+ *
+ * The writer keeps the recently used folders open, and creates all
+ * entries relative to their parent folder, so the kernel does not
+ * resolve the whole path of every entry again.
+ *
+ * The files of tap_writer_open() may be written from several threads
+ * at once, but tap_writer_mkdir(), tap_writer_submit(), tap_writer_flush()
+ * and tap_writer_finish() must all be called from the same thread.
+ *
+ * Return value: the #TapWriter, or %NULL on error.
+ **/
+TapWriter*
+tap_writer_new (const gchar *folder,
+                guint        n_threads,
+                GError     **error)
+{
+  TapWriter *writer;
+  gint       fd;
+
+  g_return_val_if_fail (g_path_is_absolute (folder), NULL);
+
+  fd = open (folder, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (G_UNLIKELY (fd < 0))
+    {
+      tap_writer_set_error (error, folder, errno);
+      return NULL;
+    }
+
+  writer = g_slice_new0 (TapWriter);
+  writer->root = tap_writer_dir_new (writer, folder, fd);
+  writer->n_threads = MAX (n_threads, 1);
+  writer->dirs = g_hash_table_new (g_str_hash, g_str_equal);
+  writer->queued = g_hash_table_new (g_str_hash, g_str_equal);
+  writer->folders = g_array_new (FALSE, FALSE, sizeof (TapWriterFolder));
+  writer->arena = tap_arena_new (TAP_WRITER_JOURNAL_CHUNK);
+  writer->journal = -1;
+  writer->locked = g_array_new (FALSE, FALSE, sizeof (TapWriterFolder));
+  g_mutex_init (&writer->lock);
+  g_cond_init (&writer->cond);
+
+  return writer;
+}
+
+
+
+/**
+ * tap_writer_free:
+ * @writer : a #TapWriter.
+ *
+ * Waits for the files submitted to the @writer, and releases it.
+ **/
+void
+tap_writer_free (TapWriter *writer)
+{
+  guint n;
+
+  tap_writer_flush (writer, NULL);
+
+#ifdef HAVE_LIBURING
+  if (writer->uring)
+    io_uring_queue_exit (&writer->ring);
+#endif
+  if (writer->pool != NULL)
+    g_thread_pool_free (writer->pool, FALSE, TRUE);
+
+  if (writer->buffers != NULL)
+    tap_buffer_pool_free (writer->buffers);
+
+  g_array_free (writer->folders, TRUE);
+  tap_arena_free (writer->arena);
+  if (writer->journal >= 0)
+    close (writer->journal);
+
+  for (n = 0; n < writer->locked->len; ++n)
+    g_free (g_array_index (writer->locked, TapWriterFolder, n).pathname);
+  g_array_free (writer->locked, TRUE);
+
+  while (!g_queue_is_empty (&writer->lru))
+    tap_writer_dir_free (g_queue_pop_head_link (&writer->lru)->data);
+  g_hash_table_destroy (writer->dirs);
+  tap_writer_dir_free (writer->root);
+
+  g_hash_table_destroy (writer->queued);
+  g_mutex_clear (&writer->lock);
+  g_cond_clear (&writer->cond);
+  g_slice_free (TapWriter, writer);
+}
+
+
+
+/**
+ * tap_writer_mkdir:
+ * @writer   : a #TapWriter.
+ * @pathname : the relative path of the folder.
+ * @mode     : the permissions of the folder, before the umask.
+ * @mtime    : the modification time in seconds, or %-1 to keep it.
+ * @error    : return location for errors or %NULL.
+ *
+ * Creates the folder @pathname, and its parents as needed. Folders
+ * that exist already are fine. The folder stays writable, and gets
+ * its @mode and @mtime in tap_writer_finish(), once all files in it
+ * are written. Past a few thousand folders, they wait for that in a
+ * temporary journal, so the memory does not grow with the archive.
+ *
+ * Return value: %TRUE if the folder exists now.
+ **/
+gboolean
+tap_writer_mkdir (TapWriter   *writer,
+                  const gchar *pathname,
+                  guint        mode,
+                  gint64       mtime,
+                  GError     **error)
+{
+  TapWriterFolder folder;
+  gboolean        succeed = TRUE;
+  TapWriterDir   *dir;
+  gchar          *basename;
+
+  dir = tap_writer_parent (writer, pathname, &basename, error);
+  if (G_UNLIKELY (dir == NULL))
+    return FALSE;
+
+  if (mkdirat (dir->fd, basename, mode | S_IRWXU) < 0 && errno != EEXIST)
+    {
+      tap_writer_set_error (error, pathname, errno);
+      succeed = FALSE;
+    }
+  else if (G_UNLIKELY ((mode & S_IXUSR) == 0))
+    {
+      folder.pathname = g_strdup (pathname);
+      folder.mode = mode;
+      folder.mtime = mtime;
+      g_array_append_val (writer->locked, folder);
+    }
+  else if (mtime >= 0 || (mode & S_IRWXU) != S_IRWXU)
+    {
+      folder.pathname = tap_arena_strdup (writer->arena, pathname);
+      folder.mode = mode;
+      folder.mtime = mtime;
+      g_array_append_val (writer->folders, folder);
+
+      if (writer->folders->len >= TAP_WRITER_MAX_FOLDERS)
+        succeed = tap_writer_spill (writer, error);
+    }
+
+  tap_writer_dir_release (writer, dir);
+  g_free (basename);
+
+  return succeed;
+}
+
+
+
+/**
+ * tap_writer_open:
+ * @writer   : a #TapWriter.
+ * @pathname : the relative path of the file.
+ * @mode     : the permissions of the file, before the umask.
+ * @error    : return location for errors or %NULL.
+ *
+ * Creates the file @pathname, and its parent folders as needed, for
+ * tap_writer_write(). Existing files are truncated, but symlinks are
+ * never followed.
+ *
+ * Return value: the file descriptor, to be closed with
+ *               tap_writer_close(), or %-1 on error.
+ **/
+gint
+tap_writer_open (TapWriter   *writer,
+                 const gchar *pathname,
+                 guint        mode,
+                 GError     **error)
+{
+  TapWriterDir *dir;
+  gchar        *basename;
+  gint          fd;
+
+  dir = tap_writer_parent (writer, pathname, &basename, error);
+  if (G_UNLIKELY (dir == NULL))
+    return -1;
+
+  fd = openat (dir->fd, basename, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, mode);
+  if (G_UNLIKELY (fd < 0))
+    tap_writer_set_error (error, pathname, errno);
+
+  tap_writer_dir_release (writer, dir);
+  g_free (basename);
+
+  return fd;
+}
+
+
+
+/**
+ * tap_writer_write:
+ * @writer   : a #TapWriter.
+ * @fd       : a file descriptor from tap_writer_open().
+ * @data     : the data to write.
+ * @length   : the number of bytes in @data.
+ * @offset   : the position in the file to write the @data to.
+ * @pathname : the relative path of the file, for errors.
+ * @error    : return location for errors or %NULL.
+ *
+ * Writes @data at @offset in the file, with positioned writes, so
+ * several threads may write to different parts of a file at once.
+ *
+ * Return value: %TRUE if all @data was written.
+ **/
+gboolean
+tap_writer_write (TapWriter    *writer,
+                  gint          fd,
+                  gconstpointer data,
+                  gsize         length,
+                  guint64       offset,
+                  const gchar  *pathname,
+                  GError      **error)
+{
+  const guint8 *p = data;
+  gssize        n;
+
+  while (length > 0)
+    {
+      n = pwrite (fd, p, length, offset);
+      if (G_UNLIKELY (n < 0))
+        {
+          if (errno == EINTR)
+            continue;
+          tap_writer_set_error (error, pathname, errno);
+          return FALSE;
+        }
+
+      p += n;
+      length -= n;
+      offset += n;
+    }
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_writer_close:
+ * @writer   : a #TapWriter.
+ * @fd       : a file descriptor from tap_writer_open().
+ * @mtime    : the modification time in seconds, or %-1 to keep it.
+ * @pathname : the relative path of the file, for errors.
+ * @error    : return location for errors or %NULL.
+ *
+ * Sets the modification time of the file and closes @fd, which is
+ * closed even on errors.
+ *
+ * Return value: %TRUE if the file was closed without errors.
+ **/
+gboolean
+tap_writer_close (TapWriter   *writer,
+                  gint         fd,
+                  gint64       mtime,
+                  const gchar *pathname,
+                  GError     **error)
+{
+  struct timespec times[2];
+
+  if (mtime >= 0)
+    {
+      times[0].tv_sec = 0;
+      times[0].tv_nsec = UTIME_OMIT;
+      times[1].tv_sec = mtime;
+      times[1].tv_nsec = 0;
+      futimens (fd, times);
+    }
+
+  /* network filesystems report write errors on close */
+  if (G_UNLIKELY (close (fd) < 0))
+    {
+      tap_writer_set_error (error, pathname, errno);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_writer_acquire:
+ * @writer : a #TapWriter.
+ *
+ * Takes a buffer of %TAP_WRITER_BUFFER_SIZE bytes for the contents of
+ * a small file, to be passed to tap_writer_submit(). The buffers come
+ * from a fixed pool, so this waits while all of them are in flight.
+ *
+ * Return value: the buffer.
+ **/
+gpointer
+tap_writer_acquire (TapWriter *writer)
+{
+  if (G_UNLIKELY (!writer->prepared))
+    tap_writer_prepare (writer);
+
+  return tap_buffer_pool_acquire (writer->buffers);
+}
+
+
+
+/**
+ * tap_writer_release:
+ * @writer : a #TapWriter.
+ * @buffer : a buffer from tap_writer_acquire().
+ *
+ * Returns a @buffer that is not submitted after all.
+ **/
+void
+tap_writer_release (TapWriter *writer,
+                    gpointer   buffer)
+{
+  tap_buffer_pool_release (writer->buffers, buffer);
+}
+
+
+
+/**
+ * tap_writer_submit:
+ * @writer   : a #TapWriter.
+ * @pathname : the relative path of the file.
+ * @mode     : the permissions of the file, before the umask.
+ * @mtime    : the modification time in seconds, or %-1 to keep it.
+ * @data     : the contents of the file, from tap_writer_acquire().
+ * @length   : the length of @data.
+ * @error    : return location for errors or %NULL.
+ *
+ * Queues the small file @pathname, which takes over @data. The files
+ * are written in batches through io_uring, which creates, writes and
+ * closes a whole batch in one syscall each, or by a pool of threads
+ * where io_uring is not available. Errors of the queued files are
+ * reported by a later call, or by tap_writer_flush().
+ *
+ * Return value: %FALSE if writing a file failed.
+ **/
+gboolean
+tap_writer_submit (TapWriter   *writer,
+                   const gchar *pathname,
+                   guint        mode,
+                   gint64       mtime,
+                   gpointer     data,
+                   gsize        length,
+                   GError     **error)
+{
+  TapWriterFile *file;
+  gboolean       queued;
+
+  /* a file that is in flight already is written again once it is done */
+  g_mutex_lock (&writer->lock);
+  queued = g_hash_table_contains (writer->queued, pathname);
+  g_mutex_unlock (&writer->lock);
+  if (G_UNLIKELY (queued) && !tap_writer_flush (writer, error))
+    {
+      tap_buffer_pool_release (writer->buffers, data);
+      return FALSE;
+    }
+
+  file = g_slice_new0 (TapWriterFile);
+  file->dir = tap_writer_parent (writer, pathname, &file->basename, error);
+  if (G_UNLIKELY (file->dir == NULL))
+    {
+      g_slice_free (TapWriterFile, file);
+      tap_buffer_pool_release (writer->buffers, data);
+      return FALSE;
+    }
+
+  file->pathname = g_strdup (pathname);
+  file->mode = mode;
+  file->mtime = mtime;
+  file->data = data;
+  file->length = length;
+  file->fd = -1;
+
+  g_mutex_lock (&writer->lock);
+  g_hash_table_add (writer->queued, file->pathname);
+
+#ifdef HAVE_LIBURING
+  if (writer->uring)
+    {
+      g_mutex_unlock (&writer->lock);
+
+      writer->batch[writer->n_batch++] = file;
+      if (writer->n_batch < TAP_WRITER_BATCH)
+        return TRUE;
+
+      tap_writer_run_batch (writer);
+
+      g_mutex_lock (&writer->lock);
+    }
+  else
+#endif
+    {
+      /* bound the files that wait for the threads */
+      while (writer->n_pending >= writer->max_pending)
+        g_cond_wait (&writer->cond, &writer->lock);
+
+      writer->n_pending += 1;
+      g_thread_pool_push (writer->pool, file, NULL);
+    }
+
+  /* report the errors of earlier files */
+  if (G_UNLIKELY (writer->error != NULL))
+    {
+      g_propagate_error (error, writer->error);
+      writer->error = NULL;
+      g_mutex_unlock (&writer->lock);
+      return FALSE;
+    }
+
+  g_mutex_unlock (&writer->lock);
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_writer_flush:
+ * @writer : a #TapWriter.
+ * @error  : return location for errors or %NULL.
+ *
+ * Waits until all files of tap_writer_submit() are written, which is
+ * needed before anything else may rely on them, like hardlinks.
+ *
+ * Return value: %FALSE if writing a file failed.
+ **/
+gboolean
+tap_writer_flush (TapWriter *writer,
+                  GError   **error)
+{
+#ifdef HAVE_LIBURING
+  if (writer->uring && writer->n_batch > 0)
+    tap_writer_run_batch (writer);
+#endif
+
+  g_mutex_lock (&writer->lock);
+
+  while (writer->n_pending > 0)
+    g_cond_wait (&writer->cond, &writer->lock);
+
+  if (G_UNLIKELY (writer->error != NULL))
+    {
+      g_propagate_error (error, writer->error);
+      writer->error = NULL;
+      g_mutex_unlock (&writer->lock);
+      return FALSE;
+    }
+
+  g_mutex_unlock (&writer->lock);
+
+  return TRUE;
+}
+
+
+
+/**
+ * tap_writer_finish:
+ * @writer : a #TapWriter.
+ * @error  : return location for errors or %NULL.
+ *
+ * Waits for the files of tap_writer_submit(), and applies the
+ * permissions and times of the folders of tap_writer_mkdir(). The
+ * folders that lose the search permission go last, the deepest first.
+ * Errors of the folders are ignored, like the times of files.
+ *
+ * Return value: %FALSE if writing a file failed.
+ **/
+gboolean
+tap_writer_finish (TapWriter *writer,
+                   GError   **error)
+{
+  TapWriterFolder *folder;
+  guint            n;
+
+  if (!tap_writer_flush (writer, error))
+    return FALSE;
+
+  /* the order does not matter while the folders stay searchable */
+  if (writer->journal >= 0)
+    tap_writer_replay (writer);
+
+  for (n = 0; n < writer->folders->len; ++n)
+    {
+      folder = &g_array_index (writer->folders, TapWriterFolder, n);
+      tap_writer_apply (writer, folder->pathname, folder->mode, folder->mtime);
+    }
+
+  g_array_sort (writer->locked, tap_writer_compare);
+
+  for (n = 0; n < writer->locked->len; ++n)
+    {
+      folder = &g_array_index (writer->locked, TapWriterFolder, n);
+      tap_writer_apply (writer, folder->pathname, folder->mode, folder->mtime);
+    }
+
+  return TRUE;
+}
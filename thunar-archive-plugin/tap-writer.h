@@ -0,0 +1,77 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_WRITER_H__
+#define __TAP_WRITER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS;
+
+/* the size of the files for tap_writer_submit() */
+#define TAP_WRITER_BUFFER_SIZE (256 * 1024)
+
+typedef struct _TapWriter TapWriter;
+
+TapWriter *tap_writer_new     (const gchar  *folder,
+                               guint         n_threads,
+                               GError      **error) G_GNUC_INTERNAL G_GNUC_MALLOC;
+void       tap_writer_free    (TapWriter    *writer) G_GNUC_INTERNAL;
+
+gboolean   tap_writer_mkdir   (TapWriter    *writer,
+                               const gchar  *pathname,
+                               guint         mode,
+                               gint64        mtime,
+                               GError      **error) G_GNUC_INTERNAL;
+gint       tap_writer_open    (TapWriter    *writer,
+                               const gchar  *pathname,
+                               guint         mode,
+                               GError      **error) G_GNUC_INTERNAL;
+gboolean   tap_writer_write   (TapWriter    *writer,
+                               gint          fd,
+                               gconstpointer data,
+                               gsize         length,
+                               guint64       offset,
+                               const gchar  *pathname,
+                               GError      **error) G_GNUC_INTERNAL;
+gboolean   tap_writer_close   (TapWriter    *writer,
+                               gint          fd,
+                               gint64        mtime,
+                               const gchar  *pathname,
+                               GError      **error) G_GNUC_INTERNAL;
+
+gpointer   tap_writer_acquire (TapWriter    *writer) G_GNUC_INTERNAL;
+void       tap_writer_release (TapWriter    *writer,
+                               gpointer      buffer) G_GNUC_INTERNAL;
+gboolean   tap_writer_submit  (TapWriter    *writer,
+                               const gchar  *pathname,
+                               guint         mode,
+                               gint64        mtime,
+                               gpointer      data,
+                               gsize         length,
+                               GError      **error) G_GNUC_INTERNAL;
+gboolean   tap_writer_flush   (TapWriter    *writer,
+                               GError      **error) G_GNUC_INTERNAL;
+gboolean   tap_writer_finish  (TapWriter    *writer,
+                               GError      **error) G_GNUC_INTERNAL;
+
+G_END_DECLS;
+
+#endif /* !__TAP_WRITER_H__ */
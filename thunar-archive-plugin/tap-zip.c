@@ -0,0 +1,838 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+
+#include <glib/gstdio.h>
+
+#include <libxfce4util/libxfce4util.h>
+
+#include <thunar-archive-plugin/tap-trace.h>
+#include <thunar-archive-plugin/tap-writer.h>
+#endif
+#include <thunar-archive-plugin/tap-zip.h>
+
+
+
+/* the signatures of the zip records */
+#define TAP_ZIP_LOCAL            0x04034b50
+#define TAP_ZIP_CENTRAL          0x02014b50
+#define TAP_ZIP_END              0x06054b50
+#define TAP_ZIP64_END            0x06064b50
+#define TAP_ZIP64_END_LOCATOR    0x07064b50
+
+/* the compression methods inflated in-process */
+#define TAP_ZIP_STORED           0
+#define TAP_ZIP_DEFLATED         8
+
+/* the general purpose flag of encrypted entries */
+#define TAP_ZIP_FLAG_ENCRYPTED   0x0001
+
+/* the size of the input and output buffers of every worker */
+#define TAP_ZIP_BUFFER_SIZE      (1024 * 1024)
+
+/* the largest central directory read for an extraction, larger ones are left to libarchive */
+#define TAP_ZIP_MAX_DIRECTORY    (64 * 1024 * 1024)
+
+/* the number of bytes between two progress reports */
+#define TAP_ZIP_PROGRESS_STEP    (4 * 1024 * 1024)
+
+
+
+#ifdef HAVE_ZLIB
+typedef struct _TapZipJob TapZipJob;
+#endif
+
+
+
+static guint16   tap_zip_u16           (const guchar      *data);
+static guint32   tap_zip_u32           (const guchar      *data);
+static guint64   tap_zip_u64           (const guchar      *data);
+static gboolean  tap_zip_read          (gint               fd,
+                                        gpointer           buffer,
+                                        gsize              length,
+                                        guint64            offset);
+static void      tap_zip_zip64         (const guchar      *extra,
+                                        gsize              length,
+                                        guint64           *size,
+                                        guint64           *compressed_size,
+                                        guint64           *offset);
+#ifdef HAVE_ZLIB
+static gboolean  tap_zip_collect       (const TapZipEntry *entry,
+                                        gpointer           user_data);
+static gint      tap_zip_compare       (gconstpointer      a,
+                                        gconstpointer      b);
+static gint64    tap_zip_mtime         (const TapZipEntry *entry);
+static guint     tap_zip_mode          (const TapZipEntry *entry,
+                                        guint              fallback);
+static void      tap_zip_fail          (TapZipJob         *job,
+                                        GError            *error);
+static void      tap_zip_account       (TapZipJob         *job,
+                                        gsize              length,
+                                        gboolean           report);
+static gboolean  tap_zip_inflate_entry (TapZipJob         *job,
+                                        const TapZipEntry *entry,
+                                        const gchar       *pathname,
+                                        z_stream          *stream,
+                                        guchar            *input,
+                                        guchar            *buffer,
+                                        gboolean           report,
+                                        GError           **error);
+static gpointer  tap_zip_worker        (gpointer           user_data);
+#endif
+
+
+
+#ifdef HAVE_ZLIB
+struct _TapZipJob
+{
+  const gchar       *filename;
+  gint               fd;
+  guint64            length;
+  TapWriter         *writer;
+
+  /* the entries, largest first, claimed one by one by the workers */
+  GArray            *entries;
+  gint               next;
+
+  /* set once a worker failed, the others stop at the next entry */
+  gint               failed;
+
+  /* the thread of the caller, the only one to report the progress */
+  GThread           *caller;
+
+  GMutex             lock;
+  GError            *error;
+  guint64            written;
+  guint64            reported;
+  TapExtractProgress progress;
+  gpointer           user_data;
+
+  /* set if the archive needs libarchive */
+  gboolean           unsupported;
+};
+#endif
+
+
+
+static guint16
+tap_zip_u16 (const guchar *data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+
+
+static guint32
+tap_zip_u32 (const guchar *data)
+{
+  return (guint32) tap_zip_u16 (data) | ((guint32) tap_zip_u16 (data + 2) << 16);
+}
+
+
+
+static guint64
+tap_zip_u64 (const guchar *data)
+{
+  return (guint64) tap_zip_u32 (data) | ((guint64) tap_zip_u32 (data + 4) << 32);
+}
+
+
+
+static gboolean
+tap_zip_read (gint     fd,
+              gpointer buffer,
+              gsize    length,
+              guint64  offset)
+{
+  gssize n;
+
+  /* the archive is read, not mapped, so media that go away fail the read instead of
+   * killing the process; errno is 0 if the archive ends early */
+  for (; length > 0; length -= n, offset += n)
+    {
+      n = pread (fd, buffer, length, offset);
+      if (G_UNLIKELY (n <= 0))
+        {
+          if (n < 0 && errno == EINTR)
+            {
+              n = 0;
+              continue;
+            }
+          if (n == 0)
+            errno = 0;
+          return FALSE;
+        }
+      buffer = (guchar *) buffer + n;
+    }
+
+  return TRUE;
+}
+
+
+
+static void
+tap_zip_zip64 (const guchar *extra,
+               gsize         length,
+               guint64      *size,
+               guint64      *compressed_size,
+               guint64      *offset)
+{
+  guint64 *values[3] = { size, compressed_size, offset };
+  gsize    field_length;
+  gsize    p;
+  gsize    q;
+  guint    n;
+
+  /* the zip64 extra field has the values that did not fit, in a fixed order */
+  for (p = 0; p + 4 <= length; p += 4 + field_length)
+    {
+      field_length = tap_zip_u16 (extra + p + 2);
+      if (p + 4 + field_length > length)
+        return;
+      if (tap_zip_u16 (extra + p) != 0x0001)
+        continue;
+
+      for (n = 0, q = p + 4; n < G_N_ELEMENTS (values); ++n)
+        if (*values[n] == 0xffffffff)
+          {
+            if (q + 8 > p + 4 + field_length)
+              return;
+            *values[n] = tap_zip_u64 (extra + q);
+            q += 8;
+          }
+      return;
+    }
+}
+
+
+
+#ifdef HAVE_ZLIB
+static gboolean
+tap_zip_collect (const TapZipEntry *entry,
+                 gpointer           user_data)
+{
+  TapZipJob *job = user_data;
+
+  /* leave encrypted entries, other methods and symlinks to libarchive */
+  if ((entry->flags & TAP_ZIP_FLAG_ENCRYPTED) != 0
+      || (entry->method != TAP_ZIP_STORED && entry->method != TAP_ZIP_DEFLATED)
+      || (entry->system == 3 && S_ISLNK (entry->attributes >> 16)))
+    {
+      job->unsupported = TRUE;
+      return FALSE;
+    }
+
+  g_array_append_vals (job->entries, entry, 1);
+
+  return TRUE;
+}
+
+
+
+static gint
+tap_zip_compare (gconstpointer a,
+                 gconstpointer b)
+{
+  const TapZipEntry *ea = a;
+  const TapZipEntry *eb = b;
+
+  /* the largest entries go first, so none of them is left for the end */
+  if (ea->compressed_size != eb->compressed_size)
+    return (ea->compressed_size > eb->compressed_size) ? -1 : 1;
+
+  return (ea->offset < eb->offset) ? -1 : (ea->offset > eb->offset);
+}
+
+
+
+static gint64
+tap_zip_mtime (const TapZipEntry *entry)
+{
+  GDateTime *date_time;
+  guint16    date;
+  guint16    time;
+  gint64     mtime;
+  gsize      field_length;
+  gsize      p;
+
+  /* the extended timestamp has the mtime in UTC */
+  for (p = 0; p + 4 <= entry->extra_length; p += 4 + field_length)
+    {
+      field_length = tap_zip_u16 (entry->extra + p + 2);
+      if (p + 4 + field_length > entry->extra_length)
+        break;
+      if (tap_zip_u16 (entry->extra + p) == 0x5455 && field_length >= 5 && (entry->extra[p + 4] & 1) != 0)
+        return (gint32) tap_zip_u32 (entry->extra + p + 5);
+    }
+
+  /* otherwise the DOS time, in local time */
+  date = entry->dos_time >> 16;
+  time = entry->dos_time & 0xffff;
+  date_time = g_date_time_new_local (1980 + (date >> 9), (date >> 5) & 0x0f, date & 0x1f,
+                                     time >> 11, (time >> 5) & 0x3f, (time & 0x1f) * 2);
+  if (G_UNLIKELY (date_time == NULL))
+    return -1;
+
+  mtime = g_date_time_to_unix (date_time);
+  g_date_time_unref (date_time);
+
+  return mtime;
+}
+
+
+
+static guint
+tap_zip_mode (const TapZipEntry *entry,
+              guint              fallback)
+{
+  /* only trust the permissions of entries made on unix, without setuid and friends */
+  if (entry->system == 3 && ((entry->attributes >> 16) & 0777) != 0)
+    return (entry->attributes >> 16) & 0777;
+
+  return fallback;
+}
+
+
+
+static void
+tap_zip_fail (TapZipJob *job,
+              GError    *error)
+{
+  g_mutex_lock (&job->lock);
+  if (job->error == NULL)
+    job->error = error;
+  else
+    g_error_free (error);
+  g_mutex_unlock (&job->lock);
+
+  g_atomic_int_set (&job->failed, 1);
+}
+
+
+
+static void
+tap_zip_account (TapZipJob *job,
+                 gsize      length,
+                 gboolean   report)
+{
+  guint64 written;
+
+  g_mutex_lock (&job->lock);
+  job->written += length;
+  written = job->written;
+  if (report && written - job->reported >= TAP_ZIP_PROGRESS_STEP)
+    job->reported = written;
+  else
+    report = FALSE;
+  g_mutex_unlock (&job->lock);
+
+  /* only the thread of the caller reports the progress */
+  if (report)
+    (*job->progress) (written, job->user_data);
+}
+
+
+
+static gboolean
+tap_zip_inflate_entry (TapZipJob         *job,
+                       const TapZipEntry *entry,
+                       const gchar       *pathname,
+                       z_stream          *stream,
+                       guchar            *input,
+                       guchar            *buffer,
+                       gboolean           report,
+                       GError           **error)
+{
+  guchar    local[30];
+  guint64   remaining;
+  guint64   position = 0;
+  guint64   offset;
+  gboolean  succeed = TRUE;
+  gchar    *display_name;
+  guint32   crc;
+  gsize     length;
+  gint      saved_errno = 0;
+  gint      fd;
+  gint      r = Z_OK;
+
+  /* the data follows the local header, whose extra field may differ from the central one */
+  if (entry->offset > job->length || job->length - entry->offset < 30)
+    goto failed;
+  if (!tap_zip_read (job->fd, local, sizeof (local), entry->offset))
+    {
+      saved_errno = errno;
+      goto failed;
+    }
+  if (tap_zip_u32 (local) != TAP_ZIP_LOCAL)
+    goto failed;
+
+  offset = entry->offset + 30 + tap_zip_u16 (local + 26) + tap_zip_u16 (local + 28);
+  if (offset > job->length || entry->compressed_size > job->length - offset)
+    goto failed;
+
+  fd = tap_writer_open (job->writer, pathname, tap_zip_mode (entry, 0666), error);
+  if (G_UNLIKELY (fd < 0))
+    return FALSE;
+
+  remaining = entry->compressed_size;
+  crc = crc32 (0L, Z_NULL, 0);
+
+  if (entry->method == TAP_ZIP_STORED)
+    {
+      /* stored entries are copied through the input buffer */
+      for (; remaining > 0 && succeed; remaining -= length, offset += length)
+        {
+          length = MIN (remaining, TAP_ZIP_BUFFER_SIZE);
+          if (!tap_zip_read (job->fd, input, length, offset))
+            {
+              saved_errno = errno;
+              close (fd);
+              goto failed;
+            }
+
+          crc = crc32 (crc, input, length);
+          succeed = tap_writer_write (job->writer, fd, input, length, position, pathname, error);
+          position += length;
+          tap_zip_account (job, length, report);
+        }
+    }
+  else
+    {
+      inflateReset (stream);
+      stream->avail_in = 0;
+
+      while (succeed && r != Z_STREAM_END)
+        {
+          if (stream->avail_in == 0 && remaining > 0)
+            {
+              length = MIN (remaining, TAP_ZIP_BUFFER_SIZE);
+              if (!tap_zip_read (job->fd, input, length, offset))
+                {
+                  saved_errno = errno;
+                  close (fd);
+                  goto failed;
+                }
+
+              stream->next_in = input;
+              stream->avail_in = length;
+              offset += length;
+              remaining -= length;
+            }
+
+          stream->next_out = buffer;
+          stream->avail_out = TAP_ZIP_BUFFER_SIZE;
+          r = inflate (stream, Z_NO_FLUSH);
+          if (G_UNLIKELY (r != Z_OK && r != Z_STREAM_END))
+            {
+              /* corrupt or truncated data */
+              close (fd);
+              goto failed;
+            }
+
+          length = TAP_ZIP_BUFFER_SIZE - stream->avail_out;
+          crc = crc32 (crc, buffer, length);
+          succeed = tap_writer_write (job->writer, fd, buffer, length, position, pathname, error);
+          position += length;
+          tap_zip_account (job, length, report);
+        }
+    }
+
+  if (succeed && (position != entry->size || crc != entry->crc))
+    {
+      close (fd);
+      goto failed;
+    }
+
+  if (!succeed)
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  return tap_writer_close (job->writer, fd, tap_zip_mtime (entry), pathname, error);
+
+failed:
+  /* a read error, or a damaged archive */
+  display_name = g_filename_display_basename (job->filename);
+  if (saved_errno != 0)
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno), _("Failed to extract \"%s\": %s"),
+                 display_name, g_strerror (saved_errno));
+  else
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, _("Failed to extract \"%s\": %s"),
+                 display_name, _("The archive is damaged"));
+  g_free (display_name);
+  return FALSE;
+}
+
+
+
+static gpointer
+tap_zip_worker (gpointer user_data)
+{
+  const TapZipEntry *entry;
+  TapZipJob         *job = user_data;
+  z_stream           stream;
+  gboolean           report;
+  GError            *error = NULL;
+  guchar            *buffer;
+  guchar            *input;
+  gchar             *pathname;
+  guint              n;
+
+  report = (job->progress != NULL && g_thread_self () == job->caller);
+
+  memset (&stream, 0, sizeof (stream));
+  if (G_UNLIKELY (inflateInit2 (&stream, -MAX_WBITS) != Z_OK))
+    {
+      g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_FAILED, _("Out of memory"));
+      tap_zip_fail (job, error);
+      return NULL;
+    }
+
+  input = g_malloc (TAP_ZIP_BUFFER_SIZE);
+  buffer = g_malloc (TAP_ZIP_BUFFER_SIZE);
+
+  while (!g_atomic_int_get (&job->failed))
+    {
+      /* claim the next entry, the largest that is left */
+      n = g_atomic_int_add (&job->next, 1);
+      if (n >= job->entries->len)
+        break;
+
+      entry = &g_array_index (job->entries, TapZipEntry, n);
+      pathname = g_strndup (entry->name, entry->name_length);
+
+      /* the folders were created upfront */
+      if (entry->name_length > 0 && entry->name[entry->name_length - 1] != '/'
+          && !tap_zip_inflate_entry (job, entry, pathname, &stream, input, buffer, report, &error))
+        {
+          tap_zip_fail (job, error);
+          error = NULL;
+        }
+
+      g_free (pathname);
+    }
+
+  inflateEnd (&stream);
+  g_free (buffer);
+  g_free (input);
+
+  return NULL;
+}
+#endif
+
+
+
+/**
+ * tap_zip_foreach:
+ * @fd        : a file descriptor of a zip archive.
+ * @length    : the length of the archive.
+ * @max_size  : the number of bytes of the central directory to read.
+ * @func      : the function to report the entries to.
+ * @user_data : the data to pass to @func.
+ * @directory : return location for the central directory, or %NULL.
+ *
+ * Walks the central directory of the zip archive @fd, which is all at
+ * its end, including zip64 archives. The archive is read with pread(),
+ * at most @max_size bytes of the central directory, so huge ones end
+ * the walk early. The names and extra fields of the entries point into
+ * the central directory, which is freed afterwards, unless @directory
+ * is given, which takes it over and is to be freed with g_free().
+ *
+ * Return value: %TRUE if all entries were walked, %FALSE if the
+ *               archive is malformed or could not be read, the
+ *               central directory is too large, or @func stopped
+ *               the walk.
+ **/
+gboolean
+tap_zip_foreach (gint        fd,
+                 guint64     length,
+                 gsize       max_size,
+                 TapZipFunc  func,
+                 gpointer    user_data,
+                 gpointer   *directory)
+{
+  const guchar *end = NULL;
+  TapZipEntry   entry;
+  gboolean      complete = FALSE;
+  guchar        record[56];
+  guchar       *data;
+  guint64       n_entries;
+  guint64       offset;
+  guint64       size;
+  guint64       n;
+  gsize         tail_length;
+  gsize         p;
+
+  if (directory != NULL)
+    *directory = NULL;
+
+  if (length < 22)
+    return FALSE;
+
+  /* the end of central directory record, followed by a comment of up to 64 KiB,
+   * and preceded by the zip64 locator */
+  tail_length = MIN (length, 20 + 22 + 0xffff);
+  data = g_malloc (tail_length);
+  if (!tap_zip_read (fd, data, tail_length, length - tail_length))
+    {
+      g_free (data);
+      return FALSE;
+    }
+
+  for (p = tail_length - 22; end == NULL; --p)
+    {
+      if (tap_zip_u32 (data + p) == TAP_ZIP_END)
+        end = data + p;
+      else if (p == 0 || tail_length - p >= 22 + 0xffff)
+        {
+          g_free (data);
+          return FALSE;
+        }
+    }
+
+  n_entries = tap_zip_u16 (end + 10);
+  size = tap_zip_u32 (end + 12);
+  offset = tap_zip_u32 (end + 16);
+
+  /* zip64 archives have the real values in another record */
+  if (n_entries == 0xffff || size == 0xffffffff || offset == 0xffffffff)
+    {
+      if (end - data < 20 || tap_zip_u32 (end - 20) != TAP_ZIP64_END_LOCATOR)
+        {
+          g_free (data);
+          return FALSE;
+        }
+
+      offset = tap_zip_u64 (end - 20 + 8);
+      if (length < sizeof (record) || offset > length - sizeof (record)
+          || !tap_zip_read (fd, record, sizeof (record), offset)
+          || tap_zip_u32 (record) != TAP_ZIP64_END)
+        {
+          g_free (data);
+          return FALSE;
+        }
+
+      n_entries = tap_zip_u64 (record + 32);
+      size = tap_zip_u64 (record + 40);
+      offset = tap_zip_u64 (record + 48);
+    }
+
+  g_free (data);
+
+  if (offset > length || size > length - offset)
+    return FALSE;
+
+  /* huge central directories are only walked as far as they were read */
+  size = MIN (size, max_size);
+  data = g_try_malloc (MAX (size, 1));
+  if (G_UNLIKELY (data == NULL))
+    return FALSE;
+  if (!tap_zip_read (fd, data, size, offset))
+    goto done;
+
+  for (n = 0, p = 0; n < n_entries; ++n)
+    {
+      if (p + 46 > size || tap_zip_u32 (data + p) != TAP_ZIP_CENTRAL)
+        goto done;
+
+      entry.name = (const gchar *) data + p + 46;
+      entry.name_length = tap_zip_u16 (data + p + 28);
+      entry.extra = data + p + 46 + entry.name_length;
+      entry.extra_length = tap_zip_u16 (data + p + 30);
+      if (p + 46 + entry.name_length + entry.extra_length > size)
+        goto done;
+
+      entry.system = data[p + 5];
+      entry.flags = tap_zip_u16 (data + p + 8);
+      entry.method = tap_zip_u16 (data + p + 10);
+      entry.dos_time = ((guint32) tap_zip_u16 (data + p + 14) << 16) | tap_zip_u16 (data + p + 12);
+      entry.crc = tap_zip_u32 (data + p + 16);
+      entry.compressed_size = tap_zip_u32 (data + p + 20);
+      entry.size = tap_zip_u32 (data + p + 24);
+      entry.attributes = tap_zip_u32 (data + p + 38);
+      entry.offset = tap_zip_u32 (data + p + 42);
+      if (entry.size == 0xffffffff || entry.compressed_size == 0xffffffff || entry.offset == 0xffffffff)
+        tap_zip_zip64 (entry.extra, entry.extra_length, &entry.size, &entry.compressed_size, &entry.offset);
+
+      if (!(*func) (&entry, user_data))
+        goto done;
+
+      p += 46 + entry.name_length + entry.extra_length + tap_zip_u16 (data + p + 32);
+    }
+
+  complete = TRUE;
+
+done:
+  if (directory != NULL)
+    *directory = data;
+  else
+    g_free (data);
+
+  return complete;
+}
+
+
+
+#ifdef HAVE_ZLIB
+/**
+ * tap_zip_extract:
+ * @filename  : the path to the zip archive.
+ * @folder    : the folder in which to extract the entries.
+ * @n_threads : the number of threads to inflate the entries on.
+ * @progress  : the function to report the progress to, or %NULL.
+ * @user_data : the data to pass to @progress.
+ * @handled   : set to %FALSE if the archive was not touched.
+ * @error     : return location for errors or %NULL.
+ *
+ * Extracts the zip archive @filename into @folder on @n_threads threads,
+ * the caller being one of them. The central directory tells where every
+ * entry is, so the entries are read with pread() and inflated
+ * independently, largest first, and written with pwrite(). The archive
+ * is never mapped, so archives on media that go away only fail to
+ * extract. Archives with entries that are encrypted, compressed with
+ * other methods than deflate, or symlinks, are not touched and @handled
+ * is set to %FALSE, so they can go through libarchive instead.
+ *
+ * This function blocks, and may be called from any thread.
+ *
+ * Return value: %TRUE if the archive was extracted.
+ **/
+gboolean
+tap_zip_extract (const gchar       *filename,
+                 const gchar       *folder,
+                 guint              n_threads,
+                 TapExtractProgress progress,
+                 gpointer           user_data,
+                 gboolean          *handled,
+                 GError           **error)
+{
+  const TapZipEntry *entry;
+  struct stat        statb;
+  TapZipJob          job;
+  GThread          **threads;
+  gpointer           directory;
+  gboolean           succeed = FALSE;
+  gboolean           complete;
+  gchar             *pathname;
+  guint              n_files;
+  guint              n;
+  gint               fd;
+
+  TAP_TRACE_SCOPE ("zip-extract");
+
+  *handled = FALSE;
+
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (G_UNLIKELY (fd < 0))
+    return FALSE;
+  if (G_UNLIKELY (fstat (fd, &statb) < 0))
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  memset (&job, 0, sizeof (job));
+  job.filename = filename;
+  job.fd = fd;
+  job.length = statb.st_size;
+  job.entries = g_array_new (FALSE, FALSE, sizeof (TapZipEntry));
+  job.caller = g_thread_self ();
+  job.progress = progress;
+  job.user_data = user_data;
+  g_mutex_init (&job.lock);
+
+  /* everything the walk cannot vouch for is left to libarchive */
+  complete = tap_zip_foreach (job.fd, job.length, TAP_ZIP_MAX_DIRECTORY, tap_zip_collect, &job, &directory);
+  if (!complete || job.unsupported)
+    goto done;
+
+  *handled = TRUE;
+
+  job.writer = tap_writer_new (folder, n_threads, &job.error);
+  if (G_UNLIKELY (job.writer == NULL))
+    goto done;
+
+  /* create the folders upfront, so the workers never race for them */
+  for (n = 0, n_files = 0; n < job.entries->len && job.error == NULL; ++n)
+    {
+      entry = &g_array_index (job.entries, TapZipEntry, n);
+      if (entry->name_length > 0 && entry->name[entry->name_length - 1] == '/')
+        {
+          pathname = g_strndup (entry->name, entry->name_length);
+          tap_writer_mkdir (job.writer, pathname, tap_zip_mode (entry, 0777), tap_zip_mtime (entry), &job.error);
+          g_free (pathname);
+        }
+      else
+        {
+          n_files += 1;
+        }
+    }
+
+  if (G_LIKELY (job.error == NULL))
+    {
+      /* a deflate stream cannot be split, so the largest entries are started first */
+      g_array_sort (job.entries, tap_zip_compare);
+
+      /* the caller is one of the workers */
+      n_threads = CLAMP (n_threads, 1, MAX (n_files, 1));
+      threads = g_newa (GThread *, n_threads);
+      for (n = 1; n < n_threads; ++n)
+        threads[n] = g_thread_new ("tap-zip", tap_zip_worker, &job);
+      tap_zip_worker (&job);
+      for (n = 1; n < n_threads; ++n)
+        g_thread_join (threads[n]);
+    }
+
+  /* the folder times last, the files in them are done by now */
+  if (G_LIKELY (job.error == NULL) && tap_writer_finish (job.writer, &job.error))
+    {
+      if (progress != NULL)
+        (*progress) (job.written, user_data);
+
+      succeed = TRUE;
+    }
+
+  tap_writer_free (job.writer);
+
+done:
+  if (job.error != NULL)
+    g_propagate_error (error, job.error);
+  g_mutex_clear (&job.lock);
+  g_array_free (job.entries, TRUE);
+  g_free (directory);
+  close (fd);
+
+  return succeed;
+}
+#endif
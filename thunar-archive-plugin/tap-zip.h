@@ -0,0 +1,100 @@
+/* vi:set et ai sw=2 sts=2 ts=2: */
+/*-
+ * Copyright (c) 2026 Xfce Development Team <xfce4-dev@xfce.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAP_ZIP_H__
+#define __TAP_ZIP_H__
+
+#ifdef HAVE_ZLIB
+#include <thunar-archive-plugin/tap-extract.h>
+#else
+#include <glib.h>
+#endif
+
+G_BEGIN_DECLS;
+
+/**
+ * TapZipEntry:
+ * @name            : the path of the entry, not nul-terminated.
+ * @name_length     : the length of @name.
+ * @flags           : the general purpose flags.
+ * @method          : the compression method.
+ * @crc             : the CRC-32 of the uncompressed data.
+ * @dos_time        : the DOS date in the high and the DOS time in
+ *                    the low 16 bits.
+ * @attributes      : the external attributes.
+ * @system          : the system that made the entry, %3 for unix.
+ * @compressed_size : the size of the compressed data.
+ * @size            : the uncompressed size.
+ * @offset          : the offset of the local header.
+ * @extra           : the extra field of the central directory.
+ * @extra_length    : the length of @extra.
+ *
+ * An entry of the central directory of a zip archive, pointing into
+ * the central directory read by tap_zip_foreach().
+ **/
+typedef struct
+{
+  const gchar  *name;
+  gsize         name_length;
+  guint16       flags;
+  guint16       method;
+  guint32       crc;
+  guint32       dos_time;
+  guint32       attributes;
+  guint8        system;
+  guint64       compressed_size;
+  guint64       size;
+  guint64       offset;
+  const guchar *extra;
+  gsize         extra_length;
+} TapZipEntry;
+
+/**
+ * TapZipFunc:
+ * @entry     : the #TapZipEntry.
+ * @user_data : the data passed to tap_zip_foreach().
+ *
+ * Reports an entry found by tap_zip_foreach().
+ *
+ * Return value: %FALSE to stop the walk.
+ **/
+typedef gboolean (*TapZipFunc) (const TapZipEntry *entry,
+                                gpointer           user_data);
+
+gboolean tap_zip_foreach (gint               fd,
+                          guint64            length,
+                          gsize              max_size,
+                          TapZipFunc         func,
+                          gpointer           user_data,
+                          gpointer          *directory) G_GNUC_INTERNAL;
+
+#ifdef HAVE_ZLIB
+gboolean tap_zip_extract (const gchar       *filename,
+                          const gchar       *folder,
+                          guint              n_threads,
+                          TapExtractProgress progress,
+                          gpointer           user_data,
+                          gboolean          *handled,
+                          GError           **error) G_GNUC_INTERNAL;
+#endif
+
+G_END_DECLS;
+
+#endif /* !__TAP_ZIP_H__ */
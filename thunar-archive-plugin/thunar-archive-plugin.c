@@ -21,7 +21,11 @@
 
 #include <libxfce4util/libxfce4util.h>
 
+#include <thunar-archive-plugin/tap-backend.h>
+#include <thunar-archive-plugin/tap-magic.h>
 #include <thunar-archive-plugin/tap-provider.h>
+#include <thunar-archive-plugin/tap-telemetry.h>
+#include <thunar-archive-plugin/tap-wrappers.h>
 
 
 
@@ -64,6 +68,12 @@ thunar_extension_initialize (ThunarxProviderPlugin *plugin)
 
   /* setup the plugin provider type list */
   type_list[0] = TAP_TYPE_PROVIDER;
+
+  /* index the installed wrapper scripts */
+  tap_wrappers_initialize ();
+
+  /* start resolving the archive managers in the background */
+  tap_backend_initialize ();
 }
 
 
@@ -74,6 +84,12 @@ thunar_extension_shutdown (void)
 #ifdef G_ENABLE_DEBUG
   g_message ("Shutting down thunar-archive-plugin extension");
 #endif
+
+  /* release the archive manager cache, the wrapper registry, the detection cache and the telemetry */
+  tap_backend_shutdown ();
+  tap_magic_shutdown ();
+  tap_wrappers_shutdown ();
+  tap_telemetry_shutdown ();
 }
 
 